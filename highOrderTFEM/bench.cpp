@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+#include <mesh.hpp>
+#include <solver.hpp>
+#include <analytical.hpp>
+#include "scatter_pattern.hpp"
+
+/**
+ * Benchmark sweep in a single process: every mesh in a directory, every scatter pattern, with and
+ * without fuzzing, for each step count. Each configuration is run warmup times untimed and then
+ * repeat times, and the median and spread (max - min) of each phase are reported.
+ *
+ * Usage: bench [--meshes <dir>] [--patterns Atomic,Coloring,ColoringScalar,Serial,Gather] [--fuzz 0,1]
+ *              [--steps 1000] [--repeats 5] [--warmup 1] [--out benchmark_data.csv]
+ *              [--details benchmark_details.csv]
+ *
+ * --out is written in the schema of visualization/benchmark_data.csv (Device,Algorithm,Mesh,Time),
+ * with Time being the median time of 10000 steps as the plotting scripts expect, and fuzzed runs
+ * marked in the algorithm name. --details has every phase's median and spread per configuration.
+ * ColoringScalar is the coloring pattern with its SIMD batches turned off, for comparison on CPUs.
+ */
+
+namespace
+{
+    struct BenchConfig
+    {
+        std::string mesh_dir = "demoMeshes/Results2";
+        std::vector<std::string> patterns = {"Atomic", "Coloring", "Serial", "Gather"};
+        std::vector<int> fuzz = {0};
+        std::vector<int> steps = {1000};
+        int repeats = 5;
+        int warmup = 1;
+        std::string out = "benchmark_data.csv";
+        std::string details = "benchmark_details.csv";
+    };
+
+    // Timings of one run of a configuration, in seconds
+    struct RunTimes
+    {
+        double load;
+        double color;
+        double setup;
+        double step;
+    };
+
+    struct Summary
+    {
+        double median;
+        double spread;
+    };
+
+    Summary summarize(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        size_t n = values.size();
+        double median = (n % 2) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+        return {median, values.back() - values.front()};
+    }
+
+    std::vector<std::string> split(const std::string &list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            items.push_back(item);
+        }
+        return items;
+    }
+
+    std::vector<int> split_ints(const std::string &list)
+    {
+        std::vector<int> values;
+        for (auto &item : split(list))
+        {
+            values.push_back(std::stoi(item));
+        }
+        return values;
+    }
+
+    BenchConfig parse_args(int argc, char *argv[])
+    {
+        BenchConfig config;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--meshes")
+                config.mesh_dir = value;
+            else if (arg == "--patterns")
+                config.patterns = split(value);
+            else if (arg == "--fuzz")
+                config.fuzz = split_ints(value);
+            else if (arg == "--steps")
+                config.steps = split_ints(value);
+            else if (arg == "--repeats")
+                config.repeats = std::stoi(value);
+            else if (arg == "--warmup")
+                config.warmup = std::stoi(value);
+            else if (arg == "--out")
+                config.out = value;
+            else if (arg == "--details")
+                config.details = value;
+            else
+                throw std::invalid_argument("Unknown option " + arg);
+        }
+        if (config.repeats < 1)
+        {
+            throw std::invalid_argument("--repeats must be at least 1");
+        }
+        if (config.warmup < 1)
+        {
+            throw std::invalid_argument("--warmup must be at least 1");
+        }
+        if (config.steps.empty())
+        {
+            throw std::invalid_argument("--steps must list at least one step count");
+        }
+        for (int n_steps : config.steps)
+        {
+            // Per-step times are divided by the step count
+            if (n_steps < 1)
+            {
+                throw std::invalid_argument("--steps must be at least 1");
+            }
+        }
+        return config;
+    }
+
+    /**
+     * Mesh number for the CSV, e.g. 5 for square5_b0.grd, or -1 if the name has none.
+     */
+    int mesh_number(const std::filesystem::path &path)
+    {
+        std::smatch match;
+        std::string name = path.filename().string();
+        if (std::regex_search(name, match, std::regex("(\\d+)")))
+        {
+            return std::stoi(match[1]);
+        }
+        return -1;
+    }
+
+    double fenced_seconds(Kokkos::Timer &timer)
+    {
+        Kokkos::fence();
+        return timer.seconds();
+    }
+
+    /**
+     * Loads the mesh, builds the pattern (with make_pattern) and the solver, and runs the steps,
+     * timing each phase.
+     */
+    template <typename Pattern>
+    RunTimes run_once(const std::string &mesh_file, bool fuzz, int n_steps, std::function<Pattern(TFEM::DeviceMesh &)> make_pattern)
+    {
+        RunTimes times;
+        Kokkos::Timer timer;
+
+        TFEM::DeviceMesh device_mesh;
+        TFEM::DeviceMesh::HostMirrorMesh host_mesh;
+        TFEM::load_meshes_from_file(mesh_file, device_mesh, host_mesh, fuzz);
+        times.load = fenced_seconds(timer);
+
+        timer.reset();
+        Pattern pattern = make_pattern(device_mesh);
+        times.color = fenced_seconds(timer);
+
+        // Same problem as the demo, at the largest stable step
+        double k = 1E-2;
+        std::vector<TFEM::Analytical::Term> terms;
+        terms.push_back({1.0, 1, 1});
+        terms.push_back({2.0, 1, 3});
+        TFEM::Analytical::ZeroBoundary<> analytical(k, -1.0, 2.0, -1.0, 2.0, terms);
+        timer.reset();
+        TFEM::Solver<Pattern> solver(device_mesh, pattern, analytical, 0, k);
+        times.setup = fenced_seconds(timer);
+
+        timer.reset();
+        solver.simulate_steps(n_steps);
+        times.step = fenced_seconds(timer) / n_steps;
+        return times;
+    }
+
+    template <typename Pattern>
+    std::vector<RunTimes> run_config(const BenchConfig &config, const std::string &mesh_file, bool fuzz, int n_steps, std::function<Pattern(TFEM::DeviceMesh &)> make_pattern)
+    {
+        for (int i = 0; i < config.warmup; i++)
+        {
+            run_once<Pattern>(mesh_file, fuzz, n_steps, make_pattern);
+        }
+        std::vector<RunTimes> runs;
+        for (int i = 0; i < config.repeats; i++)
+        {
+            runs.push_back(run_once<Pattern>(mesh_file, fuzz, n_steps, make_pattern));
+        }
+        return runs;
+    }
+
+    /**
+     * Runs a configuration with the named pattern. Returns false for patterns that cannot run here.
+     */
+    bool run_pattern(const BenchConfig &config, const std::string &name, const std::string &mesh_file, bool fuzz, int n_steps, std::vector<RunTimes> &runs)
+    {
+        if (name == "Atomic")
+        {
+            runs = run_config<TFEM::AtomicElementScatterAdd>(config, mesh_file, fuzz, n_steps, [](TFEM::DeviceMesh &mesh)
+                                                             { return TFEM::AtomicElementScatterAdd(mesh); });
+        }
+        else if (name == "Coloring")
+        {
+            runs = run_config<TFEM::ColoredElementScatterAdd>(config, mesh_file, fuzz, n_steps, [](TFEM::DeviceMesh &mesh)
+                                                              { return TFEM::ColoredElementScatterAdd(TFEM::MeshColorMap(mesh)); });
+        }
+        else if (name == "ColoringScalar")
+        {
+            runs = run_config<TFEM::ColoredElementScatterAdd>(config, mesh_file, fuzz, n_steps, [](TFEM::DeviceMesh &mesh)
+                                                              { return TFEM::ColoredElementScatterAdd(TFEM::MeshColorMap(mesh), false); });
+        }
+        else if (name == "Gather")
+        {
+            runs = run_config<TFEM::GatherElementScatterAdd>(config, mesh_file, fuzz, n_steps, [](TFEM::DeviceMesh &mesh)
+                                                             { return TFEM::GatherElementScatterAdd(mesh); });
+        }
+        else if (name == "Serial")
+        {
+            // The serial pattern runs on the host, straight on the mesh views
+            if (!Kokkos::SpaceAccessibility<Kokkos::HostSpace, Kokkos::DefaultExecutionSpace::memory_space>::accessible)
+            {
+                return false;
+            }
+            runs = run_config<TFEM::SerialElementScatterAdd>(config, mesh_file, fuzz, n_steps, [](TFEM::DeviceMesh &mesh)
+                                                             { return TFEM::SerialElementScatterAdd(mesh); });
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown pattern " + name);
+        }
+        return true;
+    }
+
+    /**
+     * Device column as in the existing benchmark data: "GPU", "<n> core", or "Serial" for the
+     * serial pattern.
+     */
+    std::string device_name(const std::string &pattern)
+    {
+        if (pattern == "Serial")
+        {
+            return "Serial";
+        }
+        if (!Kokkos::SpaceAccessibility<Kokkos::HostSpace, Kokkos::DefaultExecutionSpace::memory_space>::accessible)
+        {
+            return "GPU";
+        }
+        return std::to_string(Kokkos::DefaultExecutionSpace().concurrency()) + " core";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Kokkos::initialize(argc, argv);
+    int status = 0;
+    try
+    {
+        BenchConfig config = parse_args(argc, argv);
+
+        std::vector<std::filesystem::path> meshes;
+        for (auto &entry : std::filesystem::directory_iterator(config.mesh_dir))
+        {
+            auto extension = entry.path().extension();
+            if (extension == ".grd" || extension == ".tfm")
+            {
+                meshes.push_back(entry.path());
+            }
+        }
+        std::sort(meshes.begin(), meshes.end(), [](auto &a, auto &b)
+                  { return mesh_number(a) < mesh_number(b) || (mesh_number(a) == mesh_number(b) && a < b); });
+
+        std::ofstream out(config.out);
+        std::ofstream details(config.details);
+        out << "Device,Algorithm,Mesh,Time" << std::endl;
+        details << "Device,Algorithm,Mesh,Fuzz,Steps,Repeats,"
+                << "Load_median,Load_spread,Color_median,Color_spread,Setup_median,Setup_spread,Step_median,Step_spread" << std::endl;
+
+        for (auto &mesh : meshes)
+        {
+            for (auto &pattern : config.patterns)
+            {
+                for (int fuzz : config.fuzz)
+                {
+                    for (int n_steps : config.steps)
+                    {
+                        std::vector<RunTimes> runs;
+                        if (!run_pattern(config, pattern, mesh.string(), fuzz, n_steps, runs))
+                        {
+                            std::cout << "Skipping " << pattern << ": not supported by the default execution space" << std::endl;
+                            continue;
+                        }
+
+                        std::vector<double> load, color, setup, step;
+                        for (auto &run : runs)
+                        {
+                            load.push_back(run.load);
+                            color.push_back(run.color);
+                            setup.push_back(run.setup);
+                            step.push_back(run.step);
+                        }
+                        Summary load_stats = summarize(load);
+                        Summary color_stats = summarize(color);
+                        Summary setup_stats = summarize(setup);
+                        Summary step_stats = summarize(step);
+
+                        std::string device = device_name(pattern);
+                        std::string algorithm = pattern + (fuzz ? " fuzzed" : "");
+                        int number = mesh_number(mesh);
+                        out << device << "," << algorithm << "," << number << "," << 10000 * step_stats.median << std::endl;
+                        details << device << "," << algorithm << "," << number << "," << fuzz << "," << n_steps << "," << config.repeats << ","
+                                << load_stats.median << "," << load_stats.spread << ","
+                                << color_stats.median << "," << color_stats.spread << ","
+                                << setup_stats.median << "," << setup_stats.spread << ","
+                                << step_stats.median << "," << step_stats.spread << std::endl;
+                        std::cout << mesh.filename().string() << " " << algorithm << " " << n_steps << " steps: "
+                                  << step_stats.median << " s/step (spread " << step_stats.spread << ")" << std::endl;
+                    }
+                }
+            }
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << "bench: " << e.what() << std::endl;
+        status = 1;
+    }
+    Kokkos::finalize();
+    return status;
+}
@@ -0,0 +1,66 @@
+#include <iostream>
+
+#include <mpi.h>
+#include <Kokkos_Core.hpp>
+#include <mesh.hpp>
+#include <distributed.hpp>
+#include <analytical.hpp>
+#include "scatter_pattern.hpp"
+
+/**
+ * Runs the heat problem of the main demo on a mesh split across the MPI ranks.
+ *
+ * Usage: mpirun -n <ranks> distributed_demo <mesh file> [steps]
+ */
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    int rank, n_ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+    if (argc < 2)
+    {
+        if (rank == 0)
+        {
+            std::cerr << "Usage: " << argv[0] << " <mesh file> [steps]" << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    int n_steps = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+    Kokkos::initialize(argc, argv);
+    {
+        // Every rank reads the whole mesh and computes the same partition, then keeps its own part
+        TFEM::DeviceMesh device_mesh;
+        TFEM::DeviceMesh::HostMirrorMesh host_mesh;
+        TFEM::load_meshes_from_file(argv[1], device_mesh, host_mesh);
+        auto region_parts = TFEM::partition_mesh_regions(host_mesh, n_ranks);
+        auto part = TFEM::extract_mesh_part<TFEM::DeviceMesh>(host_mesh, region_parts, rank, n_ranks);
+        std::cout << "Rank " << rank << ": " << part.mesh.region_count() << " regions (" << part.n_interface_regions
+                  << " on the interface), " << part.mesh.point_count() << " points, " << part.neighbors.size() << " neighbors" << std::endl;
+
+        double k = 1E-2;
+        double dt = 1E-5;
+        std::vector<TFEM::Analytical::Term> terms;
+        terms.push_back({1.0, 1, 1});
+        terms.push_back({2.0, 1, 3});
+        TFEM::Analytical::ZeroBoundary<> analytical(k, -1.0, 2.0, -1.0, 2.0, terms);
+
+        TFEM::DistributedSolver<TFEM::ColoredElementScatterAdd> solver(part, analytical, dt, k);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        Kokkos::Timer timer;
+        solver.simulate_steps(n_steps);
+        MPI_Barrier(MPI_COMM_WORLD);
+        double elapsed = timer.seconds();
+
+        double error = solver.measure_error();
+        if (rank == 0)
+        {
+            std::cout << n_steps << " steps on " << n_ranks << " ranks in " << elapsed << "s, error " << error << std::endl;
+        }
+    }
+    Kokkos::finalize();
+    MPI_Finalize();
+}
@@ -5,6 +5,8 @@
 #define highOrderTFEM_analytical_hpp
 
 #include <Kokkos_Core.hpp>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <math.h> // for pi
 
@@ -110,6 +112,217 @@ namespace TFEM
                 }
                 return result;
             }
+
+            int term_count() const
+            {
+                return terms.extent(0);
+            }
+
+            /**
+             * Copy of the terms, readable from the host.
+             */
+            std::vector<ZeroBoundaryTerm> host_terms() const
+            {
+                auto terms_mirror = Kokkos::create_mirror_view(terms);
+                Kokkos::deep_copy(terms_mirror, terms);
+                std::vector<ZeroBoundaryTerm> result(terms.extent(0));
+                for (std::size_t i = 0; i < result.size(); i++)
+                {
+                    result[i] = terms_mirror(i);
+                }
+                return result;
+            }
+
+            /**
+             * The time-independent part of term i at the given point, including the amplitude.
+             */
+            KOKKOS_INLINE_FUNCTION double spatial_factor(int i, double x, double y) const
+            {
+                const ZeroBoundaryTerm &term = terms(i);
+                return term.amplitude * sin((x - x_shift) * term.coef_x) * sin((y - y_shift) * term.coef_y);
+            }
+        };
+
+        /**
+         * A ZeroBoundary solution plus the polynomial solution
+         *
+         *     c + gx * x + gy * y + q * (x^2 + y^2 + 4 * k * t)
+         *
+         * of the same equation, whose values on the boundary are then those of the polynomial:
+         * fixed for q = 0, and growing linearly in time otherwise. Linear elements reproduce the
+         * linear part exactly. Converts implicitly from a ZeroBoundary, with every polynomial
+         * coefficient zero.
+         */
+        template <class TermView = Kokkos::View<ZeroBoundaryTerm *>>
+        class PolynomialBoundary
+        {
+        protected:
+            ZeroBoundary<TermView> zero_part;
+            double k;
+            double c;
+            double gx;
+            double gy;
+            double q;
+
+        public:
+            PolynomialBoundary(ZeroBoundary<TermView> zero_part)
+                : zero_part(zero_part), k(0), c(0), gx(0), gy(0), q(0)
+            { // Pretty much just the initializer list
+            }
+
+            /**
+             * Parameters:
+             *  - zero_part: the part that is zero on the boundary
+             *  - k: stiffness parameter, as for zero_part
+             *  - c, gx, gy, q: polynomial coefficients, see above
+             */
+            PolynomialBoundary(ZeroBoundary<TermView> zero_part, double k, double c, double gx, double gy, double q = 0)
+                : zero_part(zero_part), k(k), c(c), gx(gx), gy(gy), q(q)
+            { // Pretty much just the initializer list
+            }
+
+            /**
+             * Computes the value of the solution at the given point and time.
+             */
+            KOKKOS_INLINE_FUNCTION double operator()(double x, double y, double t) const
+            {
+                return zero_part(x, y, t) + polynomial(x, y, t);
+            }
+
+            /**
+             * The polynomial part alone, which is the solution's value on the boundary.
+             */
+            KOKKOS_INLINE_FUNCTION double polynomial(double x, double y, double t) const
+            {
+                return c + gx * x + gy * y + q * (x * x + y * y + 4 * k * t);
+            }
+
+            /**
+             * Whether the boundary values are non-zero anywhere
+             */
+            bool has_polynomial() const
+            {
+                return c != 0 || gx != 0 || gy != 0 || q != 0;
+            }
+
+            /**
+             * Whether the boundary values change with time
+             */
+            bool is_time_dependent() const
+            {
+                return q != 0;
+            }
+
+            const ZeroBoundary<TermView> &zero_boundary_part() const
+            {
+                return zero_part;
+            }
+
+            int term_count() const
+            {
+                return zero_part.term_count();
+            }
+        };
+
+        /**
+         * exp(coef_t * t) for every term of a solution, passed by value into kernels.
+         */
+        struct TimeFactors
+        {
+            static constexpr int max_terms = 32;
+            double values[max_terms];
+        };
+
+        /**
+         * A ZeroBoundary solution tabulated at a fixed set of points. The spatial factor of every
+         * (point, term) pair is computed once, so evaluating at a point and time is a dot product
+         * with the time factors of the terms, which are computed once per time on the host.
+         *
+         * Costs one double per point and term. The table uses the default layout of the execution
+         * space, so on GPUs neighboring points read neighboring memory for each term.
+         */
+        class TabulatedZeroBoundary
+        {
+        protected:
+            Kokkos::View<double **> spatial_factors;
+            // Kept in a plain array rather than a vector, so that copies stay device-capturable
+            int n_terms = 0;
+            double coef_t[TimeFactors::max_terms];
+
+        public:
+            TabulatedZeroBoundary() = default;
+
+            /**
+             * Tabulates the solution at every point of the given mesh (of any layout). The table is
+             * filled on space; work launched there afterwards may read it right away.
+             */
+            template <class MeshT>
+            TabulatedZeroBoundary(const ZeroBoundary<> &solution, MeshT mesh, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+            {
+                // The fill is in a separate function, as nvcc does not take device lambdas
+                // inside of constructors.
+                tabulate(solution, mesh, space);
+            }
+
+            /**
+             * INTENDED PRIVATE: DO NOT CALL. Instead see the constructor.
+             */
+            template <class MeshT>
+            void tabulate(const ZeroBoundary<> &solution, MeshT mesh, Kokkos::DefaultExecutionSpace space)
+            {
+                std::vector<ZeroBoundaryTerm> terms = solution.host_terms();
+                if (terms.size() > TimeFactors::max_terms)
+                {
+                    throw std::invalid_argument("TabulatedZeroBoundary supports at most " + std::to_string(TimeFactors::max_terms) + " terms");
+                }
+                n_terms = terms.size();
+                for (int i = 0; i < n_terms; i++)
+                {
+                    coef_t[i] = terms[i].coef_t;
+                }
+
+                int n_terms = this->n_terms;
+                Kokkos::View<double **> spatial_factors("Tabulated spatial factors", mesh.point_count(), n_terms);
+                Kokkos::parallel_for(
+                    Kokkos::RangePolicy<>(space, 0, mesh.point_count()), KOKKOS_LAMBDA(int p) {
+                    auto point = mesh.point(p);
+                    for (int i = 0; i < n_terms; i++) {
+                        spatial_factors(p, i) = solution.spatial_factor(i, point[0], point[1]);
+                    } });
+                this->spatial_factors = spatial_factors;
+            }
+
+            bool is_empty() const
+            {
+                return spatial_factors.extent(0) == 0;
+            }
+
+            /**
+             * Time factors to pass to the point evaluation for time t
+             */
+            TimeFactors time_factors(double t) const
+            {
+                TimeFactors factors;
+                for (int i = 0; i < n_terms; i++)
+                {
+                    factors.values[i] = exp(t * coef_t[i]);
+                }
+                return factors;
+            }
+
+            /**
+             * Value of the solution at the p-th tabulated point, at the time the factors were made for.
+             * The table is a view, so a copy of this object can be captured by device lambdas.
+             */
+            KOKKOS_INLINE_FUNCTION double operator()(int p, const TimeFactors &factors) const
+            {
+                double result = 0;
+                for (int i = 0; i < n_terms; i++)
+                {
+                    result += spatial_factors(p, i) * factors.values[i];
+                }
+                return result;
+            }
         };
     } // namsepace Analytical
 } // namespace TFEM
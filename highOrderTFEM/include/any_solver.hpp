@@ -0,0 +1,110 @@
+/**
+ * Runtime choice of the scatter pattern behind a Solver, including picking it by timing.
+ */
+#ifndef highOrderTFEM_any_solver_hpp
+#define highOrderTFEM_any_solver_hpp
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+#include "analytical.hpp"
+#include "solver.hpp"
+
+namespace TFEM
+{
+    enum class PatternKind
+    {
+        Atomic,
+        Colored,
+        Serial,
+        Gather
+    };
+
+    std::string pattern_kind_name(PatternKind kind);
+
+    /**
+     * Inverse of pattern_kind_name (case sensitive). Throws std::invalid_argument for unknown names.
+     */
+    PatternKind parse_pattern_kind(std::string name);
+
+    /**
+     * Settings for BasicAnySolver::autotune.
+     */
+    struct AutotuneOptions
+    {
+        // Patterns to try, in order. Serial is skipped when the default memory space is not host
+        // accessible, and patterns without graph support are skipped for StepMode::Graph.
+        std::vector<PatternKind> candidates = {PatternKind::Colored, PatternKind::Atomic, PatternKind::Gather, PatternKind::Serial};
+        // Untimed steps before timing each pattern, then timed steps
+        int warmup_steps = 2;
+        int trial_steps = 20;
+        // File caching the winner per mesh connectivity hash, device, step mode, precision and
+        // geometry caching. Empty to disable.
+        std::string cache_file = "tfem_autotune.cache";
+    };
+
+    /**
+     * A Solver<Pattern> (double precision) whose pattern is picked at runtime, over MeshT. Use
+     * through the AnySolver / SoAAnySolver aliases.
+     */
+    template <class MeshT>
+    class BasicAnySolver
+    {
+    public:
+        using PointWeightBuffer = typename Solver<BasicAtomicElementScatterAdd<MeshT>>::PointWeightBuffer;
+
+        // Type-erased interface, implemented for each Solver<Pattern> in any_solver.cpp
+        struct Concept
+        {
+            virtual ~Concept() = default;
+            virtual void simulate_steps(int n_steps) = 0;
+            virtual double measure_error() = 0;
+            virtual double time() = 0;
+            virtual double timestep() = 0;
+            virtual PointWeightBuffer current_point_weights() = 0;
+            virtual Kokkos::DefaultExecutionSpace execution_space() = 0;
+        };
+
+    protected:
+        std::unique_ptr<Concept> solver;
+        PatternKind kind;
+
+        BasicAnySolver(std::unique_ptr<Concept> solver, PatternKind kind);
+
+    public:
+        /**
+         * Builds the pattern of the given kind over the mesh (coloring it, for Colored) and a
+         * solver with it. The arguments are those of Solver.
+         */
+        static BasicAnySolver create(PatternKind kind, MeshT mesh, Analytical::PolynomialBoundary<> boundary_conditions, double timestep, double k, SolverOptions options = SolverOptions());
+
+        /**
+         * Returns a solver with the fastest pattern for this mesh and device. Unless the cache has
+         * an entry for the mesh (by connectivity hash), device and solver options, every candidate
+         * is built and timed over a few steps from the initial conditions, the result is cached,
+         * and the winner is returned as it is after its trial steps, so they are not wasted; time()
+         * reflects them. With a cache hit, the cached pattern is built directly, at time 0.
+         */
+        static BasicAnySolver autotune(MeshT mesh, Analytical::PolynomialBoundary<> boundary_conditions, double timestep, double k, SolverOptions options = SolverOptions(), AutotuneOptions autotune_options = AutotuneOptions());
+
+        PatternKind pattern_kind() const { return kind; }
+
+        void simulate_steps(int n_steps) { solver->simulate_steps(n_steps); }
+        double measure_error() { return solver->measure_error(); }
+        double time() { return solver->time(); }
+        double timestep() { return solver->timestep(); }
+        PointWeightBuffer current_point_weights() { return solver->current_point_weights(); }
+        Kokkos::DefaultExecutionSpace execution_space() { return solver->execution_space(); }
+    };
+
+    typedef BasicAnySolver<DeviceMesh> AnySolver;
+    typedef BasicAnySolver<DeviceSoAMesh> SoAAnySolver;
+
+    extern template class BasicAnySolver<DeviceMesh>;
+    extern template class BasicAnySolver<DeviceSoAMesh>;
+}
+
+#endif
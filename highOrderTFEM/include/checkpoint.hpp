@@ -0,0 +1,191 @@
+/**
+ * Binary checkpoint files, from which a Solver can resume without redoing any setup.
+ */
+#ifndef highOrderTFEM_checkpoint_hpp
+#define highOrderTFEM_checkpoint_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+
+namespace TFEM
+{
+    // Alignment (in bytes) of each section in a checkpoint file, a page so sections can be read
+    // with large aligned transfers
+    constexpr std::size_t CHECKPOINT_ALIGNMENT = 4096;
+
+    constexpr char CHECKPOINT_FILE_TAG[8] = {'T', 'F', 'E', 'M', 'C', 'K', 'P', 'T'};
+    constexpr uint32_t CHECKPOINT_FILE_VERSION = 1;
+
+    /**
+     * Sections of a checkpoint file, in file order. Empty sections take no space.
+     */
+    enum CheckpointSection
+    {
+        // current_point_weights, n_points storage scalars
+        CHECKPOINT_STATE = 0,
+        // point_mass_inv, n_points storage scalars
+        CHECKPOINT_MASS_INV,
+        // Element geometry cache (in slot order), 6 * n_regions storage scalars, coefficient-major
+        CHECKPOINT_GEOMETRY,
+        // Assembled step operator as a CSR: n_points + 1 int32 row starts, int32 columns, values
+        CHECKPOINT_OPERATOR_ROW_MAP,
+        CHECKPOINT_OPERATOR_ENTRIES,
+        CHECKPOINT_OPERATOR_VALUES,
+        // Coloring of a colored scatter pattern: n_colors + 1 int32 color starts, then the int32
+        // region IDs in color order (as in BasicMeshColorMap::save)
+        CHECKPOINT_COLOR_STARTS,
+        CHECKPOINT_COLOR_MEMBERS,
+        // A whole binary mesh file (see load_meshes_from_binary_file), with offsets relative to
+        // the start of the section
+        CHECKPOINT_MESH,
+        N_CHECKPOINT_SECTIONS
+    };
+
+    /**
+     * Header of a checkpoint file (".tfc"), followed by the sections at the given offsets.
+     * Native byte order.
+     */
+    struct CheckpointHeader
+    {
+        char tag[8];
+        uint32_t version;
+        uint32_t header_bytes;
+        // sizeof(StorageScalar) of the solver that wrote it
+        uint32_t storage_bytes;
+        // StepMode the solver ran with
+        int32_t step_mode;
+        // Whether the inverse masses have the boundary zeroed, and whether the geometry cache
+        // includes the lumped mass on its diagonal (see SolverImpl::ElementGeometryFunctor)
+        uint32_t mass_masked;
+        uint32_t geometry_fused;
+        int64_t n_points;
+        int64_t n_regions;
+        int64_t n_colors;
+        int64_t n_total_steps;
+        double dt;
+        double k;
+        uint64_t mesh_hash;
+        // Hash of the scatter pattern's slot order (the coloring's region order, or 0 for patterns
+        // whose slots are region IDs), which the geometry cache is laid out in
+        uint64_t slot_order_hash;
+        uint64_t section_offsets[N_CHECKPOINT_SECTIONS];
+        uint64_t section_bytes[N_CHECKPOINT_SECTIONS];
+    };
+
+    /**
+     * Host space checkpoint sections are staged in, so device transfers go straight to or from
+     * it without an extra copy.
+     */
+    using CheckpointPinnedSpace = PinnedHostSpace;
+
+    /**
+     * Hash of a list of (region) IDs, for CheckpointHeader::slot_order_hash.
+     */
+    uint64_t checkpoint_order_hash(const int *ids, int64_t n);
+
+    /**
+     * Helpers for reading and writing checkpoint files. Not intended to be called directly, see
+     * Solver::checkpoint and the Solver restore constructor.
+     */
+    namespace CheckpointImpl
+    {
+        /**
+         * Writes the header and then each section in order, padding to the section offsets.
+         * Section sizes are set in the header up front, except CHECKPOINT_MESH which must come last
+         * and is measured as it is written; close() rewrites the header with it.
+         */
+        class Writer
+        {
+        protected:
+            std::ofstream out_file;
+            std::string fname;
+            CheckpointHeader header;
+            uint64_t written;
+
+        public:
+            Writer(std::string fname, CheckpointHeader header);
+
+            /**
+             * Writes the given section's bytes (as many as set in the header) from host memory.
+             */
+            void write_section(int section, const void *data);
+
+            /**
+             * Pads to the mesh section and returns the stream to write it to.
+             */
+            std::ostream &begin_mesh_section();
+
+            void close();
+        };
+
+        /**
+         * Reads and validates the header, then reads sections with one sequential read each.
+         */
+        class Reader
+        {
+        protected:
+            std::ifstream in_file;
+            std::string fname;
+            CheckpointHeader header;
+
+        public:
+            Reader(std::string fname);
+
+            const CheckpointHeader &file_header() const { return header; }
+            bool has_section(int section) const { return header.section_bytes[section] > 0; }
+
+            /**
+             * Reads the whole section into dest, which must hold section_bytes bytes.
+             */
+            void read_section(int section, void *dest);
+
+            /**
+             * Reads the whole section into a host-accessible view, checking its size.
+             */
+            template <class HostView>
+            void read_view(int section, HostView view)
+            {
+                if (view.span() * sizeof(typename HostView::value_type) != header.section_bytes[section])
+                {
+                    throw std::runtime_error("Checkpoint " + fname + ": section " + std::to_string(section) + " has the wrong size");
+                }
+                read_section(section, view.data());
+            }
+        };
+
+        /**
+         * Lays out the sections from their sizes, each aligned to CHECKPOINT_ALIGNMENT.
+         */
+        void layout_sections(CheckpointHeader &header);
+    }
+
+    /**
+     * Reads just the header of a checkpoint file, e.g. to check its time before restoring it.
+     */
+    CheckpointHeader read_checkpoint_header(std::string fname);
+
+    /**
+     * Loads the mesh embedded in a checkpoint (written by Solver::checkpoint with a host mesh) into
+     * a device and host mesh, as load_meshes_from_binary_file does for a mesh file. Throws if
+     * the checkpoint has no mesh.
+     */
+    template <class MeshT>
+    void load_mesh_from_checkpoint(std::string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh);
+
+    /**
+     * Rebuilds the coloring saved in a checkpoint of a solver using a colored scatter pattern,
+     * without coloring again. Throws if the checkpoint has no coloring or was written for
+     * another mesh.
+     */
+    template <class MeshT>
+    BasicMeshColorMap<MeshT> load_coloring_from_checkpoint(std::string fname, MeshT &mesh);
+}
+
+#endif
@@ -0,0 +1,220 @@
+/**
+ * Explicit heat solver over a mesh partitioned across MPI ranks. Only available when built with
+ * TFEM_ENABLE_MPI.
+ */
+#ifndef highOrderTFEM_distributed_hpp
+#define highOrderTFEM_distributed_hpp
+
+#ifndef TFEM_ENABLE_MPI
+#error "distributed.hpp needs the library to be configured with TFEM_ENABLE_MPI=ON"
+#endif
+
+#include <vector>
+
+#include <mpi.h>
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+#include "type_magic.hpp"
+#include "analytical.hpp"
+#include "scatter_pattern.hpp"
+
+namespace TFEM
+{
+    template <typename ScatterPattern>
+    class DistributedSolver;
+
+    namespace DistributedImpl
+    {
+        template <typename ScatterPattern>
+        struct MassMatrixFunctor;
+
+        template <typename ScatterPattern>
+        struct ElementContributionFunctor;
+    }
+
+    /**
+     * Runs the linear, mass-lumped explicit scheme of Solver (in its Fused step mode) on one part
+     * of a mesh split with partition_mesh_regions/extract_mesh_part, one part per rank.
+     *
+     * Each rank assembles over its own elements, so the points on the interface between parts only
+     * hold a partial sum afterwards; a halo sum with the neighboring ranks completes them. This is
+     * done for the mass matrix and after every step. Within a step, the elements touching the
+     * interface are computed first, and the exchange of their results is in flight while the
+     * remaining (interior) elements are computed.
+     *
+     * With TFEM_GPU_AWARE_MPI the exchange buffers are device views handed straight to MPI; otherwise
+     * they are staged through host mirrors.
+     */
+    template <typename ScatterPattern>
+    class DistributedSolver
+    {
+        friend class DistributedImpl::MassMatrixFunctor<ScatterPattern>;
+        friend class DistributedImpl::ElementContributionFunctor<ScatterPattern>;
+
+    public:
+        using MeshT = typename ScatterPattern::MeshType;
+
+    protected:
+        // Lumped mass inverse per point (of the whole mesh, not just this part), zero on the boundary.
+        using InvMassMatrix = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using ConstInvMassMatrix = constify_view_t<InvMassMatrix>;
+        InvMassMatrix point_mass_inv;
+        ConstInvMassMatrix point_mass_inv_readonly;
+
+        // The part's mesh, and the same mesh split into the elements touching the interface and the rest,
+        // each with its own scatter pattern.
+        MeshT mesh;
+        MeshT interface_mesh;
+        MeshT interior_mesh;
+        ScatterPattern interface_pattern;
+        ScatterPattern interior_pattern;
+
+        // Halo exchange: the values of halo_points[halo_offsets[n] ... halo_offsets[n + 1] - 1] are
+        // sent to and received from neighbors[n], packed in that order.
+        MPI_Comm comm;
+        std::vector<int> neighbors;
+        std::vector<int> halo_offsets;
+        Kokkos::View<int *> halo_points;
+        Kokkos::View<double *> send_buffer;
+        Kokkos::View<double *> recv_buffer;
+        typename Kokkos::View<double *>::HostMirror send_buffer_host;
+        typename Kokkos::View<double *>::HostMirror recv_buffer_host;
+        std::vector<MPI_Request> requests;
+
+        // Points whose error this rank reports, so shared points are only counted once
+        Kokkos::View<bool *> owned_points;
+        long long n_global_interior_points;
+
+        Analytical::ZeroBoundary<> boundary;
+
+        // Parameters
+        double dt;
+        double k;
+        int n_total_steps;
+
+    public:
+        double time() { return dt * n_total_steps; }
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Assemble (including the halo sum) and invert the lumped mass matrix, masking out
+         * boundary points.
+         */
+        void setup_mass_matrix();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Match the state to the analytical solution at t = 0.
+         */
+        void setup_initial_conditions();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Sends the (partial) values of the shared points to the neighbors and posts the receives.
+         * Waits for the device, since MPI reads the send buffer from the host's side.
+         */
+        void start_halo_sum(Kokkos::View<double *> values);
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Waits for the exchange started by start_halo_sum and adds the received values.
+         */
+        void finish_halo_sum(Kokkos::View<double *> values);
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Compute the full new state from the previous one, including the halo sum.
+         */
+        void compute_step();
+
+    public:
+        // Weight buffers for storing state, over the points of this part
+        using PointWeightBuffer = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using ConstPointWeightBuffer = constify_view_t<PointWeightBuffer>;
+        PointWeightBuffer current_point_weights;
+        PointWeightBuffer prev_point_weights;
+        ConstPointWeightBuffer prev_point_weights_readonly;
+
+        /**
+         * Creates the solver for this rank's part. Collective over comm, whose ranks must match the
+         * parts the mesh was split into.
+         */
+        DistributedSolver(MeshPart<MeshT> part, Analytical::ZeroBoundary<> boundary_conditions, double timestep, double k, MPI_Comm comm = MPI_COMM_WORLD);
+
+        /**
+         * Runs the next n steps. Collective.
+         */
+        void simulate_steps(int n_steps);
+
+        /**
+         * Mean squared error against the analytic solution over the interior points of the whole
+         * mesh (see Solver::measure_error). Collective; every rank gets the result.
+         */
+        double measure_error();
+    };
+
+    namespace DistributedImpl
+    {
+        /**
+         * Functor called once per element when assembling the (partial) diagonal lumped mass matrix.
+         */
+        template <typename ScatterPattern>
+        struct MassMatrixFunctor
+        {
+            using SolverT = DistributedSolver<ScatterPattern>;
+
+            typename SolverT::InvMassMatrix inv_mass;
+            typename SolverT::MeshT mesh;
+
+            MassMatrixFunctor(typename SolverT::InvMassMatrix inv_mass,
+                              typename SolverT::MeshT mesh)
+                : inv_mass(inv_mass),
+                  mesh(mesh)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+
+        /**
+         * Functor computing the contribution of an element to the new state, including its share
+         * of the identity term (as in the Fused step mode of Solver).
+         */
+        template <typename ScatterPattern>
+        struct ElementContributionFunctor
+        {
+            using SolverT = DistributedSolver<ScatterPattern>;
+
+            typename SolverT::PointWeightBuffer new_points;
+            typename SolverT::ConstPointWeightBuffer prev_points;
+            typename SolverT::ConstInvMassMatrix inv_mass;
+            typename SolverT::MeshT mesh;
+            double scale;
+
+            ElementContributionFunctor(typename SolverT::PointWeightBuffer new_points,
+                                       typename SolverT::ConstPointWeightBuffer prev_points,
+                                       typename SolverT::ConstInvMassMatrix inv_mass,
+                                       typename SolverT::MeshT mesh,
+                                       double scale)
+                : new_points(new_points),
+                  prev_points(prev_points),
+                  inv_mass(inv_mass),
+                  mesh(mesh),
+                  scale(scale)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+    }
+
+    extern template class DistributedSolver<ColoredElementScatterAdd>;
+    extern template class DistributedSolver<AtomicElementScatterAdd>;
+    extern template class DistributedSolver<GatherElementScatterAdd>;
+    extern template class DistributedSolver<SoAColoredElementScatterAdd>;
+    extern template class DistributedSolver<SoAAtomicElementScatterAdd>;
+    extern template class DistributedSolver<SoAGatherElementScatterAdd>;
+} // namespace TFEM
+
+#endif
@@ -0,0 +1,199 @@
+/**
+ * Batched solves of many heat problems (different k and initial conditions) on one mesh.
+ */
+#ifndef highOrderTFEM_ensemble_hpp
+#define highOrderTFEM_ensemble_hpp
+
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+#include "type_magic.hpp"
+#include "analytical.hpp"
+#include "scatter_pattern.hpp"
+
+namespace TFEM
+{
+    /**
+     * One problem in an ensemble: its stiffness parameter, and the analytic solution used for its
+     * initial condition and error (which should be built with the same k).
+     */
+    struct EnsembleMember
+    {
+        double k;
+        Analytical::ZeroBoundary<> solution;
+    };
+
+    template <typename ScatterPattern>
+    class EnsembleSolver;
+
+    namespace EnsembleImpl
+    {
+        template <typename ScatterPattern>
+        struct MassMatrixFunctor;
+
+        template <typename ScatterPattern>
+        struct ElementContributionFunctor;
+    }
+
+    /**
+     * Runs the linear, mass-lumped explicit scheme of Solver for several problems on the same mesh
+     * and time step at once. The state is a point x member matrix, stored with the members of each
+     * point next to each other, so an element loads its geometry and inverse masses once and then
+     * updates every member from contiguous memory.
+     *
+     * Steps work like the Fused step mode of Solver: the state buffers are swapped, each element
+     * adds its share of the identity term, and boundary points have a zeroed inverse mass.
+     */
+    template <typename ScatterPattern>
+    class EnsembleSolver
+    {
+        friend class EnsembleImpl::MassMatrixFunctor<ScatterPattern>;
+        friend class EnsembleImpl::ElementContributionFunctor<ScatterPattern>;
+
+    public:
+        using MeshT = typename ScatterPattern::MeshType;
+
+    protected:
+        // Lumped mass inverse per point, zero on the boundary. Shared by all members.
+        using InvMassMatrix = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using ConstInvMassMatrix = constify_view_t<InvMassMatrix>;
+        InvMassMatrix point_mass_inv;
+        ConstInvMassMatrix point_mass_inv_readonly;
+
+        // -k * dt for each member
+        Kokkos::View<const double *> member_scales;
+
+        MeshT mesh;
+        ScatterPattern scatter_pattern;
+        std::vector<EnsembleMember> members;
+
+        // Parameters
+        int n_members;
+        double dt;
+        int n_total_steps;
+
+    public:
+        double time() { return dt * n_total_steps; }
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Assemble and invert the lumped mass matrix, masking out boundary points.
+         */
+        void setup_mass_matrix();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Match every member to its analytical solution at t = 0.
+         */
+        void setup_initial_conditions();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Swap the state buffers and clear the one receiving the new state.
+         */
+        void swap_buffers();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Compute the full new state of every member from the previous one.
+         */
+        void compute_step();
+
+    public:
+        // Weight buffers, indexed (point, member). LayoutRight keeps a point's members contiguous.
+        using PointWeightBuffer = Kokkos::View<double **, Kokkos::LayoutRight, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using ConstPointWeightBuffer = constify_view_t<PointWeightBuffer>;
+        PointWeightBuffer current_point_weights;
+        PointWeightBuffer prev_point_weights;
+        ConstPointWeightBuffer prev_point_weights_readonly;
+
+        EnsembleSolver(MeshT mesh, ScatterPattern pattern, std::vector<EnsembleMember> members, double timestep);
+
+        int member_count() { return n_members; }
+
+        /**
+         * Runs the next n steps of every member.
+         */
+        void simulate_steps(int n_steps);
+
+        /**
+         * Mean squared error of one member against its analytic solution, over the interior points
+         * (see Solver::measure_error).
+         */
+        double measure_error(int member);
+
+        /**
+         * measure_error() for every member, in order.
+         */
+        std::vector<double> measure_errors();
+    };
+
+    namespace EnsembleImpl
+    {
+        /**
+         * Functor called once per element when assembling the diagonal lumped mass matrix.
+         */
+        template <typename ScatterPattern>
+        struct MassMatrixFunctor
+        {
+            using SolverT = EnsembleSolver<ScatterPattern>;
+
+            typename SolverT::InvMassMatrix inv_mass;
+            typename SolverT::MeshT mesh;
+
+            MassMatrixFunctor(typename SolverT::InvMassMatrix inv_mass,
+                              typename SolverT::MeshT mesh)
+                : inv_mass(inv_mass),
+                  mesh(mesh)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+
+        /**
+         * Functor computing the new state of every member at an element's points, including the
+         * identity term. The geometry is computed once and applied to each member in turn.
+         */
+        template <typename ScatterPattern>
+        struct ElementContributionFunctor
+        {
+            using SolverT = EnsembleSolver<ScatterPattern>;
+
+            typename SolverT::PointWeightBuffer new_points;
+            typename SolverT::ConstPointWeightBuffer prev_points;
+            typename SolverT::ConstInvMassMatrix inv_mass;
+            Kokkos::View<const double *> member_scales;
+            typename SolverT::MeshT mesh;
+            int n_members;
+
+            ElementContributionFunctor(typename SolverT::PointWeightBuffer new_points,
+                                       typename SolverT::ConstPointWeightBuffer prev_points,
+                                       typename SolverT::ConstInvMassMatrix inv_mass,
+                                       Kokkos::View<const double *> member_scales,
+                                       typename SolverT::MeshT mesh,
+                                       int n_members)
+                : new_points(new_points),
+                  prev_points(prev_points),
+                  inv_mass(inv_mass),
+                  member_scales(member_scales),
+                  mesh(mesh),
+                  n_members(n_members)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+    }
+
+    extern template class EnsembleSolver<ColoredElementScatterAdd>;
+    extern template class EnsembleSolver<AtomicElementScatterAdd>;
+    extern template class EnsembleSolver<SerialElementScatterAdd>;
+    extern template class EnsembleSolver<SoAColoredElementScatterAdd>;
+    extern template class EnsembleSolver<SoAAtomicElementScatterAdd>;
+    extern template class EnsembleSolver<SoASerialElementScatterAdd>;
+} // namespace TFEM
+
+#endif
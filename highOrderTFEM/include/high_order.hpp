@@ -0,0 +1,599 @@
+/**
+ * Higher order (P2, P3, ...) triangular elements, with the reference element tables generated at
+ * compile time.
+ */
+#ifndef highOrderTFEM_high_order_hpp
+#define highOrderTFEM_high_order_hpp
+
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+#include "type_magic.hpp"
+#include "analytical.hpp"
+#include "scatter_pattern.hpp"
+
+namespace TFEM
+{
+    /**
+     * Tables for the order-P mass-lumped triangle on the reference triangle (0, 0), (1, 0), (0, 1),
+     * with barycentric coordinates l0 = 1 - xi - eta, l1 = xi, l2 = eta.
+     *
+     * Plain Lagrange elements above P1 cannot be lumped well: row-sum lumping gives zero or
+     * negative vertex masses, and diagonal scaling (HRZ) loses consistency, which costs the whole
+     * point of going to higher order. Instead the space is P_P enriched with the cubic bubble
+     * b = l0 l1 l2 times the degree P - 2 monomials, and the nodes are placed at the points of a
+     * positive quadrature rule exact to degree 2P - 1 (Cohen, Joly, Roberts and Tordjman 2001).
+     * Integrating the mass matrix with that nodal rule makes it diagonal without losing accuracy.
+     *  - P1: the 3 vertices (plain linear element).
+     *  - P2: vertices, edge midpoints and the centroid (7 nodes).
+     *  - P3: vertices, 2 nodes per edge and 3 interior nodes (12 nodes).
+     *
+     * Nodes are ordered:
+     *  - the 3 vertices,
+     *  - P - 1 nodes on each edge, edge k running from vertex k to vertex (k + 1) % 3,
+     *  - the interior nodes.
+     * Edge node positions are symmetric (edge_node_position[t] = 1 - edge_node_position[P - 2 - t]),
+     * so the same nodes are found walking an edge either way.
+     *
+     * The stiffness matrices use Gauss-Legendre on the square collapsed onto the triangle (Duffy),
+     * with P + 1 points per direction, which is exact for the degree 2P gradient products.
+     *
+     * Everything is filled in by build_reference_element<P>() as a constant expression.
+     */
+    template <int P>
+    struct ReferenceElement
+    {
+        static_assert(P >= 1 && P <= 3, "Mass-lumped nodal rules are only tabulated for P <= 3");
+
+        static constexpr int order = P;
+        static constexpr int n_nodes = (P + 1) * (P + 2) / 2 + (P - 1);
+        static constexpr int n_edge_nodes = P - 1; // per edge
+        static constexpr int n_interior_nodes = n_nodes - 3 - 3 * n_edge_nodes;
+        static constexpr int n_quadrature = (P + 1) * (P + 1);
+
+        // Barycentric coordinates of each node
+        double node_barycentric[n_nodes][3];
+        // Position of each edge node as a fraction of the way along its edge
+        double edge_node_position[n_edge_nodes > 0 ? n_edge_nodes : 1];
+
+        // Quadrature rule over the reference triangle (weights sum to its area, 1/2)
+        double quad_xi[n_quadrature];
+        double quad_eta[n_quadrature];
+        double quad_weight[n_quadrature];
+
+        // Basis values and reference gradients at each quadrature point
+        double basis[n_quadrature][n_nodes];
+        double basis_dxi[n_quadrature][n_nodes];
+        double basis_deta[n_quadrature][n_nodes];
+
+        // Reference stiffness. On an element with Jacobian J, the stiffness matrix is
+        //   |det J| * (G_00 * stiffness_xi_xi + G_01 * stiffness_xi_eta + G_11 * stiffness_eta_eta)
+        // with G = J^-1 J^-T. stiffness_xi_eta holds both cross terms, so all three are symmetric.
+        double stiffness_xi_xi[n_nodes][n_nodes];
+        double stiffness_xi_eta[n_nodes][n_nodes];
+        double stiffness_eta_eta[n_nodes][n_nodes];
+
+        // Lumped mass on the reference element: the nodal quadrature weights (all positive)
+        double lumped_mass[n_nodes];
+    };
+
+    namespace HighOrderImpl
+    {
+        // Gauss-Legendre points and weights on [-1, 1]
+        struct GaussLegendreRule
+        {
+            double points[4];
+            double weights[4];
+        };
+
+        KOKKOS_INLINE_FUNCTION constexpr GaussLegendreRule gauss_legendre(int n)
+        {
+            switch (n)
+            {
+            case 1:
+                return {{0.0}, {2.0}};
+            case 2:
+                return {{-0.5773502691896257, 0.5773502691896257}, {1.0, 1.0}};
+            case 3:
+                return {{-0.7745966692414834, 0.0, 0.7745966692414834}, {0.5555555555555556, 0.8888888888888888, 0.5555555555555556}};
+            default:
+                return {{-0.8611363115940526, -0.3399810435848563, 0.3399810435848563, 0.8611363115940526},
+                        {0.3478548451374538, 0.6521451548625461, 0.6521451548625461, 0.3478548451374538}};
+            }
+        }
+
+        /**
+         * Nodal quadrature of the mass-lumped element, as the orbits of the symmetry group of the
+         * triangle. Weights sum to the reference area, 1/2.
+         */
+        struct NodalRule
+        {
+            double vertex_weight;
+            // Edge nodes sit at (1 - s, s) along each edge, s from edge_positions
+            double edge_positions[2];
+            double edge_weight;
+            // Interior nodes: the centroid, or the permutations of (1 - 2 * a, a, a)
+            bool centroid;
+            double interior_offset;
+            double interior_weight;
+        };
+
+        KOKKOS_INLINE_FUNCTION constexpr NodalRule nodal_rule(int P)
+        {
+            switch (P)
+            {
+            case 1:
+                return {1.0 / 6, {0.0, 0.0}, 0.0, false, 0.0, 0.0};
+            case 2:
+                return {1.0 / 40, {0.5, 0.0}, 1.0 / 15, true, 0.0, 9.0 / 40};
+            default:
+                return {0.007436456512410242, {0.2934695559090392, 0.7065304440909608}, 0.024420840617025628,
+                        false, 0.2073451756635912, 0.11038852892020516};
+            }
+        }
+
+        KOKKOS_INLINE_FUNCTION constexpr double int_power(double x, int n)
+        {
+            double value = 1;
+            for (int i = 0; i < n; i++)
+            {
+                value *= x;
+            }
+            return value;
+        }
+
+        /**
+         * The m-th function spanning the element space along with its gradient: first the
+         * monomials xi^a eta^b with a + b <= P, then the bubble times those of degree P - 2.
+         */
+        KOKKOS_INLINE_FUNCTION constexpr void space_function(int P, int m, double xi, double eta, double &value, double &d_xi, double &d_eta)
+        {
+            int n_polynomial = (P + 1) * (P + 2) / 2;
+            bool bubble = m >= n_polynomial;
+            int degree = 0;
+            if (bubble)
+            {
+                m -= n_polynomial;
+                degree = P - 2;
+            }
+            else
+            {
+                for (; m > degree; degree++)
+                {
+                    m -= degree + 1;
+                }
+            }
+            int a = degree - m;
+            int b = m;
+            double monomial = int_power(xi, a) * int_power(eta, b);
+            double monomial_dxi = a > 0 ? a * int_power(xi, a - 1) * int_power(eta, b) : 0;
+            double monomial_deta = b > 0 ? b * int_power(xi, a) * int_power(eta, b - 1) : 0;
+            if (!bubble)
+            {
+                value = monomial;
+                d_xi = monomial_dxi;
+                d_eta = monomial_deta;
+                return;
+            }
+            double bubble_value = xi * eta * (1 - xi - eta);
+            value = bubble_value * monomial;
+            d_xi = eta * (1 - 2 * xi - eta) * monomial + bubble_value * monomial_dxi;
+            d_eta = xi * (1 - xi - 2 * eta) * monomial + bubble_value * monomial_deta;
+        }
+
+        // Gauss-Jordan inversion with partial pivoting, usable in constant expressions
+        template <int N>
+        KOKKOS_INLINE_FUNCTION constexpr void invert_matrix(double (&a)[N][N], double (&inverse)[N][N])
+        {
+            for (int i = 0; i < N; i++)
+            {
+                for (int j = 0; j < N; j++)
+                {
+                    inverse[i][j] = (i == j) ? 1 : 0;
+                }
+            }
+            for (int col = 0; col < N; col++)
+            {
+                int pivot = col;
+                for (int row = col + 1; row < N; row++)
+                {
+                    double candidate = a[row][col] < 0 ? -a[row][col] : a[row][col];
+                    double best = a[pivot][col] < 0 ? -a[pivot][col] : a[pivot][col];
+                    if (candidate > best)
+                    {
+                        pivot = row;
+                    }
+                }
+                for (int j = 0; j < N; j++)
+                {
+                    double t = a[col][j];
+                    a[col][j] = a[pivot][j];
+                    a[pivot][j] = t;
+                    t = inverse[col][j];
+                    inverse[col][j] = inverse[pivot][j];
+                    inverse[pivot][j] = t;
+                }
+                double scale = 1 / a[col][col];
+                for (int j = 0; j < N; j++)
+                {
+                    a[col][j] *= scale;
+                    inverse[col][j] *= scale;
+                }
+                for (int row = 0; row < N; row++)
+                {
+                    if (row != col)
+                    {
+                        double factor = a[row][col];
+                        for (int j = 0; j < N; j++)
+                        {
+                            a[row][j] -= factor * a[col][j];
+                            inverse[row][j] -= factor * inverse[col][j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <int P>
+    KOKKOS_INLINE_FUNCTION constexpr ReferenceElement<P> build_reference_element()
+    {
+        using Ref = ReferenceElement<P>;
+        constexpr int N = Ref::n_nodes;
+        ReferenceElement<P> ref = {};
+        HighOrderImpl::NodalRule nodal = HighOrderImpl::nodal_rule(P);
+
+        // Nodes and their weights: vertices, then edges, then the interior
+        int node = 0;
+        for (int v = 0; v < 3; v++)
+        {
+            ref.node_barycentric[node][v] = 1;
+            ref.lumped_mass[node] = nodal.vertex_weight;
+            node++;
+        }
+        for (int t = 0; t < Ref::n_edge_nodes; t++)
+        {
+            ref.edge_node_position[t] = nodal.edge_positions[t];
+        }
+        for (int edge = 0; edge < 3; edge++)
+        {
+            for (int t = 0; t < Ref::n_edge_nodes; t++)
+            {
+                ref.node_barycentric[node][edge] = 1 - nodal.edge_positions[t];
+                ref.node_barycentric[node][(edge + 1) % 3] = nodal.edge_positions[t];
+                ref.lumped_mass[node] = nodal.edge_weight;
+                node++;
+            }
+        }
+        for (int m = 0; m < Ref::n_interior_nodes; m++)
+        {
+            for (int v = 0; v < 3; v++)
+            {
+                if (nodal.centroid)
+                {
+                    ref.node_barycentric[node][v] = 1.0 / 3;
+                }
+                else
+                {
+                    ref.node_barycentric[node][v] = (v == m) ? 1 - 2 * nodal.interior_offset : nodal.interior_offset;
+                }
+            }
+            ref.lumped_mass[node] = nodal.interior_weight;
+            node++;
+        }
+
+        // Nodal basis: coefficients of each basis function in the spanning functions, from the
+        // inverse of the Vandermonde-like matrix V(i, m) = f_m(node i)
+        double vandermonde[N][N] = {};
+        double coefficients[N][N] = {};
+        for (int i = 0; i < N; i++)
+        {
+            for (int m = 0; m < N; m++)
+            {
+                double d_xi = 0, d_eta = 0;
+                HighOrderImpl::space_function(P, m, ref.node_barycentric[i][1], ref.node_barycentric[i][2], vandermonde[i][m], d_xi, d_eta);
+            }
+        }
+        HighOrderImpl::invert_matrix<N>(vandermonde, coefficients);
+
+        // Collapsed Gauss-Legendre: xi = u, eta = v * (1 - u) over the unit square
+        HighOrderImpl::GaussLegendreRule rule = HighOrderImpl::gauss_legendre(P + 1);
+        for (int a = 0; a < P + 1; a++)
+        {
+            for (int b = 0; b < P + 1; b++)
+            {
+                int q = a * (P + 1) + b;
+                double u = 0.5 * (rule.points[a] + 1);
+                double v = 0.5 * (rule.points[b] + 1);
+                ref.quad_xi[q] = u;
+                ref.quad_eta[q] = v * (1 - u);
+                ref.quad_weight[q] = 0.25 * rule.weights[a] * rule.weights[b] * (1 - u);
+            }
+        }
+
+        // Basis values and gradients at the quadrature points
+        for (int q = 0; q < Ref::n_quadrature; q++)
+        {
+            double values[N] = {}, d_xi[N] = {}, d_eta[N] = {};
+            for (int m = 0; m < N; m++)
+            {
+                HighOrderImpl::space_function(P, m, ref.quad_xi[q], ref.quad_eta[q], values[m], d_xi[m], d_eta[m]);
+            }
+            for (int n = 0; n < N; n++)
+            {
+                for (int m = 0; m < N; m++)
+                {
+                    ref.basis[q][n] += coefficients[m][n] * values[m];
+                    ref.basis_dxi[q][n] += coefficients[m][n] * d_xi[m];
+                    ref.basis_deta[q][n] += coefficients[m][n] * d_eta[m];
+                }
+            }
+        }
+
+        // Reference stiffness matrices
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                double xi_xi = 0, xi_eta = 0, eta_eta = 0;
+                for (int q = 0; q < Ref::n_quadrature; q++)
+                {
+                    double w = ref.quad_weight[q];
+                    xi_xi += w * ref.basis_dxi[q][i] * ref.basis_dxi[q][j];
+                    xi_eta += w * (ref.basis_dxi[q][i] * ref.basis_deta[q][j] + ref.basis_deta[q][i] * ref.basis_dxi[q][j]);
+                    eta_eta += w * ref.basis_deta[q][i] * ref.basis_deta[q][j];
+                }
+                ref.stiffness_xi_xi[i][j] = xi_xi;
+                ref.stiffness_xi_eta[i][j] = xi_eta;
+                ref.stiffness_eta_eta[i][j] = eta_eta;
+            }
+        }
+        return ref;
+    }
+
+    template <int P, typename ScatterPattern>
+    class HighOrderSolver;
+
+    namespace HighOrderImpl
+    {
+        template <int P, typename ScatterPattern>
+        struct ElementDofFunctor;
+
+        template <int P, typename ScatterPattern>
+        struct MassMatrixFunctor;
+
+        template <int P, typename ScatterPattern>
+        struct ElementContributionFunctor;
+    }
+
+    /**
+     * Explicit, mass-lumped solver for the heat equation using the order-P triangles of
+     * ReferenceElement (on straight-sided elements). Works like Solver with the fused step mode: the state buffers are
+     * swapped each step, every element adds its share of the identity term, and the boundary
+     * nodes are masked out of the update by zeroing their inverse mass.
+     *
+     * Degrees of freedom are numbered:
+     *  - the mesh points, so the first point_count() entries line up with the mesh,
+     *  - P - 1 nodes per mesh edge, running from edges(e)[0] to edges(e)[1],
+     *  - the interior nodes of each element, in the scatter pattern's slot order.
+     * Edge nodes are matched to elements through the mesh edges, so every element edge must be
+     * in the mesh's edge list.
+     *
+     * Elements sharing an edge also share its endpoints, so any pattern that is safe for linear
+     * elements (e.g. a point coloring) is safe here as well.
+     */
+    template <int P, typename ScatterPattern>
+    class HighOrderSolver
+    {
+        friend class HighOrderImpl::ElementDofFunctor<P, ScatterPattern>;
+        friend class HighOrderImpl::MassMatrixFunctor<P, ScatterPattern>;
+        friend class HighOrderImpl::ElementContributionFunctor<P, ScatterPattern>;
+
+    public:
+        using MeshT = typename ScatterPattern::MeshType;
+        using Element = ReferenceElement<P>;
+
+    protected:
+        // Lumped mass inverse per degree of freedom, zero on the boundary
+        using InvMassMatrix = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using ConstInvMassMatrix = constify_view_t<InvMassMatrix>;
+        InvMassMatrix dof_mass_inv;
+        ConstInvMassMatrix dof_mass_inv_readonly;
+
+        // Global degree of freedom of each element node, by slot
+        using ElementDofMap = Kokkos::View<int **, Kokkos::LayoutLeft>;
+        using ConstElementDofMap = constify_view_t<ElementDofMap>;
+        ElementDofMap element_dofs;
+
+        MeshT mesh;
+        ScatterPattern scatter_pattern;
+        Analytical::ZeroBoundary<> boundary;
+
+        // Parameters
+        int n_dofs;
+        int n_boundary_dofs;
+        double dt;
+        double k;
+        int n_total_steps;
+
+    public:
+        double time() { return dt * n_total_steps; }
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Numbers the edge and interior nodes, fills element_dofs, dof_coords and dof_boundary.
+         * Sets n_dofs, so must run before any per-node buffer is allocated.
+         */
+        void setup_dofs();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Assemble and invert the lumped mass matrix, masking out boundary nodes.
+         */
+        void setup_mass_matrix();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Match every node to the analytical solution at t = 0.
+         */
+        void setup_initial_conditions();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Swap the state buffers and clear the one receiving the new state.
+         */
+        void swap_buffers();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Compute the full new state from the previous one.
+         */
+        void compute_step();
+
+    public:
+        // Weight buffers for the nodal values
+        using DofWeightBuffer = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using ConstDofWeightBuffer = constify_view_t<DofWeightBuffer>;
+        DofWeightBuffer current_dof_weights;
+        DofWeightBuffer prev_dof_weights;
+        ConstDofWeightBuffer prev_dof_weights_readonly;
+
+        // Position of each degree of freedom
+        Kokkos::View<double *[2]> dof_coords;
+        // Whether each degree of freedom lies on the boundary
+        Kokkos::View<bool *> dof_boundary;
+
+        HighOrderSolver(MeshT mesh, ScatterPattern pattern, Analytical::ZeroBoundary<> boundary_conditions, double timestep, double k);
+
+        /**
+         * Number of degrees of freedom. The first point_count() are the mesh points, so
+         * subview(current_dof_weights, pair(0, point_count())) can be written like a linear solution.
+         */
+        int dof_count() { return n_dofs; }
+
+        /**
+         * Runs the next n steps of the simulation.
+         */
+        void simulate_steps(int n_steps);
+
+        /**
+         * Mean squared error against the analytic solution over all non-boundary nodes.
+         */
+        double measure_error();
+    };
+
+    namespace HighOrderImpl
+    {
+        /**
+         * Functor called once per element to find the global node numbers of its edge and interior
+         * nodes, and to place its interior nodes.
+         */
+        template <int P, typename ScatterPattern>
+        struct ElementDofFunctor
+        {
+            using SolverT = HighOrderSolver<P, ScatterPattern>;
+
+            typename SolverT::ElementDofMap element_dofs;
+            Kokkos::View<double *[2]> dof_coords;
+            // Edges touching each point, as CSR
+            Kokkos::View<const int *> point_edge_offsets;
+            Kokkos::View<const int *> point_edges;
+            typename SolverT::MeshT mesh;
+            // First edge node and first interior node DOF
+            int edge_base;
+            int interior_base;
+
+            ElementDofFunctor(typename SolverT::ElementDofMap element_dofs,
+                              Kokkos::View<double *[2]> dof_coords,
+                              Kokkos::View<const int *> point_edge_offsets,
+                              Kokkos::View<const int *> point_edges,
+                              typename SolverT::MeshT mesh)
+                : element_dofs(element_dofs),
+                  dof_coords(dof_coords),
+                  point_edge_offsets(point_edge_offsets),
+                  point_edges(point_edges),
+                  mesh(mesh),
+                  edge_base(mesh.point_count()),
+                  interior_base(mesh.point_count() + mesh.edge_count() * ReferenceElement<P>::n_edge_nodes)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+
+        /**
+         * Functor called once per element to add its lumped mass to each of its nodes.
+         */
+        template <int P, typename ScatterPattern>
+        struct MassMatrixFunctor
+        {
+            using SolverT = HighOrderSolver<P, ScatterPattern>;
+
+            typename SolverT::InvMassMatrix inv_mass;
+            typename SolverT::ConstElementDofMap element_dofs;
+            typename SolverT::MeshT mesh;
+
+            MassMatrixFunctor(typename SolverT::InvMassMatrix inv_mass,
+                              typename SolverT::ConstElementDofMap element_dofs,
+                              typename SolverT::MeshT mesh)
+                : inv_mass(inv_mass),
+                  element_dofs(element_dofs),
+                  mesh(mesh)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+
+        /**
+         * Functor computing the contribution each element makes to the new state, including its
+         * share of the identity term. Loops over the element nodes are unrolled at compile time.
+         */
+        template <int P, typename ScatterPattern>
+        struct ElementContributionFunctor
+        {
+            using SolverT = HighOrderSolver<P, ScatterPattern>;
+
+            typename SolverT::DofWeightBuffer new_dofs;
+            typename SolverT::ConstDofWeightBuffer prev_dofs;
+            typename SolverT::ConstInvMassMatrix inv_mass;
+            typename SolverT::ConstElementDofMap element_dofs;
+            typename SolverT::MeshT mesh;
+            double k;
+            double dt;
+
+            ElementContributionFunctor(typename SolverT::DofWeightBuffer new_dofs,
+                                       typename SolverT::ConstDofWeightBuffer prev_dofs,
+                                       typename SolverT::ConstInvMassMatrix inv_mass,
+                                       typename SolverT::ConstElementDofMap element_dofs,
+                                       typename SolverT::MeshT mesh,
+                                       double k, double dt)
+                : new_dofs(new_dofs),
+                  prev_dofs(prev_dofs),
+                  inv_mass(inv_mass),
+                  element_dofs(element_dofs),
+                  mesh(mesh),
+                  k(k),
+                  dt(dt)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+    }
+
+    extern template class HighOrderSolver<2, ColoredElementScatterAdd>;
+    extern template class HighOrderSolver<2, AtomicElementScatterAdd>;
+    extern template class HighOrderSolver<2, SerialElementScatterAdd>;
+    extern template class HighOrderSolver<3, ColoredElementScatterAdd>;
+    extern template class HighOrderSolver<3, AtomicElementScatterAdd>;
+    extern template class HighOrderSolver<3, SerialElementScatterAdd>;
+    extern template class HighOrderSolver<2, SoAColoredElementScatterAdd>;
+    extern template class HighOrderSolver<2, SoAAtomicElementScatterAdd>;
+    extern template class HighOrderSolver<2, SoASerialElementScatterAdd>;
+    extern template class HighOrderSolver<3, SoAColoredElementScatterAdd>;
+    extern template class HighOrderSolver<3, SoAAtomicElementScatterAdd>;
+    extern template class HighOrderSolver<3, SoASerialElementScatterAdd>;
+} // namespace TFEM
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * Per-phase timers and counters, and the Kokkos Tools regions that go with them.
+ */
+#ifndef highOrderTFEM_instrumentation_hpp
+#define highOrderTFEM_instrumentation_hpp
+
+#include <map>
+#include <ostream>
+#include <string>
+
+#include <Kokkos_Core.hpp>
+
+namespace TFEM
+{
+    /**
+     * What has been recorded for one phase, summed over its calls. Bytes are those of the phase's
+     * memory traffic model (see ScopedPhase), not measured.
+     */
+    struct PhaseStats
+    {
+        long long calls = 0;
+        double seconds = 0;
+        double bytes = 0;
+        double elements = 0;
+    };
+
+    /**
+     * Library-wide registry of phase statistics, filled by ScopedPhase. Off by default.
+     */
+    namespace Instrumentation
+    {
+        /**
+         * Turns timing on or off. While on, every phase fences its execution space instance when it
+         * starts and ends so that device work is attributed to the right phase, which also removes
+         * any overlap between phases on that instance: leave it off for production runs.
+         */
+        void enable(bool on = true);
+        bool enabled();
+
+        /**
+         * Adds one call of the given phase. Safe to call from several host threads.
+         */
+        void record(const std::string &phase, double seconds, double bytes = 0, double elements = 0);
+
+        /**
+         * Copy of the statistics so far, by phase name.
+         */
+        std::map<std::string, PhaseStats> phases();
+
+        void reset();
+
+        /**
+         * Writes every phase as {"phases": {name: {calls, seconds, bytes, elements,
+         * bytes_per_second, elements_per_second}, ...}}. Rates are 0 for phases with no time.
+         */
+        void write_json(std::ostream &out);
+        void write_json(std::string fname);
+    }
+
+    /**
+     * Marks the enclosing scope as a phase: always a Kokkos::Profiling region of the same name
+     * (free when no tool is loaded), and with Instrumentation enabled also a timed entry with the
+     * given modeled traffic. Phase names are "Class::function". A phase nested in another is also
+     * counted in the outer one's time. Timed phases fence the execution space instance their work
+     * runs on (the default one unless given), so phases on other instances keep running.
+     */
+    class ScopedPhase
+    {
+    protected:
+        const char *name;
+        double bytes;
+        double elements;
+        bool timed;
+        Kokkos::DefaultExecutionSpace space;
+        Kokkos::Timer timer;
+
+    public:
+        ScopedPhase(Kokkos::DefaultExecutionSpace space, const char *name, double bytes = 0, double elements = 0)
+            : name(name), bytes(bytes), elements(elements), timed(Instrumentation::enabled()), space(space)
+        {
+            Kokkos::Profiling::pushRegion(name);
+            if (timed)
+            {
+                space.fence(name);
+                timer.reset();
+            }
+        }
+
+        ScopedPhase(const char *name, double bytes = 0, double elements = 0)
+            : ScopedPhase(Kokkos::DefaultExecutionSpace(), name, bytes, elements)
+        { // Pretty much just the initializer list
+        }
+
+        /**
+         * For phases whose work is only known once they have run.
+         */
+        void add_work(double more_bytes, double more_elements = 0)
+        {
+            bytes += more_bytes;
+            elements += more_elements;
+        }
+
+        ~ScopedPhase()
+        {
+            if (timed)
+            {
+                space.fence(name);
+                Instrumentation::record(name, timer.seconds(), bytes, elements);
+            }
+            Kokkos::Profiling::popRegion();
+        }
+
+        ScopedPhase(const ScopedPhase &) = delete;
+        ScopedPhase &operator=(const ScopedPhase &) = delete;
+    };
+}
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * Local matrices of the linear (3-node) triangle, shared by the solvers built on it.
+ */
+#ifndef highOrderTFEM_linear_element_hpp
+#define highOrderTFEM_linear_element_hpp
+
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+
+namespace TFEM
+{
+    template <typename Scalar>
+    KOKKOS_INLINE_FUNCTION Scalar det_jacobian(BasicPoint<Scalar> pts[3])
+    {
+        return Scalar(0.25) * ((pts[2][0] - pts[1][0]) * (pts[0][1] - pts[1][1]) - (pts[0][0] - pts[1][0]) * (pts[2][1] - pts[1][1]));
+    }
+
+    // Contribution of an element with the given |J| to the lumped mass of each of its points.
+    template <typename Scalar>
+    KOKKOS_INLINE_FUNCTION Scalar lumped_mass_contribution(Scalar jacob)
+    {
+        // The sum of the main |J|/3 diagonal plus two |J|/6 off-diagonals for this element,
+        // which is the same for each point. (In the linear case).
+        return jacob * 2 / Scalar(3);
+    }
+
+    // Index of entry (i, j) of a symmetric 3x3 matrix packed as 00, 01, 02, 11, 12, 22
+    KOKKOS_INLINE_FUNCTION constexpr int packed_index(int i, int j)
+    {
+        return (i <= j) ? (i * (5 - i)) / 2 + j : (j * (5 - j)) / 2 + i;
+    }
+
+    /**
+     * Computes the local stiffness matrix of a linear triangle, scaled by the given factor, into the
+     * packed symmetric form. Entry (j, i) is the amount point i's value adds to the residual at point j,
+     * matching the per-point gradients in ElementContributionFunctor.
+     */
+    template <typename Scalar>
+    KOKKOS_INLINE_FUNCTION void local_stiffness(BasicPoint<Scalar> pts[3], Scalar scale, Scalar stiffness[6])
+    {
+        const Scalar half = 0.5;
+        Scalar jacob = det_jacobian(pts);
+        Scalar dx_de = half * (pts[2][0] - pts[1][0]);
+        Scalar dx_dn = half * (pts[0][0] - pts[1][0]);
+        Scalar dy_de = half * (pts[2][1] - pts[1][1]);
+        Scalar dy_dn = half * (pts[0][1] - pts[1][1]);
+        // Basis gradients for each vertex, written out rather than switched on
+        Scalar dp_dx[3] = {(half / jacob) * (-dy_de), (half / jacob) * (-dy_dn + dy_de), (half / jacob) * (dy_dn)};
+        Scalar dp_dy[3] = {(half / jacob) * (dx_de), (half / jacob) * (dx_dn - dx_de), (half / jacob) * (-dx_dn)};
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = i; j < 3; j++)
+            {
+                stiffness[packed_index(i, j)] = scale * 2 * jacob * (dp_dx[i] * dp_dx[j] + dp_dy[i] * dp_dy[j]);
+            }
+        }
+    }
+
+    /**
+     * Upper bound on the eigenvalues of the element's M_e^-1 * S_e (lumped mass), from the Gershgorin
+     * discs of its rows. The largest bound over a point's elements also bounds that point's row of the
+     * assembled M^-1 * S, so forward Euler on the mesh is stable for k*dt <= 2 / (the largest bound).
+     */
+    template <typename Scalar>
+    KOKKOS_INLINE_FUNCTION Scalar element_stiffness_bound(BasicPoint<Scalar> pts[3])
+    {
+        Scalar stiffness[6];
+        local_stiffness(pts, Scalar(1), stiffness);
+        Scalar mass = Kokkos::fabs(lumped_mass_contribution(det_jacobian(pts)));
+        Scalar bound = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            Scalar row_sum = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                row_sum += Kokkos::fabs(stiffness[packed_index(j, i)]);
+            }
+            bound = Kokkos::fmax(bound, row_sum);
+        }
+        return bound / mass;
+    }
+} // namespace TFEM
+
+#endif
\ No newline at end of file
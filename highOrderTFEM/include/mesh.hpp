@@ -6,8 +6,13 @@
 
 #include <Kokkos_Core.hpp>
 #include <Kokkos_StaticCrsGraph.hpp> // for storing boundary edges
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 namespace TFEM
 {
@@ -21,73 +26,280 @@ namespace TFEM
     // same point, but this makes it more dificult to move single points around.
 
     /**
-     * A struct containing the real-space coordinates of a point.
+     * A struct containing the real-space coordinates of a point, stored as the given scalar type.
      * Access using array [ . ] notation.
      */
-    struct Point
+    template <typename Scalar>
+    struct BasicPoint
     {
     private:
-        double coords[2];
+        Scalar coords[2];
 
     public:
+        using scalar_type = Scalar;
+
         /**
          * For i = 0 or 1, return the x or y coordinate of the point respectively.
          */
-        KOKKOS_INLINE_FUNCTION double &operator[](int i)
+        KOKKOS_INLINE_FUNCTION Scalar &operator[](int i)
         {
             return coords[i];
         }
     };
 
+    // Points as read from mesh files
+    typedef BasicPoint<double> Point;
+
+    /**
+     * Returns p with its coordinates converted to another scalar type.
+     */
+    template <typename T, typename Scalar>
+    KOKKOS_INLINE_FUNCTION BasicPoint<T> point_cast(BasicPoint<Scalar> p)
+    {
+        BasicPoint<T> result;
+        result[0] = static_cast<T>(p[0]);
+        result[1] = static_cast<T>(p[1]);
+        return result;
+    }
+
     /**
-     * A struct containing the id's of the points at the end of each edge. IDs are
-     * in the context of the original mesh this edge belongs to.
+     * A struct containing the id's of the points at the end of each edge, stored as the given
+     * index type. IDs are in the context of the original mesh this edge belongs to.
      *
      * Access using array [ . ] notation.
      */
-    struct Edge
+    template <typename Index>
+    struct BasicEdge
     {
     private:
-        pointID points[2];
+        Index points[2];
 
     public:
+        using index_type = Index;
+
         /**
          * For i = 0 or 1, return the ID of the point at the corresponding endpoint of this edge.
          */
-        KOKKOS_INLINE_FUNCTION pointID &operator[](int i)
+        KOKKOS_INLINE_FUNCTION Index &operator[](int i)
         {
             return points[i];
         }
     };
 
+    // Edges as read from mesh files
+    typedef BasicEdge<pointID> Edge;
+
     /**
      * A struct containing the id's of the points that make up the vertices of a triangular
-     * mesh region. IDs are in the context of the original mesh.
+     * mesh region, stored as the given index type. IDs are in the context of the original mesh.
      *
      * Access using array [ . ] notation.
      */
-    struct Region
+    template <typename Index>
+    struct BasicRegion
     {
     private:
-        pointID points[3];
+        Index points[3];
 
     public:
+        using index_type = Index;
+
         /**
          * For i in [0, 2], return the ID of the point at the corresponding vertex.
          */
-        KOKKOS_INLINE_FUNCTION pointID &operator[](int i)
+        KOKKOS_INLINE_FUNCTION Index &operator[](int i)
+        {
+            return points[i];
+        }
+
+        KOKKOS_INLINE_FUNCTION Index operator[](int i) const
         {
             return points[i];
         }
     };
 
+    // Regions as read from mesh files, and as the kernels see them
+    typedef BasicRegion<pointID> Region;
+
+    /**
+     * Returns r with its vertex IDs converted to another index type.
+     */
+    template <typename T, typename Index>
+    KOKKOS_INLINE_FUNCTION BasicRegion<T> region_cast(BasicRegion<Index> r)
+    {
+        BasicRegion<T> result;
+        for (int j = 0; j < 3; j++)
+        {
+            result[j] = static_cast<T>(r[j]);
+        }
+        return result;
+    }
+
+    /**
+     * A region stored as the ID of its first vertex and the (16 bit) offsets of the other two
+     * from it: 8 bytes instead of the 12 of a Region. Only holds regions whose vertex IDs are
+     * within max_offset of the first, which is the case for meshes whose points are numbered
+     * with some locality (see reorder_mesh and Mesh::with_compact_regions).
+     *
+     * Converts to and from Region, so load_region and store_region work on views of either.
+     */
+    struct CompactRegion
+    {
+    private:
+        pointID base;
+        std::int16_t offsets[2];
+
+    public:
+        using index_type = pointID;
+        static constexpr int max_offset = 32767;
+
+        CompactRegion() = default;
+
+        KOKKOS_INLINE_FUNCTION CompactRegion(Region r)
+            : base(r[0])
+        {
+            offsets[0] = static_cast<std::int16_t>(r[1] - r[0]);
+            offsets[1] = static_cast<std::int16_t>(r[2] - r[0]);
+        }
+
+        /**
+         * Whether r can be stored without losing its vertex IDs
+         */
+        KOKKOS_INLINE_FUNCTION static bool fits(Region r)
+        {
+            for (int j = 1; j < 3; j++)
+            {
+                if (r[j] - r[0] > max_offset || r[0] - r[j] > max_offset)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * For i in [0, 2], return the ID of the point at the corresponding vertex.
+         */
+        KOKKOS_INLINE_FUNCTION pointID operator[](int i) const
+        {
+            return i == 0 ? base : base + offsets[i - 1];
+        }
+
+        KOKKOS_INLINE_FUNCTION operator Region() const
+        {
+            Region r;
+            for (int j = 0; j < 3; j++)
+            {
+                r[j] = (*this)[j];
+            }
+            return r;
+        }
+    };
+
+    // Points and regions can either be stored as arrays of the structs above (array-of-structs),
+    // or as rank-2 views with one column per coordinate/vertex (structure-of-arrays, typically with
+    // LayoutLeft so that each column is contiguous). Array-of-structs regions can also be stored as
+    // CompactRegions. Vertex IDs may be stored as another index type than pointID (see
+    // Mesh::with_index). These helpers read and write single entries in any of these layouts,
+    // always handing out Regions.
+
+    /**
+     * Scalar type of the coordinates in a view of points in either layout.
+     */
+    template <class PointView>
+    using point_scalar_t = typename std::conditional_t<PointView::rank == 1,
+                                                       typename PointView::non_const_value_type,
+                                                       BasicPoint<typename PointView::non_const_value_type>>::scalar_type;
+
+    /**
+     * Index type of the vertex IDs in a view of regions in either layout.
+     */
+    template <class RegionView>
+    using region_index_t = typename std::conditional_t<RegionView::rank == 1,
+                                                       typename RegionView::non_const_value_type,
+                                                       BasicRegion<typename RegionView::non_const_value_type>>::index_type;
+
+    /**
+     * Returns point i from a view of points in either layout.
+     */
+    template <class PointView>
+    KOKKOS_INLINE_FUNCTION BasicPoint<point_scalar_t<PointView>> load_point(const PointView &points, int i)
+    {
+        if constexpr (PointView::rank == 1)
+        {
+            return points(i);
+        }
+        else
+        {
+            BasicPoint<point_scalar_t<PointView>> p;
+            p[0] = points(i, 0);
+            p[1] = points(i, 1);
+            return p;
+        }
+    }
+
+    /**
+     * Returns region i from a view of regions in either layout.
+     */
+    template <class RegionView>
+    KOKKOS_INLINE_FUNCTION Region load_region(const RegionView &regions, int i)
+    {
+        if constexpr (RegionView::rank == 1 && std::is_convertible_v<typename RegionView::non_const_value_type, Region>)
+        {
+            return regions(i);
+        }
+        else if constexpr (RegionView::rank == 1)
+        {
+            return region_cast<pointID>(regions(i));
+        }
+        else
+        {
+            Region r;
+            for (int j = 0; j < 3; j++)
+            {
+                r[j] = static_cast<pointID>(regions(i, j));
+            }
+            return r;
+        }
+    }
+
+    /**
+     * Stores r as region i of a view of regions in either layout.
+     */
+    template <class RegionView>
+    KOKKOS_INLINE_FUNCTION void store_region(const RegionView &regions, int i, Region r)
+    {
+        using Index = region_index_t<RegionView>;
+        if constexpr (RegionView::rank == 1 && std::is_constructible_v<typename RegionView::non_const_value_type, Region>)
+        {
+            regions(i) = r;
+        }
+        else if constexpr (RegionView::rank == 1)
+        {
+            regions(i) = region_cast<Index>(r);
+        }
+        else
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                regions(i, j) = static_cast<Index>(r[j]);
+            }
+        }
+    }
+
     /**
      * Represents a mesh as a list of points, edges, and regions. Also contains information
      * on the boundary edges (grouped in segments) and boundary points. Typically, create
      * this mesh by calling "load_meshes_from_grd_file".
      *
      * Templates on various view types to accomodate different execution spaces and memory
-     * access patterns. All views should be accessible from the same space.
+     * access patterns. All views should be accessible from the same space. Points and regions
+     * may be stored either as arrays of Point/Region structs, or as (n, 2) / (n, 3) rank-2 views.
+     * Code that should work with both layouts goes through the point()/region() accessors.
+     *
+     * Edges and regions store their vertex IDs as the same index type, pointID unless the mesh
+     * was made by with_index. The accessors (and so the kernels) still hand out pointIDs, so a
+     * mesh must have fewer points than pointID can count in any case.
      */
     template <class PointView, class EdgeView, class RegionView>
     class Mesh
@@ -101,9 +313,16 @@ namespace TFEM
         using MemSpace = typename PointView::memory_space;
         static_assert(Kokkos::SpaceAccessibility<MemSpace, typename EdgeView::memory_space>::accessible);
         static_assert(Kokkos::SpaceAccessibility<MemSpace, typename RegionView::memory_space>::accessible);
-        static_assert(std::is_same_v<typename PointView::data_type, Point *>, "PointView must be array of points");
-        static_assert(std::is_same_v<typename EdgeView::data_type, Edge *>, "EdgeView must be array of edges");
-        static_assert(std::is_same_v<typename RegionView::data_type, Region *>, "RegionView must be array of regions");
+        static_assert(std::is_same_v<typename PointView::data_type, BasicPoint<point_scalar_t<PointView>> *> ||
+                          std::is_same_v<typename PointView::data_type, point_scalar_t<PointView> *[2]>,
+                      "PointView must be array of points or (n, 2) array of coordinates");
+        static_assert(std::is_floating_point_v<point_scalar_t<PointView>>, "Point coordinates must be floating point");
+        static_assert(std::is_integral_v<region_index_t<RegionView>>, "Vertex IDs must be integers");
+        static_assert(std::is_same_v<typename EdgeView::data_type, BasicEdge<region_index_t<RegionView>> *>, "EdgeView must be array of edges, with the regions' index type");
+        static_assert(std::is_same_v<typename RegionView::data_type, BasicRegion<region_index_t<RegionView>> *> || std::is_same_v<typename RegionView::data_type, CompactRegion *> ||
+                          std::is_same_v<typename RegionView::data_type, region_index_t<RegionView> *[3]>,
+                      "RegionView must be array of regions or compact regions, or (n, 3) array of vertex ids");
+        static_assert(PointView::rank == RegionView::rank, "Points and regions must use the same layout");
 
         // By default, different specializations of the same class don't have access to each other's private
         // members. We need this access for setting up device copies etc.
@@ -116,10 +335,43 @@ namespace TFEM
         int n_regions;
 
     public:
+        // True if points and regions are stored as one view column per coordinate/vertex
+        static constexpr bool is_soa = (PointView::rank == 2);
+        // True if regions are stored as CompactRegions (see with_compact_regions)
+        static constexpr bool has_compact_regions = std::is_same_v<typename RegionView::data_type, CompactRegion *>;
+
+        // Type the coordinates are stored as
+        using Scalar = point_scalar_t<PointView>;
+        using PointType = BasicPoint<Scalar>;
+
+        // Type the vertex IDs of edges and regions are stored as
+        using Index = region_index_t<RegionView>;
+
+        // Same mesh, with the coordinates stored as another scalar type (see with_point_scalar)
+        template <typename T>
+        using WithPointScalar = Mesh<std::conditional_t<is_soa,
+                                                        Kokkos::View<T *[2], typename PointView::array_layout, typename PointView::execution_space>,
+                                                        Kokkos::View<BasicPoint<T> *, typename PointView::execution_space>>,
+                                     EdgeView, RegionView>;
+
+        // Same mesh, with the vertex IDs stored as another index type (see with_index)
+        template <typename I>
+        using WithIndex = Mesh<PointView,
+                               Kokkos::View<BasicEdge<I> *, typename EdgeView::execution_space>,
+                               std::conditional_t<is_soa,
+                                                  Kokkos::View<I *[3], typename RegionView::array_layout, typename RegionView::execution_space>,
+                                                  Kokkos::View<BasicRegion<I> *, typename RegionView::execution_space>>>;
+
+        // Same mesh, with the regions stored as CompactRegions (see with_compact_regions)
+        using WithCompactRegions = Mesh<PointView, EdgeView, Kokkos::View<CompactRegion *, typename RegionView::execution_space>>;
+
         // Create a host mirror specialization for each specialization.
         typedef Mesh<typename PointView::HostMirror, typename EdgeView::HostMirror, typename RegionView::HostMirror> HostMirrorMesh;
 
         // Main buffers
+        using PointViewType = PointView;
+        using EdgeViewType = EdgeView;
+        using RegionViewType = RegionView;
         PointView points;
         EdgeView edges;
         RegionView regions;
@@ -143,6 +395,13 @@ namespace TFEM
         using BoundaryPointIndicator = Kokkos::View<bool *, typename EdgeView::execution_space>;
         BoundaryPointIndicator boundary_points;
 
+        /**
+         * The IDs of the boundary points, each listed once, in increasing order. Has
+         * n_boundary_points entries. Lets boundary work run over just those points.
+         */
+        using BoundaryPointList = Kokkos::View<pointID *, typename EdgeView::execution_space>;
+        BoundaryPointList boundary_point_ids;
+
         /**
          * Sometimes need to leave an uninitialized mesh for later initialization
          */
@@ -217,6 +476,240 @@ namespace TFEM
             Kokkos::deep_copy(dest.regions, regions);
         }
 
+        /**
+         * Returns a mesh sharing this mesh's edges, regions and boundary data, with a converted
+         * copy of the point coordinates. Used to run with single precision geometry, since mesh
+         * files are always read in double. The copy is made on space.
+         */
+        template <typename T>
+        WithPointScalar<T> with_point_scalar(Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+        {
+            WithPointScalar<T> converted;
+            converted.n_points = n_points;
+            converted.n_edges = n_edges;
+            converted.n_regions = n_regions;
+            converted.edges = edges;
+            converted.regions = regions;
+            converted.n_boundary_points = n_boundary_points;
+            converted.boundary_edges = boundary_edges;
+            converted.boundary_points = boundary_points;
+            converted.boundary_point_ids = boundary_point_ids;
+            converted.points = typename WithPointScalar<T>::PointViewType("mesh_points", n_points);
+
+            auto src = *this;
+            auto dest = converted;
+            Kokkos::parallel_for(
+                Kokkos::RangePolicy<>(space, 0, n_points), KOKKOS_LAMBDA(int i) {
+                for (int dim = 0; dim < 2; dim++) {
+                    dest.coord(i, dim) = static_cast<T>(src.coord(i, dim));
+                } });
+            space.fence();
+            return converted;
+        }
+
+        /**
+         * Returns a mesh sharing this mesh's points, edges and boundary data, whose regions are a
+         * copy of regions [begin, end) of this one. Lets a subset of the elements be run through
+         * a scatter pattern on its own while writing to the same points. The copy is made on space.
+         */
+        Mesh with_region_range(int begin, int end, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+        {
+            Mesh subset = *this;
+            subset.n_regions = end - begin;
+            subset.regions = RegionView("mesh_regions", end - begin);
+
+            auto src = *this;
+            auto dest = subset;
+            Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, end - begin), KOKKOS_LAMBDA(int i) { store_region(dest.regions, i, src.region(begin + i)); });
+            space.fence();
+            return subset;
+        }
+
+        /**
+         * Like with_region_range, but the regions of the returned mesh are the regions of this one
+         * listed in region_ids (a view in the mesh's memory space), in that order.
+         */
+        template <class IdView>
+        Mesh with_region_subset(IdView region_ids, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+        {
+            int n_subset = region_ids.extent(0);
+            Mesh subset = *this;
+            subset.n_regions = n_subset;
+            subset.regions = RegionView("mesh_regions", n_subset);
+
+            auto src = *this;
+            auto dest = subset;
+            Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, n_subset), KOKKOS_LAMBDA(int i) { store_region(dest.regions, i, src.region(region_ids(i))); });
+            space.fence();
+            return subset;
+        }
+
+        /**
+         * Returns a mesh sharing this mesh's points, edges and boundary data, with its regions
+         * (in the same order) stored as CompactRegions, 8 bytes per region instead of 12. Throws
+         * if some region has vertex IDs too far apart for a CompactRegion; reorder_mesh leaves
+         * the vertices of each region close together, and the generated square meshes fit as
+         * they are. Only for meshes with array-of-structs regions. The copy is made on space.
+         */
+        WithCompactRegions with_compact_regions(Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+        {
+            static_assert(!is_soa, "Compact regions are only available for array-of-structs meshes");
+            WithCompactRegions compact;
+            compact.n_points = n_points;
+            compact.n_edges = n_edges;
+            compact.n_regions = n_regions;
+            compact.points = points;
+            compact.edges = edges;
+            compact.n_boundary_points = n_boundary_points;
+            compact.boundary_edges = boundary_edges;
+            compact.boundary_points = boundary_points;
+            compact.boundary_point_ids = boundary_point_ids;
+            compact.regions = typename WithCompactRegions::RegionViewType("mesh_regions", n_regions);
+
+            auto src = *this;
+            auto dest = compact;
+            int n_unfit = 0;
+            // Reducing into a host value waits for space
+            Kokkos::parallel_reduce(
+                Kokkos::RangePolicy<>(space, 0, n_regions), KOKKOS_LAMBDA(int i, int &unfit) {
+                Region r = src.region(i);
+                unfit += CompactRegion::fits(r) ? 0 : 1;
+                store_region(dest.regions, i, r); }, n_unfit);
+            if (n_unfit > 0)
+            {
+                throw std::invalid_argument("Mesh::with_compact_regions: " + std::to_string(n_unfit) + " regions have vertex IDs more than " +
+                                            std::to_string(CompactRegion::max_offset) + " apart, reorder the mesh first");
+            }
+            return compact;
+        }
+
+        /**
+         * Returns a mesh sharing this mesh's points and boundary data, with converted copies of the
+         * edges and regions storing their vertex IDs as I, e.g. std::uint32_t to match connectivity
+         * handed over by other tools. Throws if the point IDs do not fit in I. As the kernels
+         * compute with pointIDs, this does not lift the point count limit of pointID. Released
+         * edges stay released. Not available with compact regions. The copies are made on space.
+         */
+        template <typename I>
+        WithIndex<I> with_index(Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+        {
+            static_assert(!has_compact_regions, "Compact regions have a fixed index type");
+            if (n_points > 0 && static_cast<std::uint64_t>(n_points - 1) > static_cast<std::uint64_t>(std::numeric_limits<I>::max()))
+            {
+                throw std::invalid_argument("Mesh::with_index: " + std::to_string(n_points) + " points do not fit the index type");
+            }
+            WithIndex<I> converted;
+            converted.n_points = n_points;
+            converted.n_edges = n_edges;
+            converted.n_regions = n_regions;
+            converted.points = points;
+            converted.n_boundary_points = n_boundary_points;
+            converted.boundary_edges = boundary_edges;
+            converted.boundary_points = boundary_points;
+            converted.boundary_point_ids = boundary_point_ids;
+            converted.regions = typename WithIndex<I>::RegionViewType("mesh_regions", n_regions);
+
+            auto src = *this;
+            auto dest = converted;
+            Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, n_regions), KOKKOS_LAMBDA(int i) { store_region(dest.regions, i, src.region(i)); });
+            if (has_edges())
+            {
+                dest.edges = typename WithIndex<I>::EdgeViewType("mesh_edges", n_edges);
+                converted.edges = dest.edges;
+                Kokkos::parallel_for(
+                    Kokkos::RangePolicy<>(space, 0, n_edges), KOKKOS_LAMBDA(int e) {
+                    for (int side = 0; side < 2; side++) {
+                        dest.edges(e)[side] = static_cast<I>(src.edges(e)[side]);
+                    } });
+            }
+            space.fence();
+            return converted;
+        }
+
+        /**
+         * Frees the edge list (of this handle; copies of the mesh keep theirs). The explicit solvers
+         * never read edges, but the assembled and implicit step modes and the high order solvers
+         * do during setup, so release the edges only once those are set up, or for meshes only
+         * used by explicit solvers. edge_count() stays the same.
+         */
+        void release_edges()
+        {
+            edges = EdgeView();
+        }
+
+        /**
+         * False once release_edges has been called
+         */
+        bool has_edges() const
+        {
+            return edges.extent(0) == static_cast<std::size_t>(n_edges);
+        }
+
+        /**
+         * Bytes held by this mesh's views (points, edges, regions and boundary data), counting
+         * views shared with other meshes too.
+         */
+        std::size_t resident_bytes() const
+        {
+            return points.span() * sizeof(typename PointView::value_type) +
+                   edges.span() * sizeof(typename EdgeView::value_type) +
+                   regions.span() * sizeof(typename RegionView::value_type) +
+                   boundary_edges.row_map.span() * sizeof(typename BoundaryEdgeMap::row_map_type::value_type) +
+                   boundary_edges.entries.span() * sizeof(int) +
+                   boundary_points.span() * sizeof(bool) +
+                   boundary_point_ids.span() * sizeof(pointID);
+        }
+
+        // Layout-independent element accessors. Views are shallow handles, so these can be
+        // called on a const (i.e. lambda-captured) mesh and still write through.
+
+        /**
+         * Returns (a copy of) point i
+         */
+        KOKKOS_INLINE_FUNCTION PointType point(pointID i) const
+        {
+            return load_point(points, i);
+        }
+
+        /**
+         * Reference to the x (dim = 0) or y (dim = 1) coordinate of point i
+         */
+        KOKKOS_INLINE_FUNCTION Scalar &coord(pointID i, int dim) const
+        {
+            if constexpr (is_soa)
+            {
+                return points(i, dim);
+            }
+            else
+            {
+                return points(i)[dim];
+            }
+        }
+
+        /**
+         * Returns (a copy of) region i
+         */
+        KOKKOS_INLINE_FUNCTION Region region(int i) const
+        {
+            return load_region(regions, i);
+        }
+
+        /**
+         * Reference to the ID of vertex j of region i. Not available with compact regions, which
+         * are only written whole (with store_region).
+         */
+        KOKKOS_INLINE_FUNCTION Index &vertex(int i, int j) const
+        {
+            if constexpr (is_soa)
+            {
+                return regions(i, j);
+            }
+            else
+            {
+                return regions(i)[j];
+            }
+        }
+
         // Size accessors
         inline int edge_count() { return n_edges; }
         inline int region_count() { return n_regions; }
@@ -230,8 +723,29 @@ namespace TFEM
 
     typedef ExecSpaceMesh<Kokkos::DefaultExecutionSpace> DeviceMesh;
 
+    // Structure-of-arrays variant: separate, contiguous x/y columns and one column per region vertex
+    template <class ExecSpace>
+    using ExecSpaceSoAMesh = TFEM::Mesh<Kokkos::View<double *[2], Kokkos::LayoutLeft, ExecSpace>, Kokkos::View<Edge *, ExecSpace>, Kokkos::View<pointID *[3], Kokkos::LayoutLeft, ExecSpace>>;
+
+    typedef ExecSpaceSoAMesh<Kokkos::DefaultExecutionSpace> DeviceSoAMesh;
+
+    // Single precision geometry, made from a loaded mesh with with_point_scalar<float>()
+    typedef DeviceMesh::WithPointScalar<float> DeviceFloatMesh;
+    typedef DeviceSoAMesh::WithPointScalar<float> DeviceSoAFloatMesh;
+
+    // Regions stored as CompactRegions, made from a loaded mesh with with_compact_regions()
+    typedef DeviceMesh::WithCompactRegions DeviceCompactMesh;
+    typedef DeviceCompactMesh::WithPointScalar<float> DeviceCompactFloatMesh;
+
+    // Vertex IDs stored as 32 bit unsigned integers, made from a loaded mesh with with_index<std::uint32_t>()
+    typedef DeviceMesh::WithIndex<std::uint32_t> DeviceUInt32Mesh;
+
     /**
-     * Loads a mesh from a file into both a host and device mesh.
+     * Loads a mesh from a file into both a host and device mesh. Instantiated for DeviceMesh
+     * and DeviceSoAMesh.
+     *
+     * The file is read into memory in one go, and after a quick scan for the section boundaries the
+     * point, edge and region sections are parsed in parallel on the default host execution space.
      *
      * Parameters:
      *
@@ -257,42 +771,508 @@ namespace TFEM
      *  Left-hand side ID's should be in ascending order.
      *  (Anything in <> is replaced with its value- the file does not include angle brackets)
      */
-    void load_meshes_from_grd_file(std::string fname, DeviceMesh &device_mesh, DeviceMesh::HostMirrorMesh &host_mesh, bool fuzz = false);
+    template <class MeshT>
+    void load_meshes_from_grd_file(std::string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, bool fuzz = false);
+
+    /**
+     * Host space that staging buffers for host/device transfers are allocated in, so transfers go
+     * straight to or from it without an extra copy (and can be asynchronous).
+     */
+#ifdef KOKKOS_HAS_SHARED_HOST_PINNED_SPACE
+    using PinnedHostSpace = Kokkos::SharedHostPinnedSpace;
+#else
+    using PinnedHostSpace = Kokkos::HostSpace;
+#endif
+
+    /**
+     * Settings for "stream_mesh_from_grd_file".
+     */
+    struct MeshStreamOptions
+    {
+        // Entry lines of the file parsed and uploaded at a time
+        int chunk_lines = 1 << 18;
+        // Chunks in flight. Each has its own pinned staging buffer and copy execution space instance.
+        int n_buffers = 3;
+    };
+
+    /**
+     * Loads a .grd mesh file (see load_meshes_from_grd_file for the format) into a device mesh
+     * only, without ever holding the whole file or a host mirror in memory.
+     *
+     * The file is read chunk_lines lines at a time. Each chunk is parsed in parallel on the host
+     * into a pinned staging buffer, copied asynchronously to the device on that buffer's own
+     * execution space instance, and scattered into the mesh views there, so parsing the next
+     * chunk overlaps the upload of the previous ones. A buffer is only reused once its copy is
+     * done, so host memory stays at n_buffers chunks. Boundary flags, boundary point IDs and
+     * fuzzing need the boundary section at the end of the file, and are computed on the device.
+     *
+     * Instantiated for DeviceMesh and DeviceSoAMesh. Use create_host_mirror() afterwards if a host
+     * copy is needed after all.
+     */
+    template <class MeshT>
+    void stream_mesh_from_grd_file(std::string fname, MeshT &device_mesh, bool fuzz = false, MeshStreamOptions options = MeshStreamOptions());
+
+    /**
+     * Builds a mesh like demoMeshes/squareN.grd (n = N) straight on the device, without any file:
+     * a uniform triangulation of [-1, 1]^2 with 2^(n-1) cells per side, each cut along the
+     * diagonal from its lower left to its upper right corner, with the boundary edges in four
+     * segments (bottom, right, top, left) running counterclockwise. The points, edges, regions,
+     * boundary edges and boundary flags are each filled by a parallel_for over their IDs, so
+     * meshes past square10 take milliseconds. Fuzzing is as for the loaders, and reproducible
+     * for a given seed.
+     *
+     * Points are numbered row by row from the bottom left, edges are the horizontal ones (by
+     * row), then the vertical ones (by lower point), then the diagonals (by cell), and each cell
+     * holds regions 2c (below the diagonal) and 2c + 1. The .grd files number everything in the
+     * order their refinement tool produced it, which no per-ID formula reproduces, so this is a
+     * different numbering of the same triangulation for square2 to square6. (square1 is cut
+     * along the other diagonal, and square7 and up mix both.) Use reorder_mesh for locality as
+     * with any loaded mesh.
+     *
+     * Instantiated for DeviceMesh and DeviceSoAMesh.
+     */
+    template <class MeshT>
+    void generate_square_mesh(int n, MeshT &device_mesh, bool fuzz = false, std::uint64_t seed = 0);
+
+    /**
+     * Loads a mesh from a binary mesh file (as written by "save_mesh_to_binary_file") into both
+     * a host and device mesh.
+     *
+     * The file is memory-mapped and each buffer is copied in a single block straight into the
+     * host mirror, so no per-entry parsing takes place. When the host and device share memory,
+     * the host mirror aliases the device views and the data is only copied once. The IDs in
+     * the edge, region and boundary sections are range-checked first; throws a runtime_error
+     * naming the file if any is out of range.
+     *
+     * File format (native byte order, every section aligned to MESH_BINARY_ALIGNMENT bytes):
+     *  - A fixed-size header holding the format tag and version, the point/edge/region counts,
+     *    the number of boundary segments and boundary edges, and the offset of each section.
+     *  - The raw Point, Edge and Region arrays.
+     *  - The boundary segment CSR (n_segments + 1 row starts, then the boundary edge IDs).
+     *  - One byte per point flagging whether it lies on the boundary.
+     *
+     * A mesh embedded in another file (e.g. a solver checkpoint) is read by passing the byte
+     * offset it starts at; its section offsets are relative to that.
+     */
+    template <class MeshT>
+    void load_meshes_from_binary_file(std::string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, bool fuzz = false, std::uint64_t file_offset = 0);
+
+    /**
+     * Writes a fully loaded (host-accessible) mesh to the binary format read by
+     * "load_meshes_from_binary_file". Typically used to convert .grd files once ahead of time.
+     */
+    template <class HostMeshT>
+    void save_mesh_to_binary_file(std::string fname, HostMeshT &host_mesh);
+
+    /**
+     * Same, written at the current position of an open stream, which should be aligned to
+     * MESH_BINARY_ALIGNMENT for the sections to stay aligned. Returns the number of bytes written.
+     */
+    template <class HostMeshT>
+    std::uint64_t save_mesh_to_binary_file(std::ostream &out_file, HostMeshT &host_mesh);
+
+    /**
+     * Loads a mesh from either file format, chosen by the file extension: files ending in
+     * ".tfm" are read as binary meshes, anything else is parsed as a .grd file.
+     */
+    template <class MeshT>
+    void load_meshes_from_file(std::string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, bool fuzz = false);
+
+    // Alignment (in bytes) of each section in a binary mesh file
+    constexpr std::size_t MESH_BINARY_ALIGNMENT = 64;
+
+    /**
+     * Point orderings available to "reorder_mesh".
+     *  - ReverseCuthillMcKee: breadth-first over the edge graph, minimizing the bandwidth of the
+     *    point adjacency. Good default for the element-wise kernels.
+     *  - Hilbert: sorts points along a Hilbert curve over the mesh bounding box. Only uses
+     *    coordinates, and gives more compact spatial blocks.
+     */
+    enum class MeshOrdering
+    {
+        ReverseCuthillMcKee,
+        Hilbert
+    };
+
+    /**
+     * Renumbering applied by "reorder_mesh", kept so results can be reported in the original IDs.
+     * new_to_old(i) is the original ID of what is now entry i, and old_to_new is its inverse.
+     * An empty (default constructed) permutation means the mesh was not reordered.
+     */
+    struct MeshPermutation
+    {
+        typedef Kokkos::View<int *, Kokkos::HostSpace> IndexView;
+        IndexView point_new_to_old;
+        IndexView point_old_to_new;
+        IndexView region_new_to_old;
+
+        bool is_identity() const
+        {
+            return point_new_to_old.extent(0) == 0;
+        }
+    };
+
+    /**
+     * Renumbers the points of a loaded mesh for memory locality, then reorders the regions to follow
+     * their lowest-numbered vertex. Edges, boundary flags and region vertices are rewritten to match;
+     * edge IDs (and therefore the boundary segments) are left unchanged.
+     *
+     * Must run after loading and before the mesh is colored or handed to a solver, since both
+     * capture region and point IDs. Both meshes are updated, and the returned permutation maps back
+     * to the file's numbering.
+     */
+    template <class MeshT>
+    MeshPermutation reorder_mesh(MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, MeshOrdering ordering = MeshOrdering::ReverseCuthillMcKee);
+
+    /**
+     * Splits the regions of a (host) mesh into n_parts parts of near-equal size by recursive
+     * coordinate bisection of the region centroids. Each cut is made across the longer side of the
+     * bounding box of the centroids being split, with the region counts on either side in
+     * proportion to the number of parts that go there, so n_parts need not be a power of two.
+     * Deterministic, so every rank computes the same partition without communicating.
+     *
+     * Returns the part of each region.
+     */
+    template <class HostMeshT>
+    Kokkos::View<int *, Kokkos::HostSpace> partition_mesh_regions(HostMeshT &host_mesh, int n_parts);
+
+    /**
+     * One part of a partitioned mesh, renumbered as a mesh of its own. The part holds its regions
+     * and every point they touch; points on the interface between parts are held (as partial
+     * copies) by each part touching them, and their values must be summed across the parts after
+     * each assembly. Edges are those of the part's regions, and boundary data refers only to the
+     * boundary of the whole mesh.
+     *
+     * Regions touching a shared point are numbered first, [0, n_interface_regions), so they can
+     * be computed before the rest.
+     */
+    template <class MeshT>
+    struct MeshPart
+    {
+        typedef Kokkos::View<int *, Kokkos::HostSpace> IndexView;
+
+        MeshT mesh;
+        typename MeshT::HostMirrorMesh host_mesh;
+
+        int part;
+        int n_parts;
+        int n_interface_regions;
+
+        // Global ID of each local point / region
+        IndexView point_local_to_global;
+        IndexView region_local_to_global;
+
+        // True at the points this part owns: the lowest-numbered part touching a point owns it
+        Kokkos::View<bool *, Kokkos::HostSpace> owned_points;
+
+        // Points shared with each neighboring part, in CSR form: the local IDs of the points shared
+        // with neighbors[n] are shared_points[shared_offsets[n] ... shared_offsets[n + 1] - 1],
+        // in increasing global ID so both sides list them in the same order.
+        std::vector<int> neighbors;
+        IndexView shared_offsets;
+        IndexView shared_points;
+    };
+
+    /**
+     * Extracts part "part" of a partition (as from partition_mesh_regions) of the loaded mesh.
+     * The device mesh of the part is allocated and filled; the global mesh is only read on the host.
+     */
+    template <class MeshT>
+    MeshPart<MeshT> extract_mesh_part(typename MeshT::HostMirrorMesh &global_host_mesh, Kokkos::View<int *, Kokkos::HostSpace> region_parts, int part, int n_parts);
+
+    /**
+     * Helpers shared between the different mesh loaders. Not intended to be called directly.
+     */
+    namespace MeshImpl
+    {
+        /**
+         * Counter-based random numbers for fuzzing: the counter-th number of the stream for the
+         * given seed, uniform in [-1, 1). A SplitMix64 finalizer over seed and counter, so any
+         * thread can draw any number without shared generator state.
+         */
+        KOKKOS_INLINE_FUNCTION double counter_uniform(std::uint64_t seed, std::uint64_t counter)
+        {
+            std::uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15ull;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+            // Top 53 bits, scaled to [0, 2)
+            return (z >> 11) * (1.0 / (1ull << 52)) - 1;
+        }
+
+        /**
+         * Fuzz displacement of point p within the unit circle. Not quite uniform, since the
+         * corners of the square are remapped inward.
+         */
+        KOKKOS_INLINE_FUNCTION void fuzz_displacement(std::uint64_t seed, pointID p, double &x, double &y)
+        {
+            x = counter_uniform(seed, 3 * (std::uint64_t)p);
+            y = counter_uniform(seed, 3 * (std::uint64_t)p + 1);
+            double rad = Kokkos::sqrt(x * x + y * y);
+            if (rad > 1.0)
+            {
+                double rescale = counter_uniform(seed, 3 * (std::uint64_t)p + 2) / rad;
+                x *= rescale;
+                y *= rescale;
+            }
+        }
+
+        /**
+         * Displaces every non-boundary point of the host mesh by a small random amount, in
+         * parallel on the host. Assumes a square grid on [-1, 1]^2 to pick a radius that does not
+         * invert any triangles.
+         */
+        template <class HostMeshT>
+        void fuzz_interior_points(HostMeshT &host_mesh, std::uint64_t seed);
+
+        /**
+         * Same as fuzz_interior_points, run on the mesh's own execution space. Gives the same
+         * displacements for the same seed. The boundary flags must be set.
+         */
+        template <class MeshT>
+        void fuzz_interior_points_device(MeshT &mesh, std::uint64_t seed);
+
+        /**
+         * Sets boundary_point_ids and n_boundary_points of both meshes from the boundary flags
+         * of the host mesh. The device mesh's flags must already be allocated.
+         */
+        template <class MeshT>
+        void set_boundary_point_ids(MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh)
+        {
+            std::vector<pointID> ids;
+            for (pointID p = 0; p < host_mesh.point_count(); p++)
+            {
+                if (host_mesh.boundary_points(p))
+                {
+                    ids.push_back(p);
+                }
+            }
+            device_mesh.boundary_point_ids = typename MeshT::BoundaryPointList("Boundary point IDs", ids.size());
+            host_mesh.boundary_point_ids = Kokkos::create_mirror_view(device_mesh.boundary_point_ids);
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                host_mesh.boundary_point_ids(i) = ids[i];
+            }
+            Kokkos::deep_copy(device_mesh.boundary_point_ids, host_mesh.boundary_point_ids);
+            host_mesh.n_boundary_points = ids.size();
+            device_mesh.n_boundary_points = ids.size();
+        }
+
+        /**
+         * Same, for a mesh without a host copy: compacts the mesh's own boundary flags where they
+         * live.
+         */
+        template <class MeshT>
+        void set_boundary_point_ids(MeshT &mesh)
+        {
+            auto boundary_points = mesh.boundary_points;
+            int n_boundary = 0;
+            Kokkos::parallel_reduce("set_boundary_point_ids count", mesh.point_count(), KOKKOS_LAMBDA(int p, int &count) { count += boundary_points(p) ? 1 : 0; }, n_boundary);
+            typename MeshT::BoundaryPointList ids("Boundary point IDs", n_boundary);
+            Kokkos::parallel_scan("set_boundary_point_ids", mesh.point_count(), KOKKOS_LAMBDA(int p, int &partial, bool final) {
+                if (boundary_points(p)) {
+                    if (final) {
+                        ids(partial) = p;
+                    }
+                    partial++;
+                } });
+            mesh.boundary_point_ids = ids;
+            mesh.n_boundary_points = n_boundary;
+        }
+
+        /**
+         * Builds a boundary edge graph of the given type from a plain CSR description: segment s
+         * consists of edge_ids[segment_starts[s]] ... edge_ids[segment_starts[s + 1] - 1].
+         */
+        template <class GraphT>
+        GraphT create_boundary_graph(std::string label, const int *segment_starts, int n_segments, const int *edge_ids)
+        {
+            typename GraphT::row_map_type::non_const_type row_map(label + " row map", n_segments + 1);
+            typename GraphT::entries_type entries(label + " entries", segment_starts[n_segments]);
+
+            // The graph may live on the device, so fill on the host and copy over.
+            auto row_map_host = Kokkos::create_mirror_view(row_map);
+            auto entries_host = Kokkos::create_mirror_view(entries);
+            for (int s = 0; s <= n_segments; s++)
+            {
+                row_map_host(s) = segment_starts[s];
+            }
+            for (int i = 0; i < segment_starts[n_segments]; i++)
+            {
+                entries_host(i) = edge_ids[i];
+            }
+            Kokkos::deep_copy(row_map, row_map_host);
+            Kokkos::deep_copy(entries, entries_host);
+
+            return GraphT(entries, row_map);
+        }
+    }
+
+    /**
+     * Hash (64-bit FNV-1a) of the mesh connectivity: the point and region counts followed by
+     * every region's vertex IDs. Coordinates are left out, so e.g. a fuzzed copy of a mesh hashes
+     * the same. Used to key data cached on disk that only depends on connectivity.
+     */
+    template <class MeshT>
+    std::uint64_t mesh_connectivity_hash(MeshT &mesh);
+
+    /**
+     * Algorithms available for coloring the mesh.
+     *  - Fast: KokkosKernels' parallel bipartite row coloring. Quick to run, but the color count
+     *    and sizes change from run to run, and the last colors tend to be very small.
+     *  - Balanced: deterministic host coloring. A greedy coloring is repeatedly recolored in
+     *    color-class order (which never adds colors) to reduce the color count, then regions are
+     *    moved out of oversized colors into undersized ones wherever their points allow, so every
+     *    color launch is about the same size. Limited to 64 colors.
+     */
+    enum class ColoringMode
+    {
+        Fast,
+        Balanced
+    };
 
     /**
      * Runs a (non-minimal) coloring algorithm on the regions in mesh so that no two elements
      * in the same color share a point. All regions of the same color can be queries as a
-     * contiguous subview using "color_member_regions(color_index)".
+     * contiguous subview using "color_member_regions(color_index)". Within a color, regions are in
+     * increasing region ID order with either mode, so color kernels see the mesh's own locality.
+     *
+     * A coloring can be saved to and loaded from a file, keyed by the mesh connectivity hash and
+     * the coloring mode. If a cache file is given to the constructor, a matching saved coloring is
+     * used instead of coloring again, and otherwise the fresh coloring is written there.
      *
      * Right now regions are copied by value (to save an extra dereference) so their index is lost.
+     * The copies are stored in the same layout as the mesh's regions; read them with load_region().
+     * For large meshes, share_mesh_regions() renumbers the mesh's regions into color order so the
+     * mesh and the map can share a single region array.
+     *
+     * The bucketing and copies run on the given execution space instance, which the colored
+     * scatter patterns built from the map then launch on. (KokkosKernels' coloring itself runs on
+     * the default instance.)
+     *
+     * Use through the MeshColorMap / SoAMeshColorMap aliases.
      */
-    class MeshColorMap
+    template <class MeshT>
+    class BasicMeshColorMap
     {
     protected:
+        // Region storage matching the mesh layout, so it can be shared with the mesh
+        using ColorMemberView = typename MeshT::RegionViewType;
+
         // color index is a (n_colors + 1)-entry view where indices belonging to a
         // color are anything in [color_index(color), color_index(color + 1))
         Kokkos::View<const int *> color_index;
         Kokkos::View<const int *>::HostMirror color_index_host;
         // Array of regions sorted to be color-contiguous. See the index
-        Kokkos::View<const Region *> color_members;
+        ColorMemberView color_members;
 
-        // original mesh ID's corresponding to each region
+        // original mesh ID's corresponding to each region. Empty once the regions are shared
+        // with the mesh, whose region IDs are then the positions in color order.
         Kokkos::View<const int *> color_ids;
         Kokkos::View<const int *>::HostMirror color_ids_host;
         int n_colors;
+        Kokkos::DefaultExecutionSpace space;
+        bool shares_regions = false;
 
         auto color_endpoints(int color)
         {
             return Kokkos::pair(color_index_host[color], color_index_host[color + 1]);
         }
 
+        void check_has_member_ids()
+        {
+            if (shares_regions)
+            {
+                throw std::logic_error("MeshColorMap: region IDs are positions in color order once the regions are shared with the mesh");
+            }
+        }
+
     public:
-        MeshColorMap(DeviceMesh &mesh);
+        using MeshType = MeshT;
+
+        BasicMeshColorMap(MeshT &mesh, ColoringMode mode = ColoringMode::Fast, std::string cache_file = "", Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace());
+
+        /**
+         * Takes a coloring computed earlier (as n_colors + 1 color starts and the region IDs in
+         * color order, the way "save" writes them) instead of coloring. Throws if it does not fit
+         * the mesh.
+         */
+        BasicMeshColorMap(MeshT &mesh, const std::vector<std::int32_t> &color_starts, const std::vector<std::int32_t> &member_ids, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace());
+
+        Kokkos::DefaultExecutionSpace execution_space() const
+        {
+            return space;
+        }
 
         // When I put kokkos parallel for loops in the constructor,
         // the compiler yells at me that the enclosing function doesn't
         // have an adress (on GPU). This is a workaround- don't call.
-        void do_color(DeviceMesh &mesh);
+        void do_color(MeshT &mesh, ColoringMode mode = ColoringMode::Fast);
+
+        // Also don't call. Host-side balanced coloring, see ColoringMode.
+        void do_balanced_color(MeshT &mesh);
+
+        // Also don't call. Given the color index and the color-ordered region IDs (both on
+        // device), gathers the color-ordered regions and sets up the host mirrors.
+        void set_color_members(MeshT &mesh, int n_colors, Kokkos::View<int *> color_index, Kokkos::View<int *> color_member_ids);
+
+        // Also don't call. Checks a host-side color CSR (from "source", for the error messages)
+        // against the mesh and copies it to the device with set_color_members.
+        void set_color_csr(MeshT &mesh, const std::vector<std::int32_t> &color_starts, const std::vector<std::int32_t> &member_ids, const std::string &source);
+
+        /**
+         * Lean mode, for meshes close to filling the device: renumbers the regions of mesh (the
+         * mesh this map was built for) into color order, so the i-th region in color order becomes
+         * region i, and shares the color-ordered region array with the mesh instead of keeping a
+         * copy. The map's region ID lists (on device and host) are dropped, since the IDs are now
+         * the positions; color_ordered_region_ids() still lists them.
+         *
+         * Call before building scatter patterns or solvers over the mesh, since they capture
+         * region IDs. The old region array is freed once no other handle (e.g. an earlier copy of
+         * the mesh) refers to it; a host mirror keeps the old numbering, so copy mesh.regions back
+         * to it if it is still needed.
+         */
+        void share_mesh_regions(MeshT &mesh);
+
+        /**
+         * Whether share_mesh_regions was called
+         */
+        bool shares_mesh_regions() const
+        {
+            return shares_regions;
+        }
+
+        /**
+         * The mesh region IDs of all regions, ordered by color (on the host). Unlike
+         * all_color_member_ids_host, also works after share_mesh_regions.
+         */
+        std::vector<std::int32_t> color_ordered_region_ids();
+
+        /**
+         * Device bytes held by the map: the color index, and unless they are shared with the mesh,
+         * the color-ordered regions and their IDs.
+         */
+        std::size_t resident_bytes() const
+        {
+            std::size_t bytes = color_index.span() * sizeof(int) + color_ids.span() * sizeof(int);
+            if (!shares_regions)
+            {
+                bytes += color_members.span() * sizeof(typename ColorMemberView::value_type);
+            }
+            return bytes;
+        }
+
+        /**
+         * Writes the coloring to a file, along with the connectivity hash of the mesh it belongs to
+         * and the mode it was colored with.
+         */
+        void save(std::string fname, MeshT &mesh, ColoringMode mode);
+
+        /**
+         * Replaces the coloring with one saved by "save". Returns false, leaving the coloring
+         * untouched, if the file does not exist or was saved for a different mesh or mode.
+         */
+        bool load(std::string fname, MeshT &mesh, ColoringMode mode);
 
         /**
          * Number of colors used
@@ -304,19 +1284,41 @@ namespace TFEM
          */
         int member_count(int color);
 
+        /**
+         * Position of the first region of the given color in the color-ordered region list
+         */
+        int color_start(int color);
+
         /**
          * Returns a device-accessible contiguous subview of the regions in the indicated color
          */
         auto color_member_regions(int color)
         {
-            return Kokkos::subview(color_members, color_endpoints(color));
+            if constexpr (MeshT::is_soa)
+            {
+                return Kokkos::subview(color_members, color_endpoints(color), Kokkos::ALL);
+            }
+            else
+            {
+                return Kokkos::subview(color_members, color_endpoints(color));
+            }
         }
 
         /**
-         * Returns a device-accessible subview containing the ID's of the regions of the indicated color
+         * Returns the device-accessible list of all regions, ordered by color
+         */
+        auto all_color_member_regions()
+        {
+            return color_members;
+        }
+
+        /**
+         * Returns a device-accessible subview containing the ID's of the regions of the indicated
+         * color. These ID accessors throw after share_mesh_regions.
          */
         auto color_member_ids(int color)
         {
+            check_has_member_ids();
             return Kokkos::subview(color_ids, color_endpoints(color));
         }
 
@@ -325,11 +1327,30 @@ namespace TFEM
          */
         auto color_member_ids_host(int color)
         {
+            check_has_member_ids();
             return Kokkos::subview(color_ids_host, color_endpoints(color));
         }
+
+        /**
+         * Returns the host-accessible ID's of all regions, ordered by color
+         */
+        auto all_color_member_ids_host()
+        {
+            check_has_member_ids();
+            return color_ids_host;
+        }
     };
 
-    void validate_mesh_coloring(typename DeviceMesh::HostMirrorMesh &mesh, MeshColorMap &coloring);
+    typedef BasicMeshColorMap<DeviceMesh> MeshColorMap;
+    typedef BasicMeshColorMap<DeviceSoAMesh> SoAMeshColorMap;
+    typedef BasicMeshColorMap<DeviceFloatMesh> FloatMeshColorMap;
+    typedef BasicMeshColorMap<DeviceSoAFloatMesh> SoAFloatMeshColorMap;
+    typedef BasicMeshColorMap<DeviceCompactMesh> CompactMeshColorMap;
+    typedef BasicMeshColorMap<DeviceCompactFloatMesh> CompactFloatMeshColorMap;
+    typedef BasicMeshColorMap<DeviceUInt32Mesh> UInt32MeshColorMap;
+
+    template <class MeshT>
+    void validate_mesh_coloring(typename MeshT::HostMirrorMesh &mesh, BasicMeshColorMap<MeshT> &coloring);
 
 }
 
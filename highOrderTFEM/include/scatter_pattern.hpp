@@ -2,6 +2,12 @@
 #define highOrderTFEM_scatter_add_pattern_hpp
 
 #include <Kokkos_Core.hpp>
+#include <Kokkos_Graph.hpp>
+#include <Kokkos_SIMD.hpp>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "mesh.hpp"
 
@@ -14,6 +20,11 @@ namespace TFEM
      *
      * Once instantiated, functors should call the instances contribute method when
      * they need to do their op.
+     *
+     * distribute_work calls functor(element, slot) once per region. The slot is a dense index
+     * in [0, region_count) giving the position of the element in the pattern's own traversal
+     * order. It is the same on every call, so functors can use it to index per-element data
+     * that was laid out by an earlier pass through the same pattern.
      */
     // class ScatterAddPattern
     // {
@@ -22,6 +33,168 @@ namespace TFEM
 
     //     static KOKKOS_INLINE_FUNCTION void contribute(Arg1 arg1, Arg2 arg2, ...);
     // }
+    //
+    // The add patterns below template contribute() on the scalar type, i.e.
+    // contribute(Scalar *dest, Scalar contribution), so they work for state in any precision.
+    //
+    // Patterns may also take an execution space instance when constructed and return it from
+    //
+    //     Kokkos::DefaultExecutionSpace execution_space() const;
+    //
+    // in which case distribute_work launches on that instance, and a Solver over the pattern
+    // runs all of its own kernels there too (see pattern_execution_space). Patterns keeping a copy
+    // of the mesh provide
+    //
+    //     void release_mesh_edges();
+    //
+    // so a Solver can drop the copy's edges once its setup is done (see Mesh::release_edges).
+
+    /**
+     * Optional functor interface for point-centric patterns. A functor that only contributes to
+     * the points of its own element can expose the contributions separately from where they go:
+     *
+     *   // Fill contributions[j] with what the element adds to its j-th vertex
+     *   KOKKOS_INLINE_FUNCTION void element_contributions(Region element, int slot, double contributions[3]) const;
+     *   // Destination the contributions for point p are summed into
+     *   KOKKOS_INLINE_FUNCTION double *target(pointID p) const;
+     *
+     * operator() should then be equivalent to contributing each value to target(element[j]).
+     * Functors working in another precision declare "using contribution_type = T;" and take
+     * T contributions[3]; the target may be of a different (storage) type.
+     */
+    template <typename Functor, typename = void>
+    struct gather_contribution
+    {
+        using type = double;
+    };
+
+    template <typename Functor>
+    struct gather_contribution<Functor, std::void_t<typename Functor::contribution_type>>
+    {
+        using type = typename Functor::contribution_type;
+    };
+
+    template <typename Functor>
+    using gather_contribution_t = typename gather_contribution<Functor>::type;
+
+    template <typename Functor, typename = void>
+    struct has_gather_interface : std::false_type
+    {
+    };
+
+    template <typename Functor>
+    struct has_gather_interface<Functor, std::void_t<decltype(std::declval<const Functor &>().element_contributions(std::declval<Region>(), 0, std::declval<gather_contribution_t<Functor> *>())),
+                                                     decltype(std::declval<const Functor &>().target(pointID()))>> : std::true_type
+    {
+    };
+
+    template <typename Functor>
+    constexpr bool has_gather_interface_v = has_gather_interface<Functor>::value;
+
+    /**
+     * Optional batched form of the gather interface, used by BasicColoredElementScatterAdd on host
+     * execution spaces to run several elements of a color in SIMD lanes:
+     *
+     *   // Fill lane l of contributions[j] with what elements[l] (at slots[l]) adds to its j-th vertex
+     *   template <typename SimdT>
+     *   KOKKOS_INLINE_FUNCTION void simd_element_contributions(const Region elements[], const int slots[], SimdT contributions[3]) const;
+     *
+     * with SimdT = ElementSimd<contribution type>, and elements / slots holding SimdT::size() entries.
+     * Every lane is a real element (the pattern pads a short batch by repeating its last one), so
+     * there is no masking inside the functor. The pattern does the scatter to target().
+     */
+    template <typename Scalar>
+    using ElementSimd = Kokkos::Experimental::simd<Scalar>;
+
+    template <typename Functor, typename = void>
+    struct has_simd_interface : std::false_type
+    {
+    };
+
+    template <typename Functor>
+    struct has_simd_interface<Functor, std::void_t<decltype(std::declval<const Functor &>().simd_element_contributions(std::declval<const Region *>(), std::declval<const int *>(),
+                                                                                                                     std::declval<ElementSimd<gather_contribution_t<Functor>> *>()))>>
+        : std::bool_constant<has_gather_interface_v<Functor>>
+    {
+    };
+
+    template <typename Functor>
+    constexpr bool has_simd_interface_v = has_simd_interface<Functor>::value;
+
+    /**
+     * Patterns that can also record their work into a Kokkos::Experimental::Graph declare
+     *
+     *   static constexpr bool supports_graph = true;
+     *   template <typename WorkerFunctor>
+     *   ScatterGraphNode then_distribute_work(ScatterGraphNode node, WorkerFunctor functor);
+     *
+     * which adds the same kernels as distribute_work after the given node, ordered by graph
+     * dependencies, and returns the last one. Nodes are type-erased so a pattern can chain a
+     * runtime number of kernels.
+     */
+    typedef Kokkos::Experimental::GraphNodeRef<Kokkos::DefaultExecutionSpace> ScatterGraphNode;
+
+    template <typename Pattern, typename = void>
+    struct pattern_supports_graph : std::false_type
+    {
+    };
+
+    template <typename Pattern>
+    struct pattern_supports_graph<Pattern, std::enable_if_t<Pattern::supports_graph>> : std::true_type
+    {
+    };
+
+    template <typename Pattern>
+    constexpr bool pattern_supports_graph_v = pattern_supports_graph<Pattern>::value;
+
+    template <typename Pattern, typename = void>
+    struct has_execution_space : std::false_type
+    {
+    };
+
+    template <typename Pattern>
+    struct has_execution_space<Pattern, std::void_t<decltype(std::declval<const Pattern &>().execution_space())>> : std::true_type
+    {
+    };
+
+    /**
+     * The execution space instance a pattern launches on, or the default instance for patterns
+     * that do not say.
+     */
+    template <typename Pattern>
+    Kokkos::DefaultExecutionSpace pattern_execution_space(const Pattern &pattern)
+    {
+        if constexpr (has_execution_space<Pattern>::value)
+        {
+            return pattern.execution_space();
+        }
+        else
+        {
+            return Kokkos::DefaultExecutionSpace();
+        }
+    }
+
+    template <typename Pattern, typename = void>
+    struct has_release_mesh_edges : std::false_type
+    {
+    };
+
+    template <typename Pattern>
+    struct has_release_mesh_edges<Pattern, std::void_t<decltype(std::declval<Pattern &>().release_mesh_edges())>> : std::true_type
+    {
+    };
+
+    /**
+     * Releases the edges of the pattern's copy of the mesh, if it keeps one.
+     */
+    template <typename Pattern>
+    void pattern_release_mesh_edges(Pattern &pattern)
+    {
+        if constexpr (has_release_mesh_edges<Pattern>::value)
+        {
+            pattern.release_mesh_edges();
+        }
+    }
 
     /**
      * Scatter add pattern where the contribution operation is a double-precision add
@@ -29,28 +202,57 @@ namespace TFEM
      *
      * Uses atomic operations to implement the contribution operation, allowing for
      * arbitrary work dispatch patterns.
+     *
+     * Each pattern is templated on the mesh type it works over, and exposes it as MeshType.
+     * Use through the AtomicElementScatterAdd / SoAAtomicElementScatterAdd aliases.
      */
-    class AtomicElementScatterAdd
+    template <class MeshT>
+    class BasicAtomicElementScatterAdd
     {
     private:
-        DeviceMesh mesh;
+        MeshT mesh;
+        Kokkos::DefaultExecutionSpace space;
 
     public:
-        AtomicElementScatterAdd(DeviceMesh mesh)
+        using MeshType = MeshT;
+
+        BasicAtomicElementScatterAdd(MeshT mesh, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+            : mesh(mesh), space(space)
+        { // Pretty much just the initializer list
+        }
+
+        Kokkos::DefaultExecutionSpace execution_space() const
+        {
+            return space;
+        }
+
+        void release_mesh_edges()
         {
-            this->mesh = mesh;
+            mesh.release_edges();
         }
 
         template <typename WorkerFunctor>
         void distribute_work(WorkerFunctor functor)
         {
             auto mesh = this->mesh;
-            Kokkos::parallel_for(mesh.region_count(), KOKKOS_LAMBDA(int element_id) {
-                Region element = mesh.regions(element_id);
-                functor(element); });
+            Kokkos::parallel_for("AtomicElementScatterAdd", Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int element_id) {
+                Region element = mesh.region(element_id);
+                functor(element, element_id); });
+        }
+
+        static constexpr bool supports_graph = true;
+
+        template <typename WorkerFunctor>
+        ScatterGraphNode then_distribute_work(ScatterGraphNode node, WorkerFunctor functor)
+        {
+            auto mesh = this->mesh;
+            return node.then_parallel_for(Kokkos::RangePolicy<>(0, mesh.region_count()), KOKKOS_LAMBDA(int element_id) {
+                Region element = mesh.region(element_id);
+                functor(element, element_id); });
         }
 
-        static KOKKOS_INLINE_FUNCTION void contribute(double *dest, double contribution)
+        template <typename Scalar>
+        static KOKKOS_INLINE_FUNCTION void contribute(Scalar *dest, Scalar contribution)
         {
             Kokkos::atomic_add(dest, contribution);
         }
@@ -62,32 +264,154 @@ namespace TFEM
      * its local points/edges.
      *
      * Uses a coloring algorithm to ensure that elements sharing points are not running synchronously.
+     *
+     * On host execution spaces, functors with the SIMD interface (see has_simd_interface) are run
+     * in batches of ElementSimd<T>::size() consecutive elements of a color per thread, unless
+     * disabled in the constructor. The batches give the same per-element results as the scalar path.
+     *
+     * Launches on the execution space instance of its coloring.
      */
-    class ColoredElementScatterAdd
+    template <class MeshT>
+    class BasicColoredElementScatterAdd
     {
     private:
-        MeshColorMap coloring;
+        BasicMeshColorMap<MeshT> coloring;
+        // One kernel name per color, so profiling tools can tell the colors apart
+        std::vector<std::string> color_kernel_names;
+        bool simd_batches;
+
+        // Whether distribute_work takes the batched path for this functor
+        template <typename WorkerFunctor>
+        static constexpr bool can_batch = has_simd_interface_v<WorkerFunctor> && Kokkos::SpaceAccessibility<Kokkos::DefaultExecutionSpace, Kokkos::HostSpace>::accessible;
 
     public:
-        ColoredElementScatterAdd(MeshColorMap coloring) : coloring(coloring)
+        using MeshType = MeshT;
+
+        BasicColoredElementScatterAdd(BasicMeshColorMap<MeshT> coloring, bool simd_batches = true) : coloring(coloring), simd_batches(simd_batches)
+        {
+            for (int color = 0; color < this->coloring.color_count(); color++)
+            {
+                color_kernel_names.push_back("ColoredElementScatterAdd color " + std::to_string(color));
+            }
+        }
+
+        /**
+         * Colors the mesh (with the Fast mode) on the given instance.
+         */
+        BasicColoredElementScatterAdd(MeshT mesh, Kokkos::DefaultExecutionSpace space)
+            : BasicColoredElementScatterAdd(BasicMeshColorMap<MeshT>(mesh, ColoringMode::Fast, "", space))
+        { // Pretty much just the initializer list
+        }
+
+        Kokkos::DefaultExecutionSpace execution_space() const
+        {
+            return coloring.execution_space();
+        }
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Runs one batch of the given color's elements (from
+         * elements, starting at slot color_start) through a functor with the SIMD interface.
+         */
+        template <typename WorkerFunctor, typename ElementView>
+        static KOKKOS_INLINE_FUNCTION void run_simd_batch(const WorkerFunctor &functor, const ElementView &elements, int color_start, int batch)
+        {
+            using SimdT = ElementSimd<gather_contribution_t<WorkerFunctor>>;
+            using Target = std::remove_pointer_t<decltype(functor.target(pointID()))>;
+            constexpr int width = SimdT::size();
+            int first = batch * width;
+            int n = Kokkos::min(width, static_cast<int>(elements.extent(0)) - first);
+
+            // Pad a short last batch with copies of its last element, so every lane is well defined
+            Region batch_elements[width];
+            int slots[width];
+            for (int l = 0; l < width; l++)
+            {
+                int i = first + (l < n ? l : n - 1);
+                batch_elements[l] = load_region(elements, i);
+                slots[l] = color_start + i;
+            }
+
+            SimdT contributions[3];
+            functor.simd_element_contributions(batch_elements, slots, contributions);
+
+            // Masked scatter: only the first n lanes are written. The elements of a color share no
+            // points, so lanes never collide. (Kokkos' simd scatter stores rather than adds, so this
+            // is a lane loop.)
+            for (int j = 0; j < 3; j++)
+            {
+                for (int l = 0; l < n; l++)
+                {
+                    *functor.target(batch_elements[l][j]) += static_cast<Target>(contributions[j][l]);
+                }
+            }
+        }
+
+        /**
+         * The coloring elements are distributed by, which also gives the slot order.
+         */
+        BasicMeshColorMap<MeshT> &color_map()
         {
+            return coloring;
         }
 
         template <typename WorkerFunctor>
         void distribute_work(WorkerFunctor functor)
         {
+            auto space = coloring.execution_space();
             for (int color = 0; color < coloring.color_count(); color++)
             {
                 auto elements = coloring.color_member_regions(color);
+                int color_start = coloring.color_start(color);
+
+                // No fence needed between colors: launches on the same execution space
+                // instance run in order, so a color never overlaps the previous one.
+                if constexpr (can_batch<WorkerFunctor>)
+                {
+                    if (simd_batches)
+                    {
+                        constexpr int width = ElementSimd<gather_contribution_t<WorkerFunctor>>::size();
+                        int n_batches = (elements.extent(0) + width - 1) / width;
+                        Kokkos::parallel_for(color_kernel_names[color], Kokkos::RangePolicy<>(space, 0, n_batches), KOKKOS_LAMBDA(int batch) {
+                            run_simd_batch(functor, elements, color_start, batch); });
+                        continue;
+                    }
+                }
+                Kokkos::parallel_for(color_kernel_names[color], Kokkos::RangePolicy<>(space, 0, elements.extent(0)), KOKKOS_LAMBDA(int i) {
+                    Region element = load_region(elements, i);
+                    functor(element, color_start + i); });
+            }
+        }
+
+        static constexpr bool supports_graph = true;
 
-                Kokkos::parallel_for(elements.extent(0), KOKKOS_LAMBDA(int i) {
-                    Region element = elements(i);
-                    functor(element); });
-                Kokkos::fence();
+        template <typename WorkerFunctor>
+        ScatterGraphNode then_distribute_work(ScatterGraphNode node, WorkerFunctor functor)
+        {
+            // Each color depends on the previous one, in place of the launch order.
+            for (int color = 0; color < coloring.color_count(); color++)
+            {
+                auto elements = coloring.color_member_regions(color);
+                int color_start = coloring.color_start(color);
+                if constexpr (can_batch<WorkerFunctor>)
+                {
+                    if (simd_batches)
+                    {
+                        constexpr int width = ElementSimd<gather_contribution_t<WorkerFunctor>>::size();
+                        int n_batches = (elements.extent(0) + width - 1) / width;
+                        node = node.then_parallel_for(color_kernel_names[color], Kokkos::RangePolicy<>(0, n_batches), KOKKOS_LAMBDA(int batch) {
+                            run_simd_batch(functor, elements, color_start, batch); });
+                        continue;
+                    }
+                }
+                node = node.then_parallel_for(color_kernel_names[color], Kokkos::RangePolicy<>(0, elements.extent(0)), KOKKOS_LAMBDA(int i) {
+                    Region element = load_region(elements, i);
+                    functor(element, color_start + i); });
             }
+            return node;
         }
 
-        static KOKKOS_INLINE_FUNCTION void contribute(double *dest, double contribution)
+        template <typename Scalar>
+        static KOKKOS_INLINE_FUNCTION void contribute(Scalar *dest, Scalar contribution)
         {
             *dest += contribution;
         }
@@ -95,33 +419,296 @@ namespace TFEM
 
     /**
      * Serial execution of work. Assumes everything is on cpu memory.
+     *
+     * The work itself runs on the calling thread; the instance is only what a Solver over the
+     * pattern launches its other kernels on. distribute_work fences it first, since those may
+     * still be running.
      */
-    class SerialElementScatterAdd
+    template <class MeshT>
+    class BasicSerialElementScatterAdd
     {
     private:
-        DeviceMesh mesh;
+        MeshT mesh;
+        Kokkos::DefaultExecutionSpace space;
 
     public:
-        SerialElementScatterAdd(DeviceMesh mesh)
+        using MeshType = MeshT;
+
+        BasicSerialElementScatterAdd(MeshT mesh, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+            : mesh(mesh), space(space)
+        { // Pretty much just the initializer list
+        }
+
+        Kokkos::DefaultExecutionSpace execution_space() const
+        {
+            return space;
+        }
+
+        void release_mesh_edges()
         {
-            this->mesh = mesh;
+            mesh.release_edges();
         }
 
         template <typename WorkerFunctor>
         void distribute_work(WorkerFunctor functor)
         {
+            space.fence();
             for (int i = 0; i < mesh.region_count(); i++)
             {
-                Region element = mesh.regions(i);
-                functor(element);
+                Region element = mesh.region(i);
+                functor(element, i);
             };
         }
 
-        static KOKKOS_INLINE_FUNCTION void contribute(double *dest, double contribution)
+        template <typename Scalar>
+        static KOKKOS_INLINE_FUNCTION void contribute(Scalar *dest, Scalar contribution)
         {
             *dest += contribution;
         }
     };
+
+    /**
+     * How BasicGatherElementScatterAdd gets each element's contributions.
+     *  - Recompute: every point recomputes all of its incident elements. No extra memory, but
+     *    each element is evaluated once per vertex.
+     *  - Buffered: one pass over the elements writes their contributions to a per-element
+     *    buffer (3 doubles per element), then a pass over the points sums them.
+     */
+    enum class GatherMode
+    {
+        Recompute,
+        Buffered
+    };
+
+    /**
+     * Scatter add pattern where the contribution operation is a double-precision add, turned
+     * around into a gather: one thread per point sums the contributions of the elements
+     * touching it. Each point is written by exactly one thread, so there are no atomics, and
+     * there is no coloring so each distribution is one (or two, when buffered) launches.
+     *
+     * Relies on the functor's gather interface (see has_gather_interface). Functors without it
+     * are run once per element, slot being the region ID, with contribute() falling back to an
+     * atomic add. Slots are always region IDs, so per-element data stays consistent across both.
+     */
+    template <class MeshT>
+    class BasicGatherElementScatterAdd
+    {
+    private:
+        MeshT mesh;
+        GatherMode mode;
+        Kokkos::DefaultExecutionSpace space;
+        // Elements touching each point, as (region ID * 3 + local vertex). Rows are sorted so
+        // the summation order, and so the rounding, is the same on every run.
+        Kokkos::View<int *> incident_offsets;
+        Kokkos::View<int *> incident_entries;
+        // Per-element contributions, only allocated in buffered mode. Kept in double, which holds
+        // contributions of either precision exactly.
+        Kokkos::View<double *[3]> element_buffer;
+
+    public:
+        using MeshType = MeshT;
+
+        BasicGatherElementScatterAdd(MeshT mesh, GatherMode mode = GatherMode::Buffered, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace())
+            : mesh(mesh), mode(mode), space(space)
+        {
+            build_incidence();
+            if (mode == GatherMode::Buffered)
+            {
+                element_buffer = Kokkos::View<double *[3]>("Gather element buffer", mesh.region_count());
+            }
+        }
+
+        BasicGatherElementScatterAdd(MeshT mesh, Kokkos::DefaultExecutionSpace space)
+            : BasicGatherElementScatterAdd(mesh, GatherMode::Buffered, space)
+        { // Pretty much just the initializer list
+        }
+
+        Kokkos::DefaultExecutionSpace execution_space() const
+        {
+            return space;
+        }
+
+        void release_mesh_edges()
+        {
+            mesh.release_edges();
+        }
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Called by the constructor.
+         *
+         * Builds the point-to-element CSR.
+         */
+        void build_incidence()
+        {
+            auto mesh = this->mesh;
+            int n_points = mesh.point_count();
+            Kokkos::View<int *> offsets("Gather incident offsets", n_points + 1);
+            Kokkos::View<int *> entries("Gather incident entries", 3 * mesh.region_count());
+
+            // Count the elements of each point, shifted by one so the scan leaves row starts.
+            Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int r) {
+                Region element = mesh.region(r);
+                for (int j = 0; j < 3; j++) {
+                    Kokkos::atomic_add(&offsets(element[j] + 1), 1);
+                } });
+            Kokkos::parallel_scan(Kokkos::RangePolicy<>(space, 0, n_points + 1), KOKKOS_LAMBDA(int i, int &partial, bool final) {
+                partial += offsets(i);
+                if (final) {
+                    offsets(i) = partial;
+                } });
+
+            // Fill, then sort each (short) row by insertion sort
+            Kokkos::View<int *> fill("Gather fill counts", n_points);
+            Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int r) {
+                Region element = mesh.region(r);
+                for (int j = 0; j < 3; j++) {
+                    int p = element[j];
+                    entries(offsets(p) + Kokkos::atomic_fetch_add(&fill(p), 1)) = 3 * r + j;
+                } });
+            Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, n_points), KOKKOS_LAMBDA(int p) {
+                for (int a = offsets(p) + 1; a < offsets(p + 1); a++) {
+                    int value = entries(a);
+                    int b = a - 1;
+                    for (; b >= offsets(p) && entries(b) > value; b--) {
+                        entries(b + 1) = entries(b);
+                    }
+                    entries(b + 1) = value;
+                } });
+
+            incident_offsets = offsets;
+            incident_entries = entries;
+        }
+
+        template <typename WorkerFunctor>
+        void distribute_work(WorkerFunctor functor)
+        {
+            auto mesh = this->mesh;
+            if constexpr (!has_gather_interface_v<WorkerFunctor>)
+            {
+                Kokkos::parallel_for("GatherElementScatterAdd element-wise", Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int element_id) {
+                    Region element = mesh.region(element_id);
+                    functor(element, element_id); });
+            }
+            else
+            {
+                using Contribution = gather_contribution_t<WorkerFunctor>;
+                auto offsets = incident_offsets;
+                auto entries = incident_entries;
+                if (mode == GatherMode::Buffered)
+                {
+                    auto buffer = element_buffer;
+                    Kokkos::parallel_for("GatherElementScatterAdd element pass", Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int element_id) {
+                        Contribution contributions[3];
+                        functor.element_contributions(mesh.region(element_id), element_id, contributions);
+                        for (int j = 0; j < 3; j++) {
+                            buffer(element_id, j) = contributions[j];
+                        } });
+                    Kokkos::parallel_for("GatherElementScatterAdd point pass", Kokkos::RangePolicy<>(space, 0, mesh.point_count()), KOKKOS_LAMBDA(int p) {
+                        Contribution sum = 0;
+                        for (int k = offsets(p); k < offsets(p + 1); k++) {
+                            int packed = entries(k);
+                            sum += static_cast<Contribution>(buffer(packed / 3, packed % 3));
+                        }
+                        *functor.target(p) += sum; });
+                }
+                else
+                {
+                    Kokkos::parallel_for("GatherElementScatterAdd recompute", Kokkos::RangePolicy<>(space, 0, mesh.point_count()), KOKKOS_LAMBDA(int p) {
+                        Contribution sum = 0;
+                        for (int k = offsets(p); k < offsets(p + 1); k++) {
+                            int packed = entries(k);
+                            int element_id = packed / 3;
+                            Contribution contributions[3];
+                            functor.element_contributions(mesh.region(element_id), element_id, contributions);
+                            sum += contributions[packed % 3];
+                        }
+                        *functor.target(p) += sum; });
+                }
+            }
+        }
+
+        static constexpr bool supports_graph = true;
+
+        template <typename WorkerFunctor>
+        ScatterGraphNode then_distribute_work(ScatterGraphNode node, WorkerFunctor functor)
+        {
+            auto mesh = this->mesh;
+            if constexpr (!has_gather_interface_v<WorkerFunctor>)
+            {
+                return node.then_parallel_for(Kokkos::RangePolicy<>(0, mesh.region_count()), KOKKOS_LAMBDA(int element_id) {
+                    Region element = mesh.region(element_id);
+                    functor(element, element_id); });
+            }
+            else
+            {
+                using Contribution = gather_contribution_t<WorkerFunctor>;
+                auto offsets = incident_offsets;
+                auto entries = incident_entries;
+                if (mode == GatherMode::Buffered)
+                {
+                    auto buffer = element_buffer;
+                    ScatterGraphNode filled = node.then_parallel_for(Kokkos::RangePolicy<>(0, mesh.region_count()), KOKKOS_LAMBDA(int element_id) {
+                        Contribution contributions[3];
+                        functor.element_contributions(mesh.region(element_id), element_id, contributions);
+                        for (int j = 0; j < 3; j++) {
+                            buffer(element_id, j) = contributions[j];
+                        } });
+                    return filled.then_parallel_for(Kokkos::RangePolicy<>(0, mesh.point_count()), KOKKOS_LAMBDA(int p) {
+                        Contribution sum = 0;
+                        for (int k = offsets(p); k < offsets(p + 1); k++) {
+                            int packed = entries(k);
+                            sum += static_cast<Contribution>(buffer(packed / 3, packed % 3));
+                        }
+                        *functor.target(p) += sum; });
+                }
+                return node.then_parallel_for(Kokkos::RangePolicy<>(0, mesh.point_count()), KOKKOS_LAMBDA(int p) {
+                    Contribution sum = 0;
+                    for (int k = offsets(p); k < offsets(p + 1); k++) {
+                        int packed = entries(k);
+                        int element_id = packed / 3;
+                        Contribution contributions[3];
+                        functor.element_contributions(mesh.region(element_id), element_id, contributions);
+                        sum += contributions[packed % 3];
+                    }
+                    *functor.target(p) += sum; });
+            }
+        }
+
+        // Only used by functors without the gather interface, which run element-wise
+        template <typename Scalar>
+        static KOKKOS_INLINE_FUNCTION void contribute(Scalar *dest, Scalar contribution)
+        {
+            Kokkos::atomic_add(dest, contribution);
+        }
+    };
+
+    // Patterns over the default (array-of-structs) mesh layout
+    typedef BasicAtomicElementScatterAdd<DeviceMesh> AtomicElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceMesh> ColoredElementScatterAdd;
+    typedef BasicSerialElementScatterAdd<DeviceMesh> SerialElementScatterAdd;
+    typedef BasicGatherElementScatterAdd<DeviceMesh> GatherElementScatterAdd;
+
+    // Patterns over the structure-of-arrays mesh layout
+    typedef BasicAtomicElementScatterAdd<DeviceSoAMesh> SoAAtomicElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceSoAMesh> SoAColoredElementScatterAdd;
+    typedef BasicSerialElementScatterAdd<DeviceSoAMesh> SoASerialElementScatterAdd;
+    typedef BasicGatherElementScatterAdd<DeviceSoAMesh> SoAGatherElementScatterAdd;
+
+    // Patterns over meshes with single precision coordinates
+    typedef BasicAtomicElementScatterAdd<DeviceFloatMesh> FloatAtomicElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceFloatMesh> FloatColoredElementScatterAdd;
+    typedef BasicGatherElementScatterAdd<DeviceFloatMesh> FloatGatherElementScatterAdd;
+    typedef BasicAtomicElementScatterAdd<DeviceSoAFloatMesh> SoAFloatAtomicElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceSoAFloatMesh> SoAFloatColoredElementScatterAdd;
+
+    // Patterns over meshes with compact regions (see Mesh::with_compact_regions)
+    typedef BasicAtomicElementScatterAdd<DeviceCompactMesh> CompactAtomicElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceCompactMesh> CompactColoredElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceCompactFloatMesh> CompactFloatColoredElementScatterAdd;
+
+    // Patterns over meshes with 32 bit unsigned vertex IDs (see Mesh::with_index)
+    typedef BasicAtomicElementScatterAdd<DeviceUInt32Mesh> UInt32AtomicElementScatterAdd;
+    typedef BasicColoredElementScatterAdd<DeviceUInt32Mesh> UInt32ColoredElementScatterAdd;
 }
 
 #endif // Include guard
\ No newline at end of file
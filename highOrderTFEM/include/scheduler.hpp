@@ -0,0 +1,88 @@
+/**
+ * Running many small independent solvers side by side on one device.
+ */
+#ifndef highOrderTFEM_scheduler_hpp
+#define highOrderTFEM_scheduler_hpp
+
+#include <functional>
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+
+namespace TFEM
+{
+    /**
+     * Advances several independent solvers together, each on its own execution space instance
+     * (a CUDA stream or HIP queue), so that solvers too small to fill the device on their own
+     * can share it.
+     *
+     * The scheduler splits the default execution space into instances; build each solver's scatter
+     * pattern (and, for colored patterns, its coloring) on one of them so the solver's kernels go
+     * there too, e.g.
+     *
+     *     ConcurrentScheduler scheduler(4);
+     *     ColoredElementScatterAdd pattern(mesh, scheduler.instance(j % 4));
+     *     Solver<ColoredElementScatterAdd> solver(mesh, pattern, ...);
+     *     scheduler.add(solver);
+     *
+     * simulate_steps() then takes the steps in rounds, enqueueing one round of every solver before
+     * the next, and only fences at the end. Solvers sharing an instance run one after the other.
+     * Solvers whose steps block on the host (the implicit step modes) still run correctly, but
+     * overlap less.
+     *
+     * On backends without asynchronous instances the solvers simply run in turn.
+     */
+    class ConcurrentScheduler
+    {
+    protected:
+        struct Job
+        {
+            std::function<void(int)> simulate_steps;
+            Kokkos::DefaultExecutionSpace space;
+        };
+
+        std::vector<Kokkos::DefaultExecutionSpace> instances;
+        std::vector<Job> jobs;
+
+    public:
+        /**
+         * Splits the default execution space into n_instances instances of equal weight.
+         */
+        ConcurrentScheduler(int n_instances);
+
+        int instance_count() const { return instances.size(); }
+
+        /**
+         * The i-th instance, to build solvers' scatter patterns on.
+         */
+        Kokkos::DefaultExecutionSpace instance(int i) const { return instances.at(i); }
+
+        /**
+         * Adds a solver (anything with simulate_steps(int) and execution_space(), such as
+         * Solver<Pattern>). It is kept by reference, so it must outlive the scheduler's use of it.
+         */
+        template <class SolverT>
+        void add(SolverT &solver)
+        {
+            jobs.push_back(Job{[&solver](int n_steps)
+                                { solver.simulate_steps(n_steps); },
+                                solver.execution_space()});
+        }
+
+        int job_count() const { return jobs.size(); }
+
+        /**
+         * Advances every solver by n_steps, steps_per_round at a time per solver, then waits for
+         * all of them. Fewer steps per round mix the solvers more evenly, at the cost of more
+         * host round trips for solvers that fence on their own.
+         */
+        void simulate_steps(int n_steps, int steps_per_round = 8);
+
+        /**
+         * Waits for every added solver's queued work.
+         */
+        void fence();
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * Asynchronous output of solution snapshots to a binary file.
+ */
+#ifndef highOrderTFEM_snapshot_hpp
+#define highOrderTFEM_snapshot_hpp
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+
+namespace TFEM
+{
+    /**
+     * Header of a snapshot file (".tfs"), followed by:
+     *  - the x coordinates of every point, then the y coordinates (n_points float64 each),
+     *  - n_slices slices, each being the time of the slice followed by one float64 per point.
+     * Points are in the mesh file's order, and everything is in native byte order. The slice
+     * count is filled in when the writer is closed, so an interrupted run shows zero slices;
+     * its completed slices can still be recovered from the file size.
+     */
+    struct SnapshotFileHeader
+    {
+        char tag[8];
+        uint32_t version;
+        uint32_t header_bytes;
+        int64_t n_points;
+        int64_t n_slices;
+    };
+
+    constexpr char SNAPSHOT_FILE_TAG[8] = {'T', 'F', 'E', 'M', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t SNAPSHOT_FILE_VERSION = 1;
+
+    /**
+     * Writes snapshots of the solution without stalling the simulation on the file system.
+     *
+     * add_slice() copies the state into one of a small pool of device staging buffers (ordered
+     * after the kernels that produced it), then queues the transfer to a matching pinned host buffer
+     * on a separate execution space instance so it can overlap the following steps. A background
+     * thread waits for the transfer, writes the slice and returns the buffers to the pool. add_slice
+     * only blocks when every buffer is still in flight.
+     *
+     * See snapshot_to_json for converting the output to the JSON format of SolutionWriter.
+     */
+    class AsyncSnapshotWriter
+    {
+    public:
+#ifdef KOKKOS_HAS_SHARED_HOST_PINNED_SPACE
+        using PinnedSpace = Kokkos::SharedHostPinnedSpace;
+#else
+        using PinnedSpace = Kokkos::HostSpace;
+#endif
+        using StagingBuffer = Kokkos::View<double *>;
+        using HostBuffer = Kokkos::View<double *, PinnedSpace>;
+
+    protected:
+        struct Job
+        {
+            int buffer;
+            double time;
+        };
+
+        std::ofstream out_file;
+        std::string fname;
+        pointID n_points;
+        int64_t slice_count;
+        MeshPermutation permutation;
+
+        Kokkos::DefaultExecutionSpace copy_space;
+        std::vector<StagingBuffer> staging_buffers;
+        std::vector<HostBuffer> host_buffers;
+
+        // Shared with the writer thread, guarded by mutex
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<int> free_buffers;
+        std::deque<Job> jobs;
+        bool closing;
+        std::exception_ptr write_error;
+        std::thread writer;
+
+        /**
+         * Background thread body: writes queued slices in order until closed.
+         */
+        void writer_loop();
+
+        /**
+         * Writes the file header and point coordinates.
+         */
+        void write_header(const std::vector<double> &xs, const std::vector<double> &ys);
+
+        /**
+         * Waits for a free buffer and returns its index. Rethrows any earlier write error.
+         */
+        int acquire_buffer();
+
+        /**
+         * Queues the buffer, already filled on the device, for writing.
+         */
+        void submit(int buffer, double time);
+
+        void start(const std::vector<double> &xs, const std::vector<double> &ys, int n_buffers);
+
+    public:
+        /**
+         * Opens the file and writes the mesh coordinates. Takes a host-accessible mesh of either
+         * layout; if the mesh was reordered, pass the permutation returned by reorder_mesh to write
+         * in the original point order. n_buffers is the number of slices that may be in flight.
+         */
+        template <class HostMeshT>
+        AsyncSnapshotWriter(std::string fname, HostMeshT &mesh, MeshPermutation permutation = MeshPermutation(), int n_buffers = 3)
+            : fname(fname), n_points(mesh.point_count()), slice_count(0), permutation(permutation), closing(false)
+        {
+            std::vector<double> xs(n_points);
+            std::vector<double> ys(n_points);
+            for (pointID p = 0; p < n_points; p++)
+            {
+                pointID source = permutation.is_identity() ? p : permutation.point_old_to_new(p);
+                xs[p] = mesh.coord(source, 0);
+                ys[p] = mesh.coord(source, 1);
+            }
+            start(xs, ys, n_buffers);
+        }
+
+        /**
+         * Queues a snapshot of a device state view (of any floating point type) taken at the given
+         * time. The view is staged on space, which must be the instance the kernels writing it run
+         * on (a solver's execution_space()), so work launched there before this call is waited for;
+         * the view may be modified again as soon as this returns.
+         */
+        template <class ViewType>
+        void add_slice(ViewType view, double time, Kokkos::DefaultExecutionSpace space)
+        {
+            static_assert(Kokkos::is_view_v<ViewType>, "ViewType must be view");
+            static_assert(ViewType::rank == 1, "Points are arranged as a flat grid");
+            if ((pointID)view.extent(0) != n_points)
+            {
+                throw std::invalid_argument("AsyncSnapshotWriter: slice has " + std::to_string(view.extent(0)) + " points, expected " + std::to_string(n_points));
+            }
+
+            int buffer = acquire_buffer();
+            // Device-side copy on the writer's instance, so it is ordered after the step kernels
+            auto staging = staging_buffers[buffer];
+            Kokkos::parallel_for(
+                "Snapshot staging copy", Kokkos::RangePolicy<>(space, 0, n_points), KOKKOS_LAMBDA(int i) { staging(i) = view(i); });
+            // The transfer runs on its own instance, which does not wait for space
+            space.fence("Snapshot staged");
+            Kokkos::deep_copy(copy_space, host_buffers[buffer], staging);
+            submit(buffer, time);
+        }
+
+        /**
+         * Blocks until every queued slice is on disk (flushed to the OS).
+         */
+        void flush();
+
+        /**
+         * Number of slices written to the file so far.
+         */
+        int64_t slices_written();
+
+        /**
+         * Writes any remaining slices and the final slice count.
+         */
+        ~AsyncSnapshotWriter();
+    };
+
+    /**
+     * Converts a snapshot file to the JSON format written by SolutionWriter (and read by the
+     * visualization scripts). Slice times are dropped, as that format has no place for them.
+     */
+    void snapshot_to_json(std::string snapshot_fname, std::string json_fname);
+}
+
+#endif
@@ -1,10 +1,14 @@
 #ifndef highOrderTFEM_fem_hpp
 #define highOrderTFEM_fem_hpp
 
+#include <cstdint>
 #include <string>
 #include <fstream>
+#include <optional>
+#include <vector>
 
 #include <Kokkos_Core.hpp>
+#include <KokkosSparse_CrsMatrix.hpp>
 #include "mesh.hpp"
 #include "type_magic.hpp"
 #include "analytical.hpp"
@@ -15,41 +19,288 @@ namespace TFEM
 
     namespace SolverImpl
     {
-        template <typename ScatterPattern>
+        template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
         struct ElementContributionFunctor;
 
-        template <typename ScatterPattern>
+        template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
         struct MassMatrixFunctor;
+
+        template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
+        struct ElementGeometryFunctor;
+
+        template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
+        struct OperatorAssemblyFunctor;
+
+        template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
+        struct MultirateContributionFunctor;
+
+        template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
+        struct TemporalBlockFunctor;
     }
     class SolutionWriter;
 
-    template <typename ScatterPattern>
+    /**
+     * How a single time step is carried out.
+     *
+     *  - CopyAndFix: copy the current state into the previous state, add the element contributions
+     *    to the current state in place, and then clamp the boundary points in a separate pass. Fences
+     *    between every phase.
+     *  - Fused: swap the two state buffers instead of copying, and fold both the identity term and the
+     *    (zero) boundary clamp into the element update, so each step is one write-only fill followed by
+     *    the element kernel(s). No fences: kernels on the same execution space instance already run in
+     *    order, so the host only needs to wait when it actually reads data.
+     *  - AssembledSpMV: the step operator I - k*dt*M^-1*S is constant, so assemble it once into a
+     *    sparse matrix (boundary rows just the identity) and make each step a single KokkosSparse::spmv from
+     *    the previous buffer into the current one. Uses whatever SpMV KokkosKernels was built with.
+     *    Ignores cache_element_geometry.
+     *  - Graph: the Fused step (fill plus every element kernel) recorded once as a
+     *    Kokkos::Experimental::Graph and replayed each step, with ordering coming from the graph
+     *    edges. Since a graph captures its views, one graph is recorded for each direction between
+     *    the two buffers and they alternate in place of the swap. Needs a pattern that supports
+     *    graphs (see pattern_supports_graph).
+     *  - Multirate: local time stepping. Each element gets the largest step dt / 2^level (up to
+     *    SolverOptions::multirate_levels levels) that is stable for it, and each point steps at the
+     *    finest level among its elements. A step of dt is made of 2^(levels - 1) substeps of the
+     *    finest level; in each substep only the points whose level is due are updated, so only the
+     *    elements touching them are computed (the elements are grouped by the finest level among
+     *    their points, with one scatter pattern per group). Points that are not due keep their last
+     *    value, which their neighbors read in the meantime, so the scheme is first order in time
+     *    across level interfaces. Pays off when a few small elements would otherwise set dt for the
+     *    whole mesh. Ignores cache_element_geometry.
+     *  - BackwardEuler, CrankNicolson: implicit theta schemes (theta = 1 and 1/2), unconditionally
+     *    stable, so dt is only limited by accuracy. Each step solves
+     *    (M + theta*dt*k*S) u^{n+1} = (M - (1 - theta)*dt*k*S) u^n for the interior points with
+     *    conjugate gradients, Jacobi preconditioned by the lumped mass, starting from u^n. The
+     *    operator is applied matrix-free through the scatter pattern (the element kernel with the
+     *    identity term folded in), or as a CSR matrix with assemble_implicit_operator. The vector
+     *    operations go through KokkosBlas. Ignores cache_element_geometry.
+     *  - TemporalBlocked: advances SolverOptions::temporal_block_steps (s) steps per kernel. The
+     *    mesh is split into tiles of about SolverOptions::tile_points points (see
+     *    partition_mesh_regions), each extended by the s layers of ghost points and elements that
+     *    its points depend on over s steps. One team per tile loads the tile into scratch memory,
+     *    takes the s steps there (recomputing the element geometry each step, so only the points
+     *    have to fit), and writes back the points it owns, so the state and geometry cross DRAM
+     *    once per s steps. Ghost points are computed redundantly by every tile that holds them. The
+     *    results match the other explicit modes. Needs boundary values that do not change with
+     *    time; ignores cache_element_geometry.
+     */
+    enum class StepMode
+    {
+        CopyAndFix,
+        Fused,
+        AssembledSpMV,
+        Graph,
+        Multirate,
+        BackwardEuler,
+        CrankNicolson,
+        TemporalBlocked
+    };
+
+    /**
+     * How the CopyAndFix step mode holds the boundary (Dirichlet) values.
+     *
+     *  - Pass: after the element update, a separate kernel writes the boundary values, once per
+     *    point of the mesh's boundary_point_ids.
+     *  - Masked: the inverse masses of the boundary points are zeroed, so the element update
+     *    leaves them at the values they were given by the initial conditions. No boundary pass.
+     *
+     * The other step modes always mask: Fused and Graph start each step from a fill with fixed
+     * boundary values (zeros, or a precomputed array), AssembledSpMV gives the boundary rows an
+     * identity diagonal when the values are non-zero, and Multirate and TemporalBlocked never
+     * update them. Boundary
+     * values that change with time (see Analytical::PolynomialBoundary) are written by the
+     * boundary pass after every step in any mode, which only touches the boundary points.
+     */
+    enum class DirichletMode
+    {
+        Pass,
+        Masked
+    };
+
+    /**
+     * Optional solver settings. Defaults reproduce the original behavior.
+     */
+    struct SolverOptions
+    {
+        StepMode step_mode = StepMode::CopyAndFix;
+        // Precompute each element's local stiffness matrix once instead of recomputing the
+        // geometry every step. Costs 6 storage scalars per element.
+        bool cache_element_geometry = false;
+        // Tabulate the spatial part of the analytic solution at every point once, so the initial
+        // conditions and measure_error() skip the trig functions. Costs one double per point and
+        // solution term; cheap enough to measure the error every few steps.
+        bool tabulate_analytic = false;
+        // Fraction of the stability limit used when the solver picks the time step itself
+        // (by passing a timestep <= 0), see stable_timestep.
+        double timestep_safety = 0.9;
+        // Number of power-of-two step levels available to StepMode::Multirate
+        int multirate_levels = 4;
+        // See DirichletMode. Only changes the CopyAndFix step mode.
+        DirichletMode dirichlet_mode = DirichletMode::Pass;
+        // Implicit step modes: CG stops once the residual norm is below cg_tolerance times the
+        // norm of the right hand side, and throws if that takes more than cg_max_iterations.
+        double cg_tolerance = 1e-10;
+        int cg_max_iterations = 1000;
+        // Implicit step modes: assemble the system matrix once and apply it with
+        // KokkosSparse::spmv, rather than running the element kernels for every CG iteration.
+        bool assemble_implicit_operator = false;
+        // TemporalBlocked step mode: steps per kernel (and ghost layers per tile), and the target
+        // number of owned points per tile
+        int temporal_block_steps = 4;
+        int tile_points = 256;
+    };
+
+    /**
+     * Largest explicit (forward Euler) time step each element is stable for on its own, i.e.
+     * 2 / (k * element_stiffness_bound), indexed by region ID. Always computed in double, on
+     * space (the view is filled once work launched there afterwards runs).
+     */
+    template <class MeshT>
+    Kokkos::View<double *> element_stable_timesteps(MeshT mesh, double k, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace());
+
+    /**
+     * A stable time step for the explicit scheme on the whole mesh: the smallest per-element limit
+     * (a device reduction over the element geometry), scaled by the safety factor. The bound is
+     * conservative, so the result is below the true limit even with a safety factor of 1. Reduces
+     * on space.
+     */
+    template <class MeshT>
+    double stable_timestep(MeshT mesh, double k, double safety = 0.9, Kokkos::DefaultExecutionSpace space = Kokkos::DefaultExecutionSpace());
+
+    /**
+     * Explicit mass-lumped linear FEM solver for the heat equation.
+     *
+     * The state, inverse masses, geometry cache and assembled operator are stored as StorageScalar,
+     * while the element kernels load into and accumulate in ComputeScalar (the geometry is
+     * converted too, so it may come from a mesh in either precision; see Mesh::with_point_scalar).
+     * E.g. <Pattern, float, double> halves the memory traffic but keeps the arithmetic in double,
+     * and <Pattern, float> runs entirely in single precision. Errors are always measured in double.
+     *
+     * Each setup and step phase is a Kokkos Tools region and, with Instrumentation enabled, a timed
+     * phase (see instrumentation.hpp) whose elements are those the phase advances.
+     *
+     * Everything runs on the scatter pattern's execution space instance (see
+     * pattern_execution_space), with fences on that instance only, so solvers on different
+     * instances can run at the same time (see ConcurrentScheduler).
+     */
+    template <typename ScatterPattern, typename StorageScalar = double, typename ComputeScalar = StorageScalar>
     class Solver
     {
         friend class SolutionWriter;
 
-        friend class SolverImpl::ElementContributionFunctor<ScatterPattern>;
-        friend class SolverImpl::MassMatrixFunctor<ScatterPattern>;
+        friend class SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+        friend class SolverImpl::MassMatrixFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+        friend class SolverImpl::ElementGeometryFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+        friend class SolverImpl::OperatorAssemblyFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+        friend class SolverImpl::MultirateContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+        friend class SolverImpl::TemporalBlockFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+
+    public:
+        // Mesh type (and so memory layout) the scatter pattern works over
+        using MeshT = typename ScatterPattern::MeshType;
 
     protected:
         // Stores 1/diagonals (diagonals^-1) for the lumped diagonal mass matrix.
-        using InvMassMatrix = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using InvMassMatrix = Kokkos::View<StorageScalar *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
         using ConstInvMassMatrix = constify_view_t<InvMassMatrix>;
         InvMassMatrix point_mass_inv;
         ConstInvMassMatrix point_mass_inv_readonly;
 
+        // Optional per-element cache of the local stiffness matrix (already scaled by -k*dt), in the
+        // scatter pattern's slot order. Only the 6 unique entries of the symmetric 3x3 matrix are kept,
+        // stored coefficient-major so neighboring elements read neighboring memory.
+        using ElementGeometryCache = Kokkos::View<StorageScalar *[6], Kokkos::LayoutLeft>;
+        using ConstElementGeometryCache = constify_view_t<ElementGeometryCache>;
+        ElementGeometryCache element_geometry;
+
+        // Assembled step operator for the AssembledSpMV step mode. Rows are points, with the
+        // diagonal stored first in each row followed by the edge neighbors in increasing order.
+        using StepOperator = KokkosSparse::CrsMatrix<StorageScalar, int, Kokkos::DefaultExecutionSpace::device_type, void, int>;
+        StepOperator step_operator;
+
+        // Implicit step modes: 1 for interior points and 0 for boundary points (the operator's row
+        // scale, so boundary rows stay empty), the assembled system matrix if requested, and the CG
+        // residual, preconditioned residual, search direction and operator product.
+        InvMassMatrix implicit_mask;
+        StepOperator implicit_operator;
+        Kokkos::View<StorageScalar *> cg_residual;
+        Kokkos::View<StorageScalar *> cg_preconditioned;
+        Kokkos::View<StorageScalar *> cg_search;
+        Kokkos::View<StorageScalar *> cg_product;
+        int last_cg_iterations;
+
+        // Recorded steps for the Graph step mode. step_graphs[i] advances from buffer i to the
+        // other one, where buffer 0 is what current_point_weights held at construction.
+        using StepGraph = Kokkos::Experimental::Graph<Kokkos::DefaultExecutionSpace>;
+        std::optional<StepGraph> step_graphs[2];
+        int next_step_graph;
+
+        // Multirate step mode: the level of each point (it steps by dt / 2^level), and the elements
+        // grouped by the finest level among their points, each group with its own scatter pattern
+        // (empty for an empty group).
+        Kokkos::View<int *> point_levels;
+        std::vector<MeshT> level_meshes;
+        std::vector<std::optional<ScatterPattern>> level_patterns;
+        int n_levels;
+
+        // TemporalBlocked step mode: tile t holds the global points
+        // tile_point_ids[tile_point_starts(t), tile_point_starts(t + 1)), its owned points first, and
+        // the elements tile_region_vertices[tile_region_starts(t), tile_region_starts(t + 1)) with
+        // vertices numbered within the tile. The largest tile sizes the scratch memory, which is
+        // on scratch level tile_scratch_level.
+        Kokkos::View<int *> tile_point_starts;
+        Kokkos::View<int *> tile_owned_counts;
+        Kokkos::View<pointID *> tile_point_ids;
+        Kokkos::View<int *> tile_region_starts;
+        Kokkos::View<int *[3]> tile_region_vertices;
+        int max_tile_points;
+        int max_tile_regions;
+        int tile_scratch_level;
+
+        /**
+         * Memory traffic model of one pass of the element kernel over n_elements elements, for the
+         * instrumentation: the vertex IDs and geometry (the cache, or each point's coordinates once)
+         * of every element, plus reading each point's previous value and inverse mass and reading and
+         * writing its new value once. Compulsory traffic only, so achieved bytes/s against it is an
+         * effective bandwidth.
+         */
+        double element_pass_bytes(int n_elements);
+
+        // Shared by both checkpoint() overloads; host_mesh may be null
+        void write_checkpoint(std::string fname, typename MeshT::HostMirrorMesh *host_mesh);
+
         // Mesh and coloring
-        DeviceMesh mesh;
+        MeshT mesh;
         ScatterPattern scatter_pattern;
-        Analytical::ZeroBoundary<> boundary;
+        // Instance every kernel and copy is launched on, taken from the pattern
+        Kokkos::DefaultExecutionSpace exec_space;
+        Analytical::PolynomialBoundary<> boundary;
+        // Only filled with the tabulate_analytic option
+        Analytical::TabulatedZeroBoundary tabulated_boundary;
+        // The state each fused step starts from: the (fixed, non-zero) boundary values, and zero
+        // elsewhere. Empty when a zero fill does.
+        Kokkos::View<StorageScalar *> dirichlet_fill;
 
         // Parameters
         double dt;
         double k;
         int n_total_steps;
+        SolverOptions options;
 
     public:
         double time() { return dt * n_total_steps; }
+        double timestep() { return dt; }
+        Kokkos::DefaultExecutionSpace execution_space() { return exec_space; }
+
+        /**
+         * Multirate step mode: the number of elements in each level group, finest level last.
+         */
+        std::vector<int> level_element_counts();
+
+        /**
+         * Implicit step modes: CG iterations taken by the last step.
+         */
+        int cg_iterations() { return last_cg_iterations; }
 
         // Internal step simulation functions. Essentially called in order.
         // I would like very much for these to be private/protected, but
@@ -61,6 +312,140 @@ namespace TFEM
          * Initialize the system mass matrix and its readonly counterpart
          */
         void setup_mass_matrix();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * If enabled, fill the per-element stiffness cache. Must run after setup_mass_matrix.
+         */
+        void setup_element_geometry();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * AssembledSpMV step mode: build the sparsity pattern from the mesh edges and assemble the
+         * step operator. Must run after setup_mass_matrix.
+         */
+        void setup_step_operator();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Builds a matrix over the mesh's edge graph (diagonal first in each row, then the edge
+         * neighbors in increasing order) holding -k * scaled_dt * S with row p scaled by row_scale(p),
+         * assembled through the scatter pattern. Callers add whatever diagonal term they need.
+         */
+        StepOperator assemble_stiffness_operator(ConstInvMassMatrix row_scale, double scaled_dt);
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Implicit step modes: allocate the CG vectors and the boundary mask, and assemble the
+         * system matrix if requested. Must run after setup_mass_matrix.
+         */
+        void setup_implicit();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Drops the edges from the solver's copies of the mesh (its own, the pattern's and the
+         * multirate levels'), since nothing after the operator setup reads them. Runs before the
+         * step graphs and tiles capture further copies, so the edges are freed once the caller
+         * releases its own (see Mesh::release_edges).
+         */
+        void release_setup_edges();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Whether the step mode is one of the implicit ones.
+         */
+        bool is_implicit() const
+        {
+            return options.step_mode == StepMode::BackwardEuler || options.step_mode == StepMode::CrankNicolson;
+        }
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Whether cache_element_geometry is set and the step mode reads the cache.
+         */
+        bool caches_element_geometry() const
+        {
+            return options.cache_element_geometry && !is_implicit() && options.step_mode != StepMode::AssembledSpMV &&
+                   options.step_mode != StepMode::Multirate && options.step_mode != StepMode::TemporalBlocked;
+        }
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * The theta of the implicit scheme.
+         */
+        double implicit_theta() const
+        {
+            return options.step_mode == StepMode::CrankNicolson ? 0.5 : 1.0;
+        }
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Graph step mode: record the two step graphs. Must run after the other setup functions.
+         */
+        void setup_step_graphs();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Multirate step mode: assign the element and point levels and build the level groups. Picks
+         * dt if it was left to the solver. Must run before setup_mass_matrix.
+         */
+        void setup_multirate_levels();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * TemporalBlocked step mode: partition the mesh into tiles and add the ghost layers. Runs on
+         * the host, over a host copy of the mesh.
+         */
+        void setup_temporal_tiles();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Whether the step folds the identity term and boundary mask into the element update.
+         */
+        bool uses_fused_update() const
+        {
+            return options.step_mode == StepMode::Fused || options.step_mode == StepMode::Graph;
+        }
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Whether the inverse masses of the boundary points are zeroed, so that they receive no
+         * contributions.
+         */
+        bool masks_boundary_mass() const
+        {
+            return uses_fused_update() || options.step_mode == StepMode::AssembledSpMV || options.step_mode == StepMode::Multirate ||
+                   options.step_mode == StepMode::TemporalBlocked ||
+                   (options.step_mode == StepMode::CopyAndFix && options.dirichlet_mode == DirichletMode::Masked);
+        }
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Whether each step ends with fix_boundary().
+         */
+        bool uses_boundary_pass() const
+        {
+            return (options.step_mode == StepMode::CopyAndFix && options.dirichlet_mode == DirichletMode::Pass) || boundary.is_time_dependent();
+        }
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Fill dirichlet_fill if the fused step modes need it.
+         */
+        void setup_dirichlet_fill();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see checkpoint()
+         *
+         * Hash of the order the scatter pattern visits elements in (see CheckpointHeader).
+         */
+        uint64_t slot_order_hash();
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Called by the restore constructor.
+         *
+         * Reads the state and setup of a checkpoint, running only the setup phases whose results
+         * the checkpoint does not have.
+         */
+        void restore_checkpoint(std::string fname);
         /**
          * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
          *
@@ -93,15 +478,66 @@ namespace TFEM
          * For the moment, it seems easier to let the main loop body calculate whatever it wants for
          * values determined by the boundary conditions, and then fix them later. This way the main
          * loop doesn't need to spend time disambiguating whether or not a value is a boundary value.
+         *
+         * Writes the boundary values at the current time to each boundary point once.
          */
         void fix_boundary();
 
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Fused and AssembledSpMV step modes: make the step that just completed the previous state by
+         * swapping the buffer handles (no copy). Clears the buffer that will receive the new state
+         * if requested, which is only needed when the step accumulates into it.
+         */
+        void swap_buffers(bool clear_current = true);
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Fused step mode: compute the full new state from the previous state, including the
+         * identity-matrix term. Boundary points have a zeroed inverse mass, so they receive no
+         * contributions and stay at 0.
+         */
+        void compute_fused_step();
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * AssembledSpMV step mode: overwrite the current state with the step operator applied to
+         * the previous state.
+         */
+        void compute_spmv_step();
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Multirate step mode: advance every point by dt through the substeps of its level. Boundary
+         * points have a zeroed inverse mass, as in the Fused step mode.
+         */
+        void compute_multirate_step();
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Implicit step modes: solve for the current state from the previous one with CG.
+         */
+        void compute_implicit_step();
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * TemporalBlocked step mode: advance n_steps (at most temporal_block_steps) steps from the
+         * previous state into the current one, with one team per tile.
+         */
+        void compute_temporal_block(int n_steps);
+
     public:
         // This section was intended to be public, rather than being forced to make it accessible to
         // the nvidia compiler.
 
         // Weight buffers for storing state
-        using PointWeightBuffer = Kokkos::View<double *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+        using PointWeightBuffer = Kokkos::View<StorageScalar *, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
         using ConstPointWeightBuffer = constify_view_t<PointWeightBuffer>;
         PointWeightBuffer current_point_weights;
         PointWeightBuffer prev_point_weights;
@@ -110,10 +546,55 @@ namespace TFEM
         // optimizations.
         ConstPointWeightBuffer prev_point_weights_readonly;
 
-        Solver(DeviceMesh, ScatterPattern, Analytical::ZeroBoundary<>, double timestep, double k);
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Graph step mode: adds one full fused step from "from" into "to" after the given graph
+         * node. Declared here since it needs the buffer types.
+         */
+        ScatterGraphNode record_graph_step(ScatterGraphNode root, PointWeightBuffer to, ConstPointWeightBuffer from);
+
+        /**
+         * INTENDED PRIVATE: DO NOT CALL. Instead see simulate_steps()
+         *
+         * Implicit step modes: y = (M + theta*dt*k*S) x on the interior rows, 0 on the boundary rows.
+         */
+        void apply_implicit_operator(ConstPointWeightBuffer x, PointWeightBuffer y);
+
+        /**
+         * A timestep <= 0 lets the solver pick the step: stable_timestep() with the options' safety
+         * factor, or for StepMode::Multirate the largest step its levels can cover.
+         */
+        Solver(MeshT, ScatterPattern, Analytical::PolynomialBoundary<>, double timestep, double k, SolverOptions options = SolverOptions());
+
+        /**
+         * Resumes a run from a file written by checkpoint(), skipping the setup: dt, k and the step
+         * count come from the file, and the state, inverse masses, element geometry cache and
+         * assembled step operator are read instead of computed. The mesh must be the one the
+         * checkpoint was written for (load_mesh_from_checkpoint gives it back if it was embedded),
+         * and a colored pattern should use the checkpoint's coloring (load_coloring_from_checkpoint)
+         * for the geometry cache to be reused. Only what a checkpoint cannot hold is rebuilt: the
+         * Graph step mode's graphs, the Multirate level groups, the analytic tabulation, and any
+         * cache the options or pattern lay out differently from the checkpointed solver.
+         */
+        Solver(std::string checkpoint_file, MeshT, ScatterPattern, Analytical::PolynomialBoundary<>, SolverOptions options = SolverOptions());
+
+        /**
+         * Writes the state and setup to a checkpoint file (see checkpoint.hpp) to resume from with
+         * the restore constructor. Each section is copied from the device to a pinned host buffer
+         * and written with one sequential write. Passing the host mesh also embeds the mesh, so a
+         * restart does not need to parse the mesh file either; it must hold the same regions as
+         * the solver's mesh, or the checkpoint is refused.
+         */
+        void checkpoint(std::string fname);
+        void checkpoint(std::string fname, typename MeshT::HostMirrorMesh &host_mesh);
 
         /**
          * Runs the next n steps of the simulation, modifying current_point_weights in place.
+         *
+         * The explicit step modes only enqueue the steps, returning before they finish; fence
+         * execution_space() before reading the state from the host. (The implicit modes wait on
+         * every CG reduction.)
          */
         void simulate_steps(int n_steps);
 
@@ -138,52 +619,80 @@ namespace TFEM
          * A functor for computing the contribution each element makes to the new state,
          * called inside of the main time advancement loop.
          */
-        template <typename ScatterPattern>
+        template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
         struct ElementContributionFunctor
         {
-            using SolverT = Solver<ScatterPattern>;
+            using SolverT = Solver<ScatterPattern, StorageScalar, ComputeScalar>;
+            // Precision of element_contributions(), see has_gather_interface
+            using contribution_type = ComputeScalar;
             typename SolverT::PointWeightBuffer new_points;
             typename SolverT::ConstPointWeightBuffer prev_points;
             typename SolverT::ConstInvMassMatrix inv_mass;
-            DeviceMesh mesh;
-            double k;
-            double dt;
+            typename SolverT::MeshT mesh;
+            ComputeScalar k;
+            ComputeScalar dt;
+            // If set, each element also adds its share of the identity term, so new_points
+            // should start out zeroed rather than holding a copy of prev_points.
+            bool fold_identity;
+            // If non-empty, read the local stiffness matrix from here instead of from the mesh geometry.
+            typename SolverT::ConstElementGeometryCache geometry;
 
             ElementContributionFunctor(typename SolverT::PointWeightBuffer new_points,
                                        typename SolverT::ConstPointWeightBuffer prev_points,
                                        typename SolverT::ConstInvMassMatrix inv_mass,
-                                       DeviceMesh mesh,
-                                       double k, double dt)
+                                       typename SolverT::MeshT mesh,
+                                       double k, double dt,
+                                       bool fold_identity = false,
+                                       typename SolverT::ConstElementGeometryCache geometry = {})
                 : new_points(new_points),
                   prev_points(prev_points),
                   inv_mass(inv_mass),
                   mesh(mesh),
                   k(k),
-                  dt(dt)
+                  dt(dt),
+                  fold_identity(fold_identity),
+                  geometry(geometry)
             { // Pretty much just the initializer list
             }
 
             /**
              * Adds the partial contributions of an element to all pertinent coefficients.
              */
-            KOKKOS_INLINE_FUNCTION void operator()(Region element) const;
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+
+            /**
+             * Computes what the element adds to each of its points, for gather-based patterns.
+             */
+            KOKKOS_INLINE_FUNCTION void element_contributions(Region element, int slot, ComputeScalar contributions[3]) const;
+
+            /**
+             * element_contributions for a batch of elements, one per SIMD lane (see has_simd_interface).
+             */
+            template <typename SimdT>
+            KOKKOS_INLINE_FUNCTION void simd_element_contributions(const Region elements[], const int slots[], SimdT contributions[3]) const;
+
+            KOKKOS_INLINE_FUNCTION StorageScalar *target(pointID p) const
+            {
+                return &new_points(p);
+            }
         };
 
         /**
          * Functor called once per element when assembling the diagonal lumped mass matrix.
          */
-        template <typename ScatterPattern>
+        template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
         struct MassMatrixFunctor
         {
-            using SolverT = Solver<ScatterPattern>;
+            using SolverT = Solver<ScatterPattern, StorageScalar, ComputeScalar>;
+            using contribution_type = ComputeScalar;
 
             typename SolverT::InvMassMatrix inv_mass;
-            DeviceMesh mesh;
-            double k;
-            double dt;
+            typename SolverT::MeshT mesh;
+            ComputeScalar k;
+            ComputeScalar dt;
 
             MassMatrixFunctor(typename SolverT::InvMassMatrix inv_mass,
-                              DeviceMesh mesh,
+                              typename SolverT::MeshT mesh,
                               double k, double dt)
                 : inv_mass(inv_mass),
                   mesh(mesh),
@@ -195,7 +704,204 @@ namespace TFEM
             /**
              * Adds the contribution from the given element to the diagonal mass matrix
              */
-            KOKKOS_INLINE_FUNCTION void operator()(Region element) const;
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+
+            KOKKOS_INLINE_FUNCTION void element_contributions(Region element, int slot, ComputeScalar contributions[3]) const;
+
+            KOKKOS_INLINE_FUNCTION StorageScalar *target(pointID p) const
+            {
+                return &inv_mass(p);
+            }
+        };
+
+        /**
+         * Functor called once per element to fill the element geometry cache. Run through the
+         * same scatter pattern as the step itself, so the cache ends up in slot order.
+         */
+        template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+        struct ElementGeometryFunctor
+        {
+            using SolverT = Solver<ScatterPattern, StorageScalar, ComputeScalar>;
+
+            typename SolverT::ElementGeometryCache geometry;
+            typename SolverT::MeshT mesh;
+            ComputeScalar k;
+            ComputeScalar dt;
+            // Add the lumped mass to the diagonal, for the fused step mode
+            bool fold_identity;
+
+            ElementGeometryFunctor(typename SolverT::ElementGeometryCache geometry,
+                                   typename SolverT::MeshT mesh,
+                                   double k, double dt,
+                                   bool fold_identity)
+                : geometry(geometry),
+                  mesh(mesh),
+                  k(k),
+                  dt(dt),
+                  fold_identity(fold_identity)
+            { // Pretty much just the initializer list
+            }
+
+            /**
+             * Stores the scaled local stiffness matrix of the given element at its slot
+             */
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+
+        /**
+         * Functor called once per element to add its stiffness terms into the assembled step
+         * operator. Each entry (row, col) gets -k*dt*inv_mass(row)*S_row,col; the identity is added
+         * separately afterwards.
+         */
+        template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+        struct OperatorAssemblyFunctor
+        {
+            using SolverT = Solver<ScatterPattern, StorageScalar, ComputeScalar>;
+
+            Kokkos::View<StorageScalar *> values;
+            Kokkos::View<const int *> row_map;
+            Kokkos::View<const int *> entries;
+            typename SolverT::ConstInvMassMatrix inv_mass;
+            typename SolverT::MeshT mesh;
+            ComputeScalar k;
+            ComputeScalar dt;
+
+            OperatorAssemblyFunctor(Kokkos::View<StorageScalar *> values,
+                                    Kokkos::View<const int *> row_map,
+                                    Kokkos::View<const int *> entries,
+                                    typename SolverT::ConstInvMassMatrix inv_mass,
+                                    typename SolverT::MeshT mesh,
+                                    double k, double dt)
+                : values(values),
+                  row_map(row_map),
+                  entries(entries),
+                  inv_mass(inv_mass),
+                  mesh(mesh),
+                  k(k),
+                  dt(dt)
+            { // Pretty much just the initializer list
+            }
+
+            /**
+             * Adds the given element's local stiffness matrix to the rows of its points
+             */
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+        };
+
+        /**
+         * Functor computing an element's contribution to a multirate substep: each point of the
+         * element whose level is at least min_level gets -k * (dt / 2^level) * inv_mass * (S*u^n)
+         * for its row. Other points get nothing. new_points should hold a copy of prev_points.
+         */
+        template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+        struct MultirateContributionFunctor
+        {
+            using SolverT = Solver<ScatterPattern, StorageScalar, ComputeScalar>;
+            using contribution_type = ComputeScalar;
+
+            typename SolverT::PointWeightBuffer new_points;
+            typename SolverT::ConstPointWeightBuffer prev_points;
+            typename SolverT::ConstInvMassMatrix inv_mass;
+            Kokkos::View<const int *> point_levels;
+            typename SolverT::MeshT mesh;
+            ComputeScalar k;
+            ComputeScalar dt;
+            int min_level;
+
+            MultirateContributionFunctor(typename SolverT::PointWeightBuffer new_points,
+                                         typename SolverT::ConstPointWeightBuffer prev_points,
+                                         typename SolverT::ConstInvMassMatrix inv_mass,
+                                         Kokkos::View<const int *> point_levels,
+                                         typename SolverT::MeshT mesh,
+                                         double k, double dt,
+                                         int min_level)
+                : new_points(new_points),
+                  prev_points(prev_points),
+                  inv_mass(inv_mass),
+                  point_levels(point_levels),
+                  mesh(mesh),
+                  k(k),
+                  dt(dt),
+                  min_level(min_level)
+            { // Pretty much just the initializer list
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(Region element, int slot) const;
+
+            KOKKOS_INLINE_FUNCTION void element_contributions(Region element, int slot, ComputeScalar contributions[3]) const;
+
+            KOKKOS_INLINE_FUNCTION StorageScalar *target(pointID p) const
+            {
+                return &new_points(p);
+            }
+        };
+
+        /**
+         * Team functor for the TemporalBlocked step mode: one team per tile. Loads the tile's points
+         * (previous value, inverse mass and coordinates) and elements into scratch, takes n_steps
+         * explicit steps between two scratch buffers, and writes the tile's owned points to
+         * new_points. Boundary points have a zeroed inverse mass, so they keep their values.
+         */
+        template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+        struct TemporalBlockFunctor
+        {
+            using SolverT = Solver<ScatterPattern, StorageScalar, ComputeScalar>;
+            using member_type = Kokkos::TeamPolicy<>::member_type;
+            using ScratchSpace = Kokkos::DefaultExecutionSpace::scratch_memory_space;
+            using ScratchScalars = Kokkos::View<ComputeScalar *, ScratchSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+            using ScratchCoords = Kokkos::View<ComputeScalar *[2], ScratchSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+            using ScratchRegions = Kokkos::View<int *[3], ScratchSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged>>;
+
+            typename SolverT::PointWeightBuffer new_points;
+            typename SolverT::ConstPointWeightBuffer prev_points;
+            typename SolverT::ConstInvMassMatrix inv_mass;
+            typename SolverT::MeshT mesh;
+            Kokkos::View<const int *> tile_point_starts;
+            Kokkos::View<const int *> tile_owned_counts;
+            Kokkos::View<const pointID *> tile_point_ids;
+            Kokkos::View<const int *> tile_region_starts;
+            Kokkos::View<const int *[3]> tile_region_vertices;
+            ComputeScalar k;
+            ComputeScalar dt;
+            int n_steps;
+            int scratch_level;
+
+            TemporalBlockFunctor(typename SolverT::PointWeightBuffer new_points,
+                                 typename SolverT::ConstPointWeightBuffer prev_points,
+                                 typename SolverT::ConstInvMassMatrix inv_mass,
+                                 typename SolverT::MeshT mesh,
+                                 Kokkos::View<const int *> tile_point_starts,
+                                 Kokkos::View<const int *> tile_owned_counts,
+                                 Kokkos::View<const pointID *> tile_point_ids,
+                                 Kokkos::View<const int *> tile_region_starts,
+                                 Kokkos::View<const int *[3]> tile_region_vertices,
+                                 double k, double dt,
+                                 int n_steps, int scratch_level)
+                : new_points(new_points),
+                  prev_points(prev_points),
+                  inv_mass(inv_mass),
+                  mesh(mesh),
+                  tile_point_starts(tile_point_starts),
+                  tile_owned_counts(tile_owned_counts),
+                  tile_point_ids(tile_point_ids),
+                  tile_region_starts(tile_region_starts),
+                  tile_region_vertices(tile_region_vertices),
+                  k(k),
+                  dt(dt),
+                  n_steps(n_steps),
+                  scratch_level(scratch_level)
+            { // Pretty much just the initializer list
+            }
+
+            /**
+             * Scratch bytes per team for a tile of up to n_points points and n_regions elements.
+             */
+            static size_t scratch_bytes(int n_points, int n_regions)
+            {
+                return 3 * ScratchScalars::shmem_size(n_points) + ScratchCoords::shmem_size(n_points) + ScratchRegions::shmem_size(n_regions);
+            }
+
+            KOKKOS_INLINE_FUNCTION void operator()(const member_type &team) const;
         };
     } // namespace SolverImpl
 
@@ -206,14 +912,27 @@ namespace TFEM
     {
     protected:
         std::ofstream out_file;
-        DeviceMesh::HostMirrorMesh mesh;
+        pointID n_points;
         int slice_count;
+        MeshPermutation permutation;
+
+        // Point ID in the solver's numbering of the p-th point in the output
+        pointID source_point(pointID p) const
+        {
+            return permutation.is_identity() ? p : permutation.point_old_to_new(p);
+        }
 
     public:
-        SolutionWriter(std::string fname, DeviceMesh::HostMirrorMesh mesh)
+        /**
+         * Takes a host-accessible mesh of either layout. If the mesh was reordered, pass the
+         * permutation returned by reorder_mesh to write everything in the original point order.
+         */
+        template <class HostMeshT>
+        SolutionWriter(std::string fname, HostMeshT mesh, MeshPermutation permutation = MeshPermutation())
+            : permutation(permutation)
         {
             slice_count = 0;
-            this->mesh = mesh;
+            n_points = mesh.point_count();
             out_file = std::ofstream(fname);
             out_file << "{\"points\": [";
             for (pointID p = 0; p < mesh.point_count(); p++)
@@ -222,7 +941,8 @@ namespace TFEM
                 {
                     out_file << ", ";
                 }
-                out_file << "[" << mesh.points(p)[0] << ", " << mesh.points(p)[1] << "]";
+                auto point = mesh.point(source_point(p));
+                out_file << "[" << point[0] << ", " << point[1] << "]";
             }
             out_file << "],\n\"slices\":[";
         }
@@ -233,7 +953,7 @@ namespace TFEM
             static_assert(Kokkos::is_view_v<ViewType>, "ViewType must be view");
             static_assert(ViewType::Rank == 1, "Points are arranged as a flat grid");
             static_assert(Kokkos::SpaceAccessibility<Kokkos::HostSpace, typename ViewType::memory_space>::accessible, "View must be accessible from host");
-            assert(view.extent(0) == mesh.point_count());
+            assert(view.extent(0) == n_points);
 
             if (slice_count > 0)
             {
@@ -243,13 +963,13 @@ namespace TFEM
 
             out_file << std::endl
                      << "[";
-            for (pointID p = 0; p < mesh.point_count(); p++)
+            for (pointID p = 0; p < n_points; p++)
             {
                 if (p > 0)
                 {
                     out_file << ", ";
                 }
-                out_file << view(p);
+                out_file << view(source_point(p));
             }
             out_file << "]";
         }
@@ -265,6 +985,31 @@ namespace TFEM
     extern template class Solver<ColoredElementScatterAdd>;
     extern template class Solver<AtomicElementScatterAdd>;
     extern template class Solver<SerialElementScatterAdd>;
+    extern template class Solver<GatherElementScatterAdd>;
+    extern template class Solver<SoAColoredElementScatterAdd>;
+    extern template class Solver<SoAAtomicElementScatterAdd>;
+    extern template class Solver<SoASerialElementScatterAdd>;
+    extern template class Solver<SoAGatherElementScatterAdd>;
+    // Reduced precision: single precision state with double or single precision arithmetic
+    extern template class Solver<ColoredElementScatterAdd, float, double>;
+    extern template class Solver<AtomicElementScatterAdd, float, double>;
+    extern template class Solver<GatherElementScatterAdd, float, double>;
+    extern template class Solver<FloatColoredElementScatterAdd, float, double>;
+    extern template class Solver<FloatColoredElementScatterAdd, float, float>;
+    extern template class Solver<FloatAtomicElementScatterAdd, float, double>;
+    extern template class Solver<FloatAtomicElementScatterAdd, float, float>;
+    extern template class Solver<FloatGatherElementScatterAdd, float, float>;
+    extern template class Solver<SoAFloatColoredElementScatterAdd, float, double>;
+    extern template class Solver<SoAFloatColoredElementScatterAdd, float, float>;
+
+    extern template Kokkos::View<double *> element_stable_timesteps<DeviceMesh>(DeviceMesh, double, Kokkos::DefaultExecutionSpace);
+    extern template Kokkos::View<double *> element_stable_timesteps<DeviceSoAMesh>(DeviceSoAMesh, double, Kokkos::DefaultExecutionSpace);
+    extern template Kokkos::View<double *> element_stable_timesteps<DeviceFloatMesh>(DeviceFloatMesh, double, Kokkos::DefaultExecutionSpace);
+    extern template Kokkos::View<double *> element_stable_timesteps<DeviceSoAFloatMesh>(DeviceSoAFloatMesh, double, Kokkos::DefaultExecutionSpace);
+    extern template double stable_timestep<DeviceMesh>(DeviceMesh, double, double, Kokkos::DefaultExecutionSpace);
+    extern template double stable_timestep<DeviceSoAMesh>(DeviceSoAMesh, double, double, Kokkos::DefaultExecutionSpace);
+    extern template double stable_timestep<DeviceFloatMesh>(DeviceFloatMesh, double, double, Kokkos::DefaultExecutionSpace);
+    extern template double stable_timestep<DeviceSoAFloatMesh>(DeviceSoAFloatMesh, double, double, Kokkos::DefaultExecutionSpace);
 } // namespace TFEM
 
 #endif
\ No newline at end of file
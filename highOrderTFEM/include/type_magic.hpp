@@ -6,6 +6,8 @@
 #define highOrderTFEM_type_magic_hpp
 
 #include <Kokkos_Core.hpp>
+#include <type_traits>
+#include <utility>
 
 namespace TFEM
 {
@@ -30,6 +32,22 @@ namespace TFEM
     template <typename ViewT>
     using constify_view_t = typename constify_view<ViewT>::type;
 
+    template <typename Functor, int... Is>
+    KOKKOS_INLINE_FUNCTION constexpr void static_for_impl(Functor &&f, std::integer_sequence<int, Is...>)
+    {
+        (f(std::integral_constant<int, Is>()), ...);
+    }
+
+    /**
+     * Calls f(std::integral_constant<int, i>()) for i in [0, N), fully unrolled. Inside f, the index
+     * is a compile-time constant (decltype(i)::value), so lookups into constexpr tables fold away.
+     */
+    template <int N, typename Functor>
+    KOKKOS_INLINE_FUNCTION constexpr void static_for(Functor &&f)
+    {
+        static_for_impl(f, std::make_integer_sequence<int, N>());
+    }
+
 }
 
 #endif
\ No newline at end of file
@@ -1,77 +1,81 @@
 #include <iostream>
 #include <iomanip>
 
-#define COLOR 0
-#define ATOMIC 1
-#define SERIAL 2
-// Use this define statement to select algorithm
-#define SCATTER_ALGO COLOR
+// Set to 1 to store the mesh as structure-of-arrays instead of array-of-structs
+#define SOA_MESH 0
+// Set to 1 to time the loading, coloring and step phases (out/instrumentation.json). Timed phases
+// fence, so the overall step time is then no longer that of an unfenced run.
+#define TIME_PHASES 0
 
 #include <Kokkos_Core.hpp>
 #include <mesh.hpp>
 #include <solver.hpp>
+#include <any_solver.hpp>
 #include <analytical.hpp>
+#include <snapshot.hpp>
+#include <instrumentation.hpp>
 #include "scatter_pattern.hpp"
 
 int main(int argc, char *argv[])
 {
-    assert(argc > 1); // Must provide mesh input file
+    assert(argc > 1); // Must provide mesh input file, optionally followed by the scatter algorithm
     Kokkos::initialize(argc, argv);
     {
         std::cout << "Running with default execution space: " << Kokkos::DefaultExecutionSpace::name() << std::endl;
         std::cout << "\tDefault host execution space: " << Kokkos::DefaultHostExecutionSpace::name() << std::endl;
         std::cout << "Concurrency: " << Kokkos::DefaultExecutionSpace::concurrency() << std::endl;
 
+#if TIME_PHASES
+        TFEM::Instrumentation::enable();
+#endif
+
         // Verify that we can read a mesh properly. Assume the file path is located as
         // the first arg (after program name)
-        TFEM::DeviceMesh device_mesh;
-        TFEM::DeviceMesh::HostMirrorMesh host_mesh;
+#if SOA_MESH
+        using MeshT = TFEM::DeviceSoAMesh;
+#else
+        using MeshT = TFEM::DeviceMesh;
+#endif
+        MeshT device_mesh;
+        MeshT::HostMirrorMesh host_mesh;
         bool fuzz = false;
-        TFEM::load_meshes_from_grd_file(argv[1], device_mesh, host_mesh, fuzz);
+        TFEM::load_meshes_from_file(argv[1], device_mesh, host_mesh, fuzz);
+
+        // Optionally renumber the mesh for locality. Output is still written in the file's point order.
+        bool reorder = false;
+        TFEM::MeshPermutation permutation;
+        if (reorder)
+        {
+            permutation = TFEM::reorder_mesh(device_mesh, host_mesh, TFEM::MeshOrdering::ReverseCuthillMcKee);
+        }
 
         // Analytic solution and output writer
         // Create an analytical solution to test against
         double k = 1E-2;
-        double dt = 1E-5;
+        // Let the solver pick the largest stable time step for the mesh
+        double dt = 0;
         std::vector<TFEM::Analytical::Term> terms;
         terms.push_back({1.0, 1, 1});
         terms.push_back({2.0, 1, 3});
         TFEM::Analytical::ZeroBoundary<> analytical(k, -1.0, 2.0, -1.0, 2.0, terms);
 
-// Depending on macros, either create a coloring-based or atomic-based solver.
-#if SCATTER_ALGO == COLOR
-        // Find element coloring.
-        TFEM::MeshColorMap coloring(device_mesh);
-
-        // Print coloring debug info, since it's nondeterministic and affects runtime
-        std::cout << "Colored into " << coloring.color_count() << " partitions" << std::endl;
-        std::cout << "Sizes:";
-        for (int color = 0; color < coloring.color_count(); color++)
-        {
-            std::cout << " " << coloring.member_count(color);
-            assert(coloring.color_member_ids_host(color).extent(0) == coloring.member_count(color));
-        }
-        std::cout << std::endl;
-
-        TFEM::ColoredElementScatterAdd scatter_pattern(coloring);
-
-        TFEM::Solver<TFEM::ColoredElementScatterAdd> solver(device_mesh, scatter_pattern, analytical, dt, k);
-#elif SCATTER_ALGO == ATOMIC
-        TFEM::AtomicElementScatterAdd scatter_pattern(device_mesh);
+        // The scatter algorithm is the optional second argument (Atomic, Colored, Serial or
+        // Gather). By default it is picked by timing each one for a few steps; the choice is
+        // cached per mesh and device in tfem_autotune.cache.
+        std::string algorithm = argc > 2 ? argv[2] : "auto";
+        TFEM::BasicAnySolver<MeshT> solver = algorithm == "auto"
+                                                 ? TFEM::BasicAnySolver<MeshT>::autotune(device_mesh, analytical, dt, k)
+                                                 : TFEM::BasicAnySolver<MeshT>::create(TFEM::parse_pattern_kind(algorithm), device_mesh, analytical, dt, k);
+        std::cout << "Scatter algorithm: " << TFEM::pattern_kind_name(solver.pattern_kind()) << std::endl;
+        std::cout << "Time step: " << solver.timestep() << std::endl;
 
-        TFEM::Solver<TFEM::AtomicElementScatterAdd> solver(device_mesh, scatter_pattern, analytical, dt, k);
-#elif SCATTER_ALGO == SERIAL
-        TFEM::SerialElementScatterAdd scatter_pattern(device_mesh);
+        // An autotuned solver carries on from its trial steps, so the run does not start at t = 0
+        std::cout << "Start time: " << solver.time() << std::endl;
 
-        TFEM::Solver<TFEM::SerialElementScatterAdd> solver(device_mesh, scatter_pattern, analytical, dt, k);
-#endif // end of use_color if-else
-
-        // Initialize writer
-        TFEM::SolutionWriter writer("out/slices.json", host_mesh);
-        auto point_weight_mirror = Kokkos::create_mirror(solver.current_point_weights);
-        Kokkos::deep_copy(point_weight_mirror, solver.current_point_weights);
-        writer.add_slice(point_weight_mirror);
-        Kokkos::fence();
+        // Initialize writer. Slices are written in the background; convert them to JSON for the
+        // visualization scripts with snapshot_convert.
+        TFEM::AsyncSnapshotWriter writer("out/slices.tfs", host_mesh, permutation);
+        writer.add_slice(solver.current_point_weights(), solver.time(), solver.execution_space());
 
         std::cout << "Starting simulation" << std::endl;
 
@@ -81,19 +85,17 @@ int main(int argc, char *argv[])
         for (int i = 0; i < 10; i++)
         {
             solver.simulate_steps(1000);
-            Kokkos::deep_copy(point_weight_mirror, solver.current_point_weights);
-            Kokkos::fence();
+            writer.add_slice(solver.current_point_weights(), solver.time(), solver.execution_space());
             std::cout << "Root mean square error: " << sqrt(solver.measure_error()) << std::endl;
-
-            writer.add_slice(point_weight_mirror);
-            Kokkos::fence();
         }
 
         double stop_time = timer.seconds();
-
-        Kokkos::deep_copy(point_weight_mirror, solver.current_point_weights);
+        writer.flush();
 
         std::cout << "10000 step time (s): " << (stop_time - start_time) << std::endl;
+#if TIME_PHASES
+        TFEM::Instrumentation::write_json("out/instrumentation.json");
+#endif
     }
     Kokkos::finalize();
 }
@@ -0,0 +1,30 @@
+#include <iostream>
+
+#include <Kokkos_Core.hpp>
+#include <mesh.hpp>
+
+/**
+ * Converts a .grd text mesh to the binary mesh format, so that later runs can skip
+ * the text parser entirely.
+ *
+ * Usage: mesh_convert <input.grd> <output.tfm>
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input.grd> <output.tfm>" << std::endl;
+        return 1;
+    }
+    Kokkos::initialize(argc, argv);
+    {
+        TFEM::DeviceMesh device_mesh;
+        TFEM::DeviceMesh::HostMirrorMesh host_mesh;
+        TFEM::load_meshes_from_grd_file(argv[1], device_mesh, host_mesh);
+        TFEM::save_mesh_to_binary_file(argv[2], host_mesh);
+
+        std::cout << "Wrote " << host_mesh.point_count() << " points, " << host_mesh.edge_count() << " edges and "
+                  << host_mesh.region_count() << " regions to " << argv[2] << std::endl;
+    }
+    Kokkos::finalize();
+}
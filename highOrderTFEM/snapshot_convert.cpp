@@ -0,0 +1,20 @@
+#include <iostream>
+
+#include <snapshot.hpp>
+
+/**
+ * Converts a binary snapshot file written by AsyncSnapshotWriter to the JSON slice format read by
+ * the visualization scripts.
+ *
+ * Usage: snapshot_convert <input.tfs> <output.json>
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input.tfs> <output.json>" << std::endl;
+        return 1;
+    }
+    TFEM::snapshot_to_json(argv[1], argv[2]);
+    std::cout << "Wrote " << argv[2] << std::endl;
+}
@@ -0,0 +1,219 @@
+#include <Kokkos_Core.hpp>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include "mesh.hpp"
+#include "solver.hpp"
+#include "any_solver.hpp"
+#include "scatter_pattern.hpp"
+
+using namespace TFEM;
+
+namespace
+{
+    /**
+     * The Concept implementation for one pattern: forwards to a Solver<Pattern>.
+     */
+    template <class MeshT, typename ScatterPattern>
+    struct SolverModel : BasicAnySolver<MeshT>::Concept
+    {
+        Solver<ScatterPattern> solver;
+
+        SolverModel(MeshT mesh, ScatterPattern pattern, Analytical::PolynomialBoundary<> boundary_conditions, double timestep, double k, SolverOptions options)
+            : solver(mesh, pattern, boundary_conditions, timestep, k, options)
+        { // Pretty much just the initializer list
+        }
+
+        void simulate_steps(int n_steps) override { solver.simulate_steps(n_steps); }
+        double measure_error() override { return solver.measure_error(); }
+        double time() override { return solver.time(); }
+        double timestep() override { return solver.timestep(); }
+        typename BasicAnySolver<MeshT>::PointWeightBuffer current_point_weights() override { return solver.current_point_weights; }
+        Kokkos::DefaultExecutionSpace execution_space() override { return solver.execution_space(); }
+    };
+
+    bool is_supported(PatternKind kind, const SolverOptions &options)
+    {
+        if (kind != PatternKind::Serial)
+        {
+            return true;
+        }
+        // The serial pattern runs on the host, straight on the mesh views, and cannot be recorded as a graph
+        return Kokkos::SpaceAccessibility<Kokkos::HostSpace, Kokkos::DefaultExecutionSpace::memory_space>::accessible &&
+               options.step_mode != StepMode::Graph;
+    }
+
+    std::string device_key()
+    {
+        return std::string(Kokkos::DefaultExecutionSpace::name()) + "/" + std::to_string(Kokkos::DefaultExecutionSpace().concurrency());
+    }
+
+    /**
+     * The solver settings the timings depend on, as one token: step mode, mesh point and state
+     * precision, and whether element geometry is cached (e.g. "0/f64/f64/0").
+     */
+    template <class MeshT>
+    std::string solver_key(const SolverOptions &options)
+    {
+        using StateScalar = typename BasicAnySolver<MeshT>::PointWeightBuffer::non_const_value_type;
+        return std::to_string(static_cast<int>(options.step_mode)) +
+               "/f" + std::to_string(8 * sizeof(typename MeshT::Scalar)) +
+               "/f" + std::to_string(8 * sizeof(StateScalar)) +
+               "/" + (options.cache_element_geometry ? "1" : "0");
+    }
+
+    /**
+     * Cache lines are "<mesh hash> <device> <solver key> <pattern> <seconds per step>". The last
+     * matching line wins.
+     */
+    std::optional<PatternKind> find_cached(const std::string &fname, uint64_t mesh_hash, const std::string &device, const std::string &solver)
+    {
+        std::optional<PatternKind> found;
+        std::ifstream in(fname);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            uint64_t hash;
+            std::string line_device;
+            std::string line_solver;
+            std::string pattern;
+            if (!(fields >> hash >> line_device >> line_solver >> pattern))
+            {
+                continue;
+            }
+            if (hash == mesh_hash && line_device == device && line_solver == solver)
+            {
+                try
+                {
+                    found = parse_pattern_kind(pattern);
+                }
+                catch (std::invalid_argument &)
+                {
+                    // Written by a build with other patterns; ignore it
+                }
+            }
+        }
+        return found;
+    }
+}
+
+std::string TFEM::pattern_kind_name(PatternKind kind)
+{
+    switch (kind)
+    {
+    case PatternKind::Atomic:
+        return "Atomic";
+    case PatternKind::Colored:
+        return "Colored";
+    case PatternKind::Serial:
+        return "Serial";
+    case PatternKind::Gather:
+        return "Gather";
+    }
+    return "Unknown";
+}
+
+PatternKind TFEM::parse_pattern_kind(std::string name)
+{
+    for (PatternKind kind : {PatternKind::Atomic, PatternKind::Colored, PatternKind::Serial, PatternKind::Gather})
+    {
+        if (pattern_kind_name(kind) == name)
+        {
+            return kind;
+        }
+    }
+    throw std::invalid_argument("Unknown scatter pattern " + name);
+}
+
+template <class MeshT>
+BasicAnySolver<MeshT>::BasicAnySolver(std::unique_ptr<Concept> solver, PatternKind kind)
+    : solver(std::move(solver)), kind(kind)
+{ // Pretty much just the initializer list
+}
+
+template <class MeshT>
+BasicAnySolver<MeshT> BasicAnySolver<MeshT>::create(PatternKind kind, MeshT mesh, Analytical::PolynomialBoundary<> boundary_conditions, double timestep, double k, SolverOptions options)
+{
+    if (!is_supported(kind, options))
+    {
+        throw std::invalid_argument("Scatter pattern " + pattern_kind_name(kind) + " cannot run with this execution space or step mode");
+    }
+    std::unique_ptr<Concept> solver;
+    switch (kind)
+    {
+    case PatternKind::Atomic:
+        solver = std::make_unique<SolverModel<MeshT, BasicAtomicElementScatterAdd<MeshT>>>(mesh, BasicAtomicElementScatterAdd<MeshT>(mesh), boundary_conditions, timestep, k, options);
+        break;
+    case PatternKind::Colored:
+        solver = std::make_unique<SolverModel<MeshT, BasicColoredElementScatterAdd<MeshT>>>(mesh, BasicColoredElementScatterAdd<MeshT>(BasicMeshColorMap<MeshT>(mesh)), boundary_conditions, timestep, k, options);
+        break;
+    case PatternKind::Serial:
+        solver = std::make_unique<SolverModel<MeshT, BasicSerialElementScatterAdd<MeshT>>>(mesh, BasicSerialElementScatterAdd<MeshT>(mesh), boundary_conditions, timestep, k, options);
+        break;
+    case PatternKind::Gather:
+        solver = std::make_unique<SolverModel<MeshT, BasicGatherElementScatterAdd<MeshT>>>(mesh, BasicGatherElementScatterAdd<MeshT>(mesh), boundary_conditions, timestep, k, options);
+        break;
+    }
+    return BasicAnySolver(std::move(solver), kind);
+}
+
+template <class MeshT>
+BasicAnySolver<MeshT> BasicAnySolver<MeshT>::autotune(MeshT mesh, Analytical::PolynomialBoundary<> boundary_conditions, double timestep, double k, SolverOptions options, AutotuneOptions autotune_options)
+{
+    uint64_t mesh_hash = mesh_connectivity_hash(mesh);
+    std::string device = device_key();
+    std::string solver = solver_key<MeshT>(options);
+    if (!autotune_options.cache_file.empty())
+    {
+        auto cached = find_cached(autotune_options.cache_file, mesh_hash, device, solver);
+        if (cached && is_supported(*cached, options))
+        {
+            return create(*cached, mesh, boundary_conditions, timestep, k, options);
+        }
+    }
+
+    // Every candidate starts from the initial conditions and runs the same steps, so whichever
+    // wins can carry on from where its trial left off.
+    std::unique_ptr<Concept> best;
+    PatternKind best_kind = PatternKind::Atomic;
+    double best_seconds = std::numeric_limits<double>::infinity();
+    for (PatternKind kind : autotune_options.candidates)
+    {
+        if (!is_supported(kind, options))
+        {
+            continue;
+        }
+        BasicAnySolver candidate = create(kind, mesh, boundary_conditions, timestep, k, options);
+        candidate.simulate_steps(autotune_options.warmup_steps);
+        Kokkos::fence();
+        Kokkos::Timer timer;
+        candidate.simulate_steps(autotune_options.trial_steps);
+        Kokkos::fence();
+        double seconds = timer.seconds() / std::max(autotune_options.trial_steps, 1);
+        if (seconds < best_seconds)
+        {
+            best_seconds = seconds;
+            best_kind = kind;
+            best = std::move(candidate.solver);
+        }
+    }
+    if (!best)
+    {
+        throw std::invalid_argument("autotune: none of the candidate scatter patterns can run here");
+    }
+
+    if (!autotune_options.cache_file.empty())
+    {
+        std::ofstream out(autotune_options.cache_file, std::ios::app);
+        out << mesh_hash << " " << device << " " << solver << " " << pattern_kind_name(best_kind) << " " << best_seconds << std::endl;
+    }
+    return BasicAnySolver(std::move(best), best_kind);
+}
+
+// We need to specify what classes we might be using so the linker doesn't get mad
+template class TFEM::BasicAnySolver<DeviceMesh>;
+template class TFEM::BasicAnySolver<DeviceSoAMesh>;
@@ -0,0 +1,191 @@
+#include "checkpoint.hpp"
+#include "mesh.hpp"
+#include "instrumentation.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace TFEM;
+
+namespace
+{
+    uint64_t align_up(uint64_t offset)
+    {
+        return (offset + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+    }
+}
+
+uint64_t TFEM::checkpoint_order_hash(const int *ids, int64_t n)
+{
+    uint64_t hash = 14695981039346656037ull; // FNV offset basis
+    for (int64_t i = 0; i < n; i++)
+    {
+        for (int byte = 0; byte < 4; byte++)
+        {
+            hash ^= (ids[i] >> (8 * byte)) & 0xff;
+            hash *= 1099511628211ull; // FNV prime
+        }
+    }
+    return hash;
+}
+
+void CheckpointImpl::layout_sections(CheckpointHeader &header)
+{
+    uint64_t offset = align_up(sizeof(CheckpointHeader));
+    for (int s = 0; s < N_CHECKPOINT_SECTIONS; s++)
+    {
+        header.section_offsets[s] = offset;
+        offset = align_up(offset + header.section_bytes[s]);
+    }
+}
+
+CheckpointImpl::Writer::Writer(std::string fname, CheckpointHeader header)
+    : out_file(fname, std::ios::binary), fname(fname), header(header), written(0)
+{
+    if (!out_file)
+    {
+        throw std::runtime_error("Could not open " + fname + " for writing");
+    }
+    memcpy(this->header.tag, CHECKPOINT_FILE_TAG, sizeof(CHECKPOINT_FILE_TAG));
+    this->header.version = CHECKPOINT_FILE_VERSION;
+    this->header.header_bytes = sizeof(CheckpointHeader);
+    layout_sections(this->header);
+    out_file.write(reinterpret_cast<const char *>(&this->header), sizeof(CheckpointHeader));
+    written = sizeof(CheckpointHeader);
+}
+
+void CheckpointImpl::Writer::write_section(int section, const void *data)
+{
+    if (header.section_offsets[section] < written)
+    {
+        throw std::logic_error("Checkpoint sections must be written in order");
+    }
+    // Padding is skipped over rather than written; it reads back as zeros
+    out_file.seekp(header.section_offsets[section]);
+    out_file.write(static_cast<const char *>(data), header.section_bytes[section]);
+    written = header.section_offsets[section] + header.section_bytes[section];
+}
+
+std::ostream &CheckpointImpl::Writer::begin_mesh_section()
+{
+    if (header.section_offsets[CHECKPOINT_MESH] < written)
+    {
+        throw std::logic_error("Checkpoint sections must be written in order");
+    }
+    out_file.seekp(header.section_offsets[CHECKPOINT_MESH]);
+    written = header.section_offsets[CHECKPOINT_MESH];
+    return out_file;
+}
+
+void CheckpointImpl::Writer::close()
+{
+    uint64_t end = out_file.tellp();
+    if (end > header.section_offsets[CHECKPOINT_MESH])
+    {
+        // The mesh is the last section, so its size is wherever the stream ended up
+        header.section_bytes[CHECKPOINT_MESH] = end - header.section_offsets[CHECKPOINT_MESH];
+        out_file.seekp(0);
+        out_file.write(reinterpret_cast<const char *>(&header), sizeof(CheckpointHeader));
+    }
+    out_file.close();
+    if (!out_file)
+    {
+        throw std::runtime_error("Failed while writing checkpoint " + fname);
+    }
+}
+
+CheckpointImpl::Reader::Reader(std::string fname)
+    : in_file(fname, std::ios::binary), fname(fname)
+{
+    if (!in_file)
+    {
+        throw std::runtime_error("Could not open checkpoint " + fname);
+    }
+    in_file.read(reinterpret_cast<char *>(&header), sizeof(CheckpointHeader));
+    if (!in_file || memcmp(header.tag, CHECKPOINT_FILE_TAG, sizeof(CHECKPOINT_FILE_TAG)) != 0)
+    {
+        throw std::runtime_error("File " + fname + " is not a checkpoint");
+    }
+    if (header.version != CHECKPOINT_FILE_VERSION || header.header_bytes != sizeof(CheckpointHeader))
+    {
+        throw std::runtime_error("Checkpoint " + fname + " has unsupported version " + std::to_string(header.version));
+    }
+
+    // Validate the layout before trusting any of the offsets
+    in_file.seekg(0, std::ios::end);
+    uint64_t file_size = in_file.tellg();
+    CheckpointHeader expected_layout = header;
+    layout_sections(expected_layout);
+    for (int s = 0; s < N_CHECKPOINT_SECTIONS; s++)
+    {
+        if (header.section_offsets[s] != expected_layout.section_offsets[s] ||
+            (header.section_bytes[s] > 0 && header.section_offsets[s] + header.section_bytes[s] > file_size))
+        {
+            throw std::runtime_error("Checkpoint " + fname + " is truncated or corrupt (section " + std::to_string(s) + ")");
+        }
+    }
+}
+
+void CheckpointImpl::Reader::read_section(int section, void *dest)
+{
+    in_file.seekg(header.section_offsets[section]);
+    in_file.read(static_cast<char *>(dest), header.section_bytes[section]);
+    if (!in_file)
+    {
+        throw std::runtime_error("Failed reading section " + std::to_string(section) + " of checkpoint " + fname);
+    }
+}
+
+CheckpointHeader TFEM::read_checkpoint_header(std::string fname)
+{
+    return CheckpointImpl::Reader(fname).file_header();
+}
+
+template <class MeshT>
+void TFEM::load_mesh_from_checkpoint(std::string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh)
+{
+    CheckpointHeader header = read_checkpoint_header(fname);
+    if (header.section_bytes[CHECKPOINT_MESH] == 0)
+    {
+        throw std::runtime_error("Checkpoint " + fname + " does not contain a mesh");
+    }
+    load_meshes_from_binary_file(fname, device_mesh, host_mesh, false, header.section_offsets[CHECKPOINT_MESH]);
+}
+
+template <class MeshT>
+BasicMeshColorMap<MeshT> TFEM::load_coloring_from_checkpoint(std::string fname, MeshT &mesh)
+{
+    ScopedPhase phase("load_coloring_from_checkpoint");
+    CheckpointImpl::Reader reader(fname);
+    const CheckpointHeader &header = reader.file_header();
+    if (!reader.has_section(CHECKPOINT_COLOR_MEMBERS))
+    {
+        throw std::runtime_error("Checkpoint " + fname + " does not contain a coloring");
+    }
+    if (header.n_regions != mesh.region_count() || header.mesh_hash != mesh_connectivity_hash(mesh))
+    {
+        throw std::runtime_error("Checkpoint " + fname + " was written for a different mesh");
+    }
+    std::vector<int32_t> color_starts(header.n_colors + 1);
+    std::vector<int32_t> member_ids(header.n_regions);
+    if (header.section_bytes[CHECKPOINT_COLOR_STARTS] != color_starts.size() * sizeof(int32_t) ||
+        header.section_bytes[CHECKPOINT_COLOR_MEMBERS] != member_ids.size() * sizeof(int32_t))
+    {
+        throw std::runtime_error("Checkpoint " + fname + " has a malformed coloring");
+    }
+    reader.read_section(CHECKPOINT_COLOR_STARTS, color_starts.data());
+    reader.read_section(CHECKPOINT_COLOR_MEMBERS, member_ids.data());
+    return BasicMeshColorMap<MeshT>(mesh, color_starts, member_ids);
+}
+
+// We need to specify what classes we might be using so the linker doesn't get mad
+template void TFEM::load_mesh_from_checkpoint<DeviceMesh>(std::string, DeviceMesh &, DeviceMesh::HostMirrorMesh &);
+template void TFEM::load_mesh_from_checkpoint<DeviceSoAMesh>(std::string, DeviceSoAMesh &, DeviceSoAMesh::HostMirrorMesh &);
+template BasicMeshColorMap<DeviceMesh> TFEM::load_coloring_from_checkpoint<DeviceMesh>(std::string, DeviceMesh &);
+template BasicMeshColorMap<DeviceSoAMesh> TFEM::load_coloring_from_checkpoint<DeviceSoAMesh>(std::string, DeviceSoAMesh &);
+template BasicMeshColorMap<DeviceFloatMesh> TFEM::load_coloring_from_checkpoint<DeviceFloatMesh>(std::string, DeviceFloatMesh &);
+template BasicMeshColorMap<DeviceSoAFloatMesh> TFEM::load_coloring_from_checkpoint<DeviceSoAFloatMesh>(std::string, DeviceSoAFloatMesh &);
+template BasicMeshColorMap<DeviceCompactMesh> TFEM::load_coloring_from_checkpoint<DeviceCompactMesh>(std::string, DeviceCompactMesh &);
+template BasicMeshColorMap<DeviceCompactFloatMesh> TFEM::load_coloring_from_checkpoint<DeviceCompactFloatMesh>(std::string, DeviceCompactFloatMesh &);
+template BasicMeshColorMap<DeviceUInt32Mesh> TFEM::load_coloring_from_checkpoint<DeviceUInt32Mesh>(std::string, DeviceUInt32Mesh &);
@@ -0,0 +1,235 @@
+#include <Kokkos_Core.hpp>
+#include <mpi.h>
+#include <stdexcept>
+#include "mesh.hpp"
+#include "distributed.hpp"
+#include "linear_element.hpp"
+#include "analytical.hpp"
+#include "scatter_pattern.hpp"
+
+using namespace TFEM;
+
+template <typename ScatterPattern>
+DistributedSolver<ScatterPattern>::DistributedSolver(MeshPart<MeshT> part, Analytical::ZeroBoundary<> boundary_conditions, double timestep, double k, MPI_Comm comm)
+    : mesh(part.mesh),
+      interface_mesh(part.mesh.with_region_range(0, part.n_interface_regions)),
+      interior_mesh(part.mesh.with_region_range(part.n_interface_regions, part.mesh.region_count())),
+      interface_pattern(interface_mesh),
+      interior_pattern(interior_mesh),
+      comm(comm),
+      neighbors(part.neighbors),
+      boundary(boundary_conditions),
+      dt(timestep),
+      k(k),
+      n_total_steps(0)
+{
+    int n_ranks;
+    MPI_Comm_size(comm, &n_ranks);
+    if (n_ranks != part.n_parts)
+    {
+        throw std::runtime_error("DistributedSolver: mesh has " + std::to_string(part.n_parts) + " parts but the communicator has " + std::to_string(n_ranks) + " ranks");
+    }
+
+    current_point_weights = PointWeightBuffer("Current Point Weights", mesh.point_count());
+    prev_point_weights = PointWeightBuffer("Prev Point Weights", mesh.point_count());
+    point_mass_inv = InvMassMatrix("Inverse Point Masses", mesh.point_count());
+    // The readonly views share memory with the writable ones
+    prev_point_weights_readonly = prev_point_weights;
+    point_mass_inv_readonly = point_mass_inv;
+
+    // Halo lists and ownership come from the host side of the part
+    int n_halo = part.shared_points.extent(0);
+    halo_offsets.assign(part.shared_offsets.data(), part.shared_offsets.data() + part.shared_offsets.extent(0));
+    halo_points = Kokkos::View<int *>("Halo points", n_halo);
+    auto halo_points_host = Kokkos::create_mirror_view(halo_points);
+    for (int i = 0; i < n_halo; i++)
+    {
+        halo_points_host(i) = part.shared_points(i);
+    }
+    Kokkos::deep_copy(halo_points, halo_points_host);
+    send_buffer = Kokkos::View<double *>("Halo send buffer", n_halo);
+    recv_buffer = Kokkos::View<double *>("Halo receive buffer", n_halo);
+    send_buffer_host = Kokkos::create_mirror_view(send_buffer);
+    recv_buffer_host = Kokkos::create_mirror_view(recv_buffer);
+    requests.resize(2 * neighbors.size());
+
+    owned_points = Kokkos::View<bool *>("Owned points", mesh.point_count());
+    auto owned_points_host = Kokkos::create_mirror_view(owned_points);
+    long long n_owned_interior = 0;
+    for (int p = 0; p < mesh.point_count(); p++)
+    {
+        owned_points_host(p) = part.owned_points(p);
+        n_owned_interior += part.owned_points(p) && !part.host_mesh.boundary_points(p);
+    }
+    Kokkos::deep_copy(owned_points, owned_points_host);
+    MPI_Allreduce(&n_owned_interior, &n_global_interior_points, 1, MPI_LONG_LONG, MPI_SUM, comm);
+
+    setup_mass_matrix();
+    setup_initial_conditions();
+    Kokkos::fence();
+}
+
+template <typename ScatterPattern>
+void DistributedSolver<ScatterPattern>::setup_mass_matrix()
+{
+    auto point_mass_inv = this->point_mass_inv;
+    auto boundary_points = mesh.boundary_points;
+
+    DistributedImpl::MassMatrixFunctor<ScatterPattern> interface_functor(point_mass_inv, interface_mesh);
+    interface_pattern.distribute_work(interface_functor);
+    start_halo_sum(point_mass_inv);
+    DistributedImpl::MassMatrixFunctor<ScatterPattern> interior_functor(point_mass_inv, interior_mesh);
+    interior_pattern.distribute_work(interior_functor);
+    finish_halo_sum(point_mass_inv);
+
+    // Invert, and zero the boundary points so the step never changes them
+    Kokkos::parallel_for(mesh.point_count(), KOKKOS_LAMBDA(int i) {
+        point_mass_inv(i) = boundary_points(i) ? 0 : 1 / point_mass_inv(i); });
+    Kokkos::fence();
+}
+
+template <typename ScatterPattern>
+void DistributedSolver<ScatterPattern>::setup_initial_conditions()
+{
+    auto current_points = this->current_point_weights;
+    auto mesh = this->mesh;
+    auto boundary = this->boundary;
+    Kokkos::parallel_for(mesh.point_count(), KOKKOS_LAMBDA(int i) {
+        Point p = mesh.point(i);
+        current_points(i) = boundary(p[0], p[1], 0); });
+}
+
+template <typename ScatterPattern>
+void DistributedSolver<ScatterPattern>::start_halo_sum(Kokkos::View<double *> values)
+{
+    auto halo_points = this->halo_points;
+    auto send_buffer = this->send_buffer;
+    Kokkos::parallel_for(halo_points.extent(0), KOKKOS_LAMBDA(int i) { send_buffer(i) = values(halo_points(i)); });
+    // MPI can only start reading once the pack has finished
+    Kokkos::fence();
+
+#ifdef TFEM_GPU_AWARE_MPI
+    double *send_data = send_buffer.data();
+    double *recv_data = recv_buffer.data();
+#else
+    Kokkos::deep_copy(send_buffer_host, send_buffer);
+    double *send_data = send_buffer_host.data();
+    double *recv_data = recv_buffer_host.data();
+#endif
+    for (size_t n = 0; n < neighbors.size(); n++)
+    {
+        int count = halo_offsets[n + 1] - halo_offsets[n];
+        MPI_Irecv(recv_data + halo_offsets[n], count, MPI_DOUBLE, neighbors[n], 0, comm, &requests[2 * n]);
+        MPI_Isend(send_data + halo_offsets[n], count, MPI_DOUBLE, neighbors[n], 0, comm, &requests[2 * n + 1]);
+    }
+}
+
+template <typename ScatterPattern>
+void DistributedSolver<ScatterPattern>::finish_halo_sum(Kokkos::View<double *> values)
+{
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+#ifndef TFEM_GPU_AWARE_MPI
+    Kokkos::deep_copy(recv_buffer, recv_buffer_host);
+#endif
+
+    // A point shared with several neighbors appears once per neighbor, so the adds may collide
+    auto halo_points = this->halo_points;
+    auto recv_buffer = this->recv_buffer;
+    Kokkos::parallel_for(halo_points.extent(0), KOKKOS_LAMBDA(int i) { Kokkos::atomic_add(&values(halo_points(i)), recv_buffer(i)); });
+}
+
+template <typename ScatterPattern>
+void DistributedSolver<ScatterPattern>::simulate_steps(int n_steps)
+{
+    for (int i = 0; i < n_steps; i++)
+    {
+        n_total_steps++;
+        std::swap(current_point_weights, prev_point_weights);
+        prev_point_weights_readonly = prev_point_weights;
+        Kokkos::deep_copy(current_point_weights, 0.0);
+        compute_step();
+    }
+    Kokkos::fence();
+}
+
+template <typename ScatterPattern>
+void DistributedSolver<ScatterPattern>::compute_step()
+{
+    // The shared points only receive from the interface elements, so their local sums are complete
+    // once those are done, and the exchange can overlap the interior elements.
+    DistributedImpl::ElementContributionFunctor<ScatterPattern> interface_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, interface_mesh, -k * dt);
+    interface_pattern.distribute_work(interface_functor);
+    start_halo_sum(current_point_weights);
+
+    DistributedImpl::ElementContributionFunctor<ScatterPattern> interior_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, interior_mesh, -k * dt);
+    interior_pattern.distribute_work(interior_functor);
+    finish_halo_sum(current_point_weights);
+}
+
+template <typename ScatterPattern>
+double DistributedSolver<ScatterPattern>::measure_error()
+{
+    double t = time();
+    auto mesh = this->mesh;
+    auto current_points = this->current_point_weights;
+    auto owned_points = this->owned_points;
+    auto analytic = this->boundary;
+    double local_result = 0;
+    Kokkos::parallel_reduce(mesh.point_count(), KOKKOS_LAMBDA(int i, double &err_sum) {
+        if (owned_points(i) && !mesh.boundary_points(i)) {
+            Point p = mesh.point(i);
+            double analytic_value = analytic(p[0], p[1], t);
+            err_sum += pow(analytic_value - current_points(i), 2);
+        } }, local_result);
+
+    double global_result;
+    MPI_Allreduce(&local_result, &global_result, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return global_result / n_global_interior_points;
+}
+
+template <typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void DistributedImpl::MassMatrixFunctor<ScatterPattern>::operator()(Region element, int) const
+{
+    Point pts[3];
+    for (int j = 0; j < 3; j++)
+    {
+        pts[j] = mesh.point(element[j]);
+    }
+    double c = lumped_mass_contribution(det_jacobian(pts));
+    for (int j = 0; j < 3; j++)
+    {
+        ScatterPattern::contribute(&inv_mass(element[j]), c);
+    }
+}
+
+template <typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void DistributedImpl::ElementContributionFunctor<ScatterPattern>::operator()(Region element, int) const
+{
+    Point pts[3];
+    double u[3];
+    for (int j = 0; j < 3; j++)
+    {
+        pts[j] = mesh.point(element[j]);
+        u[j] = prev_points(element[j]);
+    }
+    double stiffness[6];
+    local_stiffness(pts, scale, stiffness);
+    double mass = lumped_mass_contribution(det_jacobian(pts));
+    for (int j = 0; j < 3; j++)
+    {
+        double c = mass * u[j];
+        for (int i = 0; i < 3; i++)
+        {
+            c += stiffness[packed_index(j, i)] * u[i];
+        }
+        ScatterPattern::contribute(&new_points(element[j]), inv_mass(element[j]) * c);
+    }
+}
+
+// We need to specify what classes we might be using so the linker doesn't get mad
+template class TFEM::DistributedSolver<ColoredElementScatterAdd>;
+template class TFEM::DistributedSolver<AtomicElementScatterAdd>;
+template class TFEM::DistributedSolver<GatherElementScatterAdd>;
+template class TFEM::DistributedSolver<SoAColoredElementScatterAdd>;
+template class TFEM::DistributedSolver<SoAAtomicElementScatterAdd>;
+template class TFEM::DistributedSolver<SoAGatherElementScatterAdd>;
@@ -0,0 +1,186 @@
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+#include "ensemble.hpp"
+#include "linear_element.hpp"
+#include "analytical.hpp"
+#include "scatter_pattern.hpp"
+
+using namespace TFEM;
+
+template <typename ScatterPattern>
+EnsembleSolver<ScatterPattern>::EnsembleSolver(MeshT mesh, ScatterPattern pattern, std::vector<EnsembleMember> members, double timestep)
+    : mesh(mesh),
+      scatter_pattern(pattern),
+      members(members),
+      n_members(members.size()),
+      dt(timestep),
+      n_total_steps(0)
+{
+    current_point_weights = PointWeightBuffer("Current Ensemble Weights", mesh.point_count(), n_members);
+    prev_point_weights = PointWeightBuffer("Prev Ensemble Weights", mesh.point_count(), n_members);
+    point_mass_inv = InvMassMatrix("Inverse Point Masses", mesh.point_count());
+    // The readonly views share memory with the writable ones
+    prev_point_weights_readonly = prev_point_weights;
+    point_mass_inv_readonly = point_mass_inv;
+
+    Kokkos::View<double *> member_scales("Ensemble member scales", n_members);
+    auto member_scales_host = Kokkos::create_mirror_view(member_scales);
+    for (int m = 0; m < n_members; m++)
+    {
+        member_scales_host(m) = -members[m].k * dt;
+    }
+    Kokkos::deep_copy(member_scales, member_scales_host);
+    this->member_scales = member_scales;
+
+    setup_mass_matrix();
+    setup_initial_conditions();
+    Kokkos::fence();
+}
+
+template <typename ScatterPattern>
+void EnsembleSolver<ScatterPattern>::setup_mass_matrix()
+{
+    auto point_mass_inv = this->point_mass_inv;
+    auto boundary_points = mesh.boundary_points;
+
+    EnsembleImpl::MassMatrixFunctor<ScatterPattern> mass_functor(point_mass_inv, mesh);
+    scatter_pattern.distribute_work(mass_functor);
+
+    // Invert, and zero the boundary points so the step never changes them
+    Kokkos::parallel_for(mesh.point_count(), KOKKOS_LAMBDA(int i) {
+        point_mass_inv(i) = boundary_points(i) ? 0 : 1 / point_mass_inv(i); });
+    Kokkos::fence();
+}
+
+template <typename ScatterPattern>
+void EnsembleSolver<ScatterPattern>::setup_initial_conditions()
+{
+    auto current_points = this->current_point_weights;
+    auto mesh = this->mesh;
+
+    // Only done once, so one pass per member keeps each member's solution simple to evaluate
+    for (int m = 0; m < n_members; m++)
+    {
+        auto solution = members[m].solution;
+        Kokkos::parallel_for(mesh.point_count(), KOKKOS_LAMBDA(int i) {
+            Point point = mesh.point(i);
+            current_points(i, m) = solution(point[0], point[1], 0); });
+    }
+}
+
+template <typename ScatterPattern>
+void EnsembleSolver<ScatterPattern>::simulate_steps(int n_steps)
+{
+    for (int i = 0; i < n_steps; i++)
+    {
+        n_total_steps++;
+        swap_buffers();
+        compute_step();
+    }
+}
+
+template <typename ScatterPattern>
+void EnsembleSolver<ScatterPattern>::swap_buffers()
+{
+    std::swap(current_point_weights, prev_point_weights);
+    prev_point_weights_readonly = prev_point_weights;
+    Kokkos::deep_copy(current_point_weights, 0.0);
+}
+
+template <typename ScatterPattern>
+void EnsembleSolver<ScatterPattern>::compute_step()
+{
+    EnsembleImpl::ElementContributionFunctor<ScatterPattern> per_element_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, member_scales, mesh, n_members);
+    scatter_pattern.distribute_work(per_element_functor);
+}
+
+template <typename ScatterPattern>
+double EnsembleSolver<ScatterPattern>::measure_error(int member)
+{
+    double t = time();
+    auto current_points = this->current_point_weights;
+    auto analytic = members[member].solution;
+    auto mesh = this->mesh;
+    double interior_result = 0;
+    Kokkos::parallel_reduce(mesh.point_count(), KOKKOS_LAMBDA(int i, double &err_sum) {
+        if (!mesh.boundary_points(i)) {
+            Point point = mesh.point(i);
+            double analytic_value = analytic(point[0], point[1], t);
+            err_sum += pow(analytic_value - current_points(i, member), 2);
+        } }, interior_result);
+    return interior_result / (mesh.point_count() - mesh.n_boundary_points);
+}
+
+template <typename ScatterPattern>
+std::vector<double> EnsembleSolver<ScatterPattern>::measure_errors()
+{
+    std::vector<double> errors(n_members);
+    for (int m = 0; m < n_members; m++)
+    {
+        errors[m] = measure_error(m);
+    }
+    return errors;
+}
+
+template <typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void EnsembleImpl::MassMatrixFunctor<ScatterPattern>::operator()(Region element, int) const
+{
+    Point pts[3];
+    for (int j = 0; j < 3; j++)
+    {
+        pts[j] = mesh.point(element[j]);
+    }
+    double c = lumped_mass_contribution(det_jacobian(pts));
+    for (int j = 0; j < 3; j++)
+    {
+        ScatterPattern::contribute(&inv_mass(element[j]), c);
+    }
+}
+
+template <typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void EnsembleImpl::ElementContributionFunctor<ScatterPattern>::operator()(Region element, int) const
+{
+    // Everything that depends only on the mesh is loaded or computed once for all members
+    Point pts[3];
+    for (int j = 0; j < 3; j++)
+    {
+        pts[j] = mesh.point(element[j]);
+    }
+    double stiffness[6];
+    local_stiffness(pts, 1.0, stiffness);
+    double mass = lumped_mass_contribution(det_jacobian(pts));
+    double point_inv_mass[3];
+    for (int j = 0; j < 3; j++)
+    {
+        point_inv_mass[j] = inv_mass(element[j]);
+    }
+
+    // Consecutive members are consecutive in memory, so this loop reads and writes contiguous
+    // runs at each of the three points.
+    for (int m = 0; m < n_members; m++)
+    {
+        double scale = member_scales(m);
+        double u[3];
+        for (int j = 0; j < 3; j++)
+        {
+            u[j] = prev_points(element[j], m);
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            double c = mass * u[j];
+            for (int i = 0; i < 3; i++)
+            {
+                c += scale * stiffness[packed_index(j, i)] * u[i];
+            }
+            ScatterPattern::contribute(&new_points(element[j], m), point_inv_mass[j] * c);
+        }
+    }
+}
+
+// We need to specify what classes we might be using so the linker doesn't get mad
+template class TFEM::EnsembleSolver<ColoredElementScatterAdd>;
+template class TFEM::EnsembleSolver<AtomicElementScatterAdd>;
+template class TFEM::EnsembleSolver<SerialElementScatterAdd>;
+template class TFEM::EnsembleSolver<SoAColoredElementScatterAdd>;
+template class TFEM::EnsembleSolver<SoAAtomicElementScatterAdd>;
+template class TFEM::EnsembleSolver<SoASerialElementScatterAdd>;
@@ -0,0 +1,322 @@
+#include <Kokkos_Core.hpp>
+#include "mesh.hpp"
+#include "high_order.hpp"
+#include "analytical.hpp"
+#include "scatter_pattern.hpp"
+#include <stdexcept>
+
+using namespace TFEM;
+
+template <int P, typename ScatterPattern>
+HighOrderSolver<P, ScatterPattern>::HighOrderSolver(MeshT mesh, ScatterPattern pattern, Analytical::ZeroBoundary<> boundary_conditions, double timestep, double k)
+    : mesh(mesh),
+      scatter_pattern(pattern),
+      boundary(boundary_conditions),
+      n_dofs(0),
+      n_boundary_dofs(0),
+      dt(timestep),
+      k(k),
+      n_total_steps(0)
+{
+    setup_dofs();
+
+    current_dof_weights = DofWeightBuffer("Current DOF Weights", n_dofs);
+    prev_dof_weights = DofWeightBuffer("Prev DOF Weights", n_dofs);
+    dof_mass_inv = InvMassMatrix("Inverse DOF Masses", n_dofs);
+    // The readonly views share memory with the writable ones
+    prev_dof_weights_readonly = prev_dof_weights;
+    dof_mass_inv_readonly = dof_mass_inv;
+
+    setup_mass_matrix();
+    setup_initial_conditions();
+    Kokkos::fence();
+}
+
+template <int P, typename ScatterPattern>
+void HighOrderSolver<P, ScatterPattern>::setup_dofs()
+{
+    if (!this->mesh.has_edges())
+    {
+        throw std::invalid_argument("HighOrderSolver: the edge nodes need the mesh edges, which were released");
+    }
+    auto mesh = this->mesh;
+    int n_points = mesh.point_count();
+    int n_edges = mesh.edge_count();
+    constexpr int edge_nodes = Element::n_edge_nodes;
+    int edge_base = n_points;
+    n_dofs = n_points + n_edges * edge_nodes + mesh.region_count() * Element::n_interior_nodes;
+
+    // Edges touching each point, so elements can find their edges
+    Kokkos::View<int *> point_edge_offsets("Point edge offsets", n_points + 1);
+    Kokkos::View<int *> point_edges("Point edges", 2 * n_edges);
+    Kokkos::parallel_for(n_edges, KOKKOS_LAMBDA(int e) {
+        auto edge = mesh.edges(e);
+        Kokkos::atomic_add(&point_edge_offsets(edge[0] + 1), 1);
+        Kokkos::atomic_add(&point_edge_offsets(edge[1] + 1), 1); });
+    Kokkos::parallel_scan(n_points + 1, KOKKOS_LAMBDA(int i, int &partial, bool final) {
+        partial += point_edge_offsets(i);
+        if (final) {
+            point_edge_offsets(i) = partial;
+        } });
+    Kokkos::View<int *> fill("Point edge fill counts", n_points);
+    Kokkos::parallel_for(n_edges, KOKKOS_LAMBDA(int e) {
+        auto edge = mesh.edges(e);
+        for (int side = 0; side < 2; side++) {
+            int p = edge[side];
+            point_edges(point_edge_offsets(p) + Kokkos::atomic_fetch_add(&fill(p), 1)) = e;
+        } });
+
+    // Vertex and edge node positions
+    auto dof_coords = Kokkos::View<double *[2]>("DOF coordinates", n_dofs);
+    Kokkos::parallel_for(n_points, KOKKOS_LAMBDA(int p) {
+        Point point = mesh.point(p);
+        dof_coords(p, 0) = point[0];
+        dof_coords(p, 1) = point[1]; });
+    Kokkos::parallel_for(n_edges, KOKKOS_LAMBDA(int e) {
+        constexpr Element ref = build_reference_element<P>();
+        auto edge = mesh.edges(e);
+        Point start = mesh.point(edge[0]);
+        Point end = mesh.point(edge[1]);
+        for (int t = 0; t < edge_nodes; t++) {
+            for (int dim = 0; dim < 2; dim++) {
+                dof_coords(edge_base + e * edge_nodes + t, dim) = start[dim] + ref.edge_node_position[t] * (end[dim] - start[dim]);
+            }
+        } });
+
+    // Boundary nodes: the boundary points and the nodes of boundary edges
+    auto dof_boundary = Kokkos::View<bool *>("DOF boundary flags", n_dofs);
+    Kokkos::parallel_for(n_points, KOKKOS_LAMBDA(int p) { dof_boundary(p) = mesh.boundary_points(p); });
+    Kokkos::parallel_for(mesh.boundary_edge_count(), KOKKOS_LAMBDA(int i) {
+        int e = mesh.boundary_edges.entries(i);
+        for (int t = 1; t <= edge_nodes; t++) {
+            dof_boundary(edge_base + e * edge_nodes + t - 1) = true;
+        } });
+    Kokkos::parallel_reduce(n_dofs, KOKKOS_LAMBDA(int i, int &count) {
+        if (dof_boundary(i)) {
+            count++;
+        } }, n_boundary_dofs);
+
+    // Element node numbering (and interior node positions) in slot order
+    element_dofs = ElementDofMap("Element DOFs", mesh.region_count(), Element::n_nodes);
+    HighOrderImpl::ElementDofFunctor<P, ScatterPattern> dof_functor(element_dofs, dof_coords, point_edge_offsets, point_edges, mesh);
+    scatter_pattern.distribute_work(dof_functor);
+
+    this->dof_coords = dof_coords;
+    this->dof_boundary = dof_boundary;
+    Kokkos::fence();
+}
+
+template <int P, typename ScatterPattern>
+void HighOrderSolver<P, ScatterPattern>::setup_mass_matrix()
+{
+    auto dof_mass_inv = this->dof_mass_inv;
+    auto dof_boundary = this->dof_boundary;
+
+    HighOrderImpl::MassMatrixFunctor<P, ScatterPattern> mass_functor(dof_mass_inv, element_dofs, mesh);
+    scatter_pattern.distribute_work(mass_functor);
+
+    // Invert, and zero the boundary nodes so the step never changes them
+    Kokkos::parallel_for(n_dofs, KOKKOS_LAMBDA(int i) {
+        dof_mass_inv(i) = dof_boundary(i) ? 0 : 1 / dof_mass_inv(i); });
+    Kokkos::fence();
+}
+
+template <int P, typename ScatterPattern>
+void HighOrderSolver<P, ScatterPattern>::setup_initial_conditions()
+{
+    auto current_dofs = this->current_dof_weights;
+    auto dof_coords = this->dof_coords;
+    auto boundary = this->boundary;
+
+    Kokkos::parallel_for(n_dofs, KOKKOS_LAMBDA(int i) {
+        current_dofs(i) = boundary(dof_coords(i, 0), dof_coords(i, 1), 0); });
+}
+
+template <int P, typename ScatterPattern>
+void HighOrderSolver<P, ScatterPattern>::simulate_steps(int n_steps)
+{
+    for (int i = 0; i < n_steps; i++)
+    {
+        n_total_steps++;
+        swap_buffers();
+        compute_step();
+    }
+}
+
+template <int P, typename ScatterPattern>
+void HighOrderSolver<P, ScatterPattern>::swap_buffers()
+{
+    std::swap(current_dof_weights, prev_dof_weights);
+    prev_dof_weights_readonly = prev_dof_weights;
+    Kokkos::deep_copy(current_dof_weights, 0.0);
+}
+
+template <int P, typename ScatterPattern>
+void HighOrderSolver<P, ScatterPattern>::compute_step()
+{
+    HighOrderImpl::ElementContributionFunctor<P, ScatterPattern> per_element_functor(current_dof_weights, prev_dof_weights_readonly, dof_mass_inv_readonly, element_dofs, mesh, k, dt);
+    scatter_pattern.distribute_work(per_element_functor);
+}
+
+template <int P, typename ScatterPattern>
+double HighOrderSolver<P, ScatterPattern>::measure_error()
+{
+    double t = time();
+    auto current_dofs = this->current_dof_weights;
+    auto dof_coords = this->dof_coords;
+    auto dof_boundary = this->dof_boundary;
+    auto analytic = this->boundary;
+    double interior_result = 0;
+    Kokkos::parallel_reduce(n_dofs, KOKKOS_LAMBDA(int i, double &err_sum) {
+        if (!dof_boundary(i)) {
+            double analytic_value = analytic(dof_coords(i, 0), dof_coords(i, 1), t);
+            err_sum += pow(analytic_value - current_dofs(i), 2);
+        } }, interior_result);
+    return interior_result / (n_dofs - n_boundary_dofs);
+}
+
+/**
+ * Jacobian of the affine map from the reference triangle onto the element, returning |det J|
+ */
+KOKKOS_INLINE_FUNCTION double affine_jacobian(Point pts[3], double jacobian[2][2])
+{
+    for (int dim = 0; dim < 2; dim++)
+    {
+        jacobian[dim][0] = pts[1][dim] - pts[0][dim];
+        jacobian[dim][1] = pts[2][dim] - pts[0][dim];
+    }
+    return Kokkos::fabs(jacobian[0][0] * jacobian[1][1] - jacobian[0][1] * jacobian[1][0]);
+}
+
+template <int P, typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void HighOrderImpl::ElementDofFunctor<P, ScatterPattern>::operator()(Region element, int slot) const
+{
+    using Ref = ReferenceElement<P>;
+    constexpr Ref ref = build_reference_element<P>();
+    for (int v = 0; v < 3; v++)
+    {
+        element_dofs(slot, v) = element[v];
+    }
+
+    // Local edge k runs from vertex k to vertex k + 1, and may run either way along the mesh edge
+    for (int edge = 0; edge < 3; edge++)
+    {
+        pointID start = element[edge];
+        pointID end = element[(edge + 1) % 3];
+        int edge_id = 0;
+        bool forward = true;
+        for (int n = point_edge_offsets(start); n < point_edge_offsets(start + 1); n++)
+        {
+            auto mesh_edge = mesh.edges(point_edges(n));
+            if (mesh_edge[0] == end || mesh_edge[1] == end)
+            {
+                edge_id = point_edges(n);
+                forward = (mesh_edge[0] == start);
+                break;
+            }
+        }
+        for (int t = 1; t <= Ref::n_edge_nodes; t++)
+        {
+            int along = forward ? t - 1 : Ref::n_edge_nodes - t;
+            element_dofs(slot, 3 + edge * Ref::n_edge_nodes + t - 1) = edge_base + edge_id * Ref::n_edge_nodes + along;
+        }
+    }
+
+    // Interior nodes belong to this element alone
+    Point pts[3];
+    for (int v = 0; v < 3; v++)
+    {
+        pts[v] = mesh.point(element[v]);
+    }
+    for (int m = 0; m < Ref::n_interior_nodes; m++)
+    {
+        int local = 3 + 3 * Ref::n_edge_nodes + m;
+        int dof = interior_base + slot * Ref::n_interior_nodes + m;
+        element_dofs(slot, local) = dof;
+        for (int dim = 0; dim < 2; dim++)
+        {
+            double x = 0;
+            for (int v = 0; v < 3; v++)
+            {
+                x += ref.node_barycentric[local][v] * pts[v][dim];
+            }
+            dof_coords(dof, dim) = x;
+        }
+    }
+}
+
+template <int P, typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void HighOrderImpl::MassMatrixFunctor<P, ScatterPattern>::operator()(Region element, int slot) const
+{
+    using Ref = ReferenceElement<P>;
+    constexpr Ref ref = build_reference_element<P>();
+
+    Point pts[3];
+    for (int v = 0; v < 3; v++)
+    {
+        pts[v] = mesh.point(element[v]);
+    }
+    double jacobian[2][2];
+    double abs_det = affine_jacobian(pts, jacobian);
+
+    static_for<Ref::n_nodes>([&](auto a)
+                             {
+        constexpr int i = decltype(a)::value;
+        ScatterPattern::contribute(&inv_mass(element_dofs(slot, i)), ref.lumped_mass[i] * abs_det); });
+}
+
+template <int P, typename ScatterPattern>
+KOKKOS_INLINE_FUNCTION void HighOrderImpl::ElementContributionFunctor<P, ScatterPattern>::operator()(Region element, int slot) const
+{
+    using Ref = ReferenceElement<P>;
+    constexpr Ref ref = build_reference_element<P>();
+    constexpr int N = Ref::n_nodes;
+
+    Point pts[3];
+    for (int v = 0; v < 3; v++)
+    {
+        pts[v] = mesh.point(element[v]);
+    }
+    double jacobian[2][2];
+    double abs_det = affine_jacobian(pts, jacobian);
+
+    // |det J| * J^-1 J^-T, already scaled by -k * dt
+    double scale = -k * dt / abs_det;
+    double g_xi_xi = scale * (jacobian[1][1] * jacobian[1][1] + jacobian[0][1] * jacobian[0][1]);
+    double g_xi_eta = -scale * (jacobian[1][1] * jacobian[1][0] + jacobian[0][1] * jacobian[0][0]);
+    double g_eta_eta = scale * (jacobian[1][0] * jacobian[1][0] + jacobian[0][0] * jacobian[0][0]);
+
+    int dofs[N];
+    double u[N];
+    static_for<N>([&](auto a)
+                  {
+        constexpr int i = decltype(a)::value;
+        dofs[i] = element_dofs(slot, i);
+        u[i] = prev_dofs(dofs[i]); });
+
+    // Row i of (lumped M - k * dt * S) u, where the lumped mass term is this element's share of
+    // the identity once scaled by the inverse mass.
+    static_for<N>([&](auto a)
+                  {
+        constexpr int i = decltype(a)::value;
+        double c = ref.lumped_mass[i] * abs_det * u[i];
+        static_for<N>([&](auto b) {
+            constexpr int j = decltype(b)::value;
+            c += (g_xi_xi * ref.stiffness_xi_xi[i][j] + g_xi_eta * ref.stiffness_xi_eta[i][j] + g_eta_eta * ref.stiffness_eta_eta[i][j]) * u[j];
+        });
+        ScatterPattern::contribute(&new_dofs(dofs[i]), inv_mass(dofs[i]) * c); });
+}
+
+// We need to specify what classes we might be using so the linker doesn't get mad
+template class TFEM::HighOrderSolver<2, ColoredElementScatterAdd>;
+template class TFEM::HighOrderSolver<2, AtomicElementScatterAdd>;
+template class TFEM::HighOrderSolver<2, SerialElementScatterAdd>;
+template class TFEM::HighOrderSolver<3, ColoredElementScatterAdd>;
+template class TFEM::HighOrderSolver<3, AtomicElementScatterAdd>;
+template class TFEM::HighOrderSolver<3, SerialElementScatterAdd>;
+template class TFEM::HighOrderSolver<2, SoAColoredElementScatterAdd>;
+template class TFEM::HighOrderSolver<2, SoAAtomicElementScatterAdd>;
+template class TFEM::HighOrderSolver<2, SoASerialElementScatterAdd>;
+template class TFEM::HighOrderSolver<3, SoAColoredElementScatterAdd>;
+template class TFEM::HighOrderSolver<3, SoAAtomicElementScatterAdd>;
+template class TFEM::HighOrderSolver<3, SoASerialElementScatterAdd>;
@@ -0,0 +1,84 @@
+#include "instrumentation.hpp"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+using namespace TFEM;
+
+namespace
+{
+    std::mutex registry_mutex;
+    std::map<std::string, PhaseStats> registry;
+    // Read by every phase, so kept out of the mutex
+    std::atomic<bool> timing_enabled(false);
+
+    double rate(double amount, double seconds)
+    {
+        return seconds > 0 ? amount / seconds : 0;
+    }
+}
+
+void Instrumentation::enable(bool on)
+{
+    timing_enabled.store(on, std::memory_order_relaxed);
+}
+
+bool Instrumentation::enabled()
+{
+    return timing_enabled.load(std::memory_order_relaxed);
+}
+
+void Instrumentation::record(const std::string &phase, double seconds, double bytes, double elements)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    PhaseStats &stats = registry[phase];
+    stats.calls++;
+    stats.seconds += seconds;
+    stats.bytes += bytes;
+    stats.elements += elements;
+}
+
+std::map<std::string, PhaseStats> Instrumentation::phases()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry;
+}
+
+void Instrumentation::reset()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.clear();
+}
+
+void Instrumentation::write_json(std::ostream &out)
+{
+    auto snapshot = phases();
+    auto old_precision = out.precision(10);
+    out << "{\"phases\": {";
+    bool first = true;
+    for (auto &[name, stats] : snapshot)
+    {
+        out << (first ? "" : ",") << "\n  \"" << name << "\": {"
+            << "\"calls\": " << stats.calls
+            << ", \"seconds\": " << stats.seconds
+            << ", \"bytes\": " << stats.bytes
+            << ", \"elements\": " << stats.elements
+            << ", \"bytes_per_second\": " << rate(stats.bytes, stats.seconds)
+            << ", \"elements_per_second\": " << rate(stats.elements, stats.seconds) << "}";
+        first = false;
+    }
+    out << "\n}}\n";
+    out.precision(old_precision);
+}
+
+void Instrumentation::write_json(std::string fname)
+{
+    std::ofstream out(fname);
+    if (!out)
+    {
+        throw std::runtime_error("Could not open instrumentation output " + fname);
+    }
+    write_json(out);
+}
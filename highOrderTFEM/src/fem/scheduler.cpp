@@ -0,0 +1,42 @@
+#include "scheduler.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace TFEM;
+
+ConcurrentScheduler::ConcurrentScheduler(int n_instances)
+{
+    if (n_instances < 1)
+    {
+        throw std::invalid_argument("ConcurrentScheduler: need at least one instance, got " + std::to_string(n_instances));
+    }
+    instances = Kokkos::Experimental::partition_space(Kokkos::DefaultExecutionSpace(), std::vector<int>(n_instances, 1));
+}
+
+void ConcurrentScheduler::simulate_steps(int n_steps, int steps_per_round)
+{
+    if (steps_per_round < 1)
+    {
+        throw std::invalid_argument("ConcurrentScheduler: steps_per_round must be positive, got " + std::to_string(steps_per_round));
+    }
+    ScopedPhase phase("ConcurrentScheduler::simulate_steps");
+    for (int done = 0; done < n_steps; done += steps_per_round)
+    {
+        int round_steps = std::min(steps_per_round, n_steps - done);
+        for (Job &job : jobs)
+        {
+            job.simulate_steps(round_steps);
+        }
+    }
+    fence();
+}
+
+void ConcurrentScheduler::fence()
+{
+    for (Job &job : jobs)
+    {
+        job.space.fence();
+    }
+}
@@ -0,0 +1,214 @@
+#include "snapshot.hpp"
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace TFEM;
+
+void AsyncSnapshotWriter::start(const std::vector<double> &xs, const std::vector<double> &ys, int n_buffers)
+{
+    out_file = std::ofstream(fname, std::ios::binary);
+    if (!out_file)
+    {
+        throw std::runtime_error("Could not open " + fname + " for writing");
+    }
+    write_header(xs, ys);
+
+    // Transfers get their own instance, so they can run alongside the solver's kernels
+    copy_space = Kokkos::Experimental::partition_space(Kokkos::DefaultExecutionSpace(), 1)[0];
+    for (int b = 0; b < n_buffers; b++)
+    {
+        staging_buffers.push_back(StagingBuffer("Snapshot staging buffer", n_points));
+        host_buffers.push_back(HostBuffer("Snapshot host buffer", n_points));
+        free_buffers.push_back(b);
+    }
+    writer = std::thread(&AsyncSnapshotWriter::writer_loop, this);
+}
+
+void AsyncSnapshotWriter::write_header(const std::vector<double> &xs, const std::vector<double> &ys)
+{
+    SnapshotFileHeader header = {};
+    memcpy(header.tag, SNAPSHOT_FILE_TAG, sizeof(SNAPSHOT_FILE_TAG));
+    header.version = SNAPSHOT_FILE_VERSION;
+    header.header_bytes = sizeof(SnapshotFileHeader);
+    header.n_points = n_points;
+    header.n_slices = 0;
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out_file.write(reinterpret_cast<const char *>(xs.data()), n_points * sizeof(double));
+    out_file.write(reinterpret_cast<const char *>(ys.data()), n_points * sizeof(double));
+}
+
+int AsyncSnapshotWriter::acquire_buffer()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]
+                 { return !free_buffers.empty() || write_error; });
+    if (write_error)
+    {
+        std::rethrow_exception(write_error);
+    }
+    int buffer = free_buffers.back();
+    free_buffers.pop_back();
+    return buffer;
+}
+
+void AsyncSnapshotWriter::submit(int buffer, double time)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({buffer, time});
+    }
+    changed.notify_all();
+}
+
+void AsyncSnapshotWriter::writer_loop()
+{
+    // Reused for slices that have to be put back in file order
+    std::vector<double> reordered(permutation.is_identity() ? 0 : n_points);
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]
+                         { return !jobs.empty() || closing; });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = jobs.front();
+        }
+
+        try
+        {
+            // Transfers on the copy instance complete in order, so this covers the job's own
+            copy_space.fence("Snapshot transfer");
+            const double *values = host_buffers[job.buffer].data();
+            if (!permutation.is_identity())
+            {
+                for (pointID p = 0; p < n_points; p++)
+                {
+                    reordered[p] = values[permutation.point_old_to_new(p)];
+                }
+                values = reordered.data();
+            }
+            out_file.write(reinterpret_cast<const char *>(&job.time), sizeof(double));
+            out_file.write(reinterpret_cast<const char *>(values), n_points * sizeof(double));
+            if (!out_file)
+            {
+                throw std::runtime_error("Failed while writing snapshot file " + fname);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            write_error = std::current_exception();
+            jobs.clear();
+            changed.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.pop_front();
+            free_buffers.push_back(job.buffer);
+            slice_count++;
+        }
+        changed.notify_all();
+    }
+}
+
+void AsyncSnapshotWriter::flush()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]
+                     { return jobs.empty() || write_error; });
+        if (write_error)
+        {
+            std::rethrow_exception(write_error);
+        }
+    }
+    out_file.flush();
+}
+
+int64_t AsyncSnapshotWriter::slices_written()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return slice_count;
+}
+
+AsyncSnapshotWriter::~AsyncSnapshotWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    changed.notify_all();
+    writer.join();
+
+    // Patch in the final slice count
+    out_file.seekp(offsetof(SnapshotFileHeader, n_slices));
+    out_file.write(reinterpret_cast<const char *>(&slice_count), sizeof(slice_count));
+}
+
+void TFEM::snapshot_to_json(std::string snapshot_fname, std::string json_fname)
+{
+    std::ifstream in_file(snapshot_fname, std::ios::binary);
+    SnapshotFileHeader header;
+    if (!in_file.read(reinterpret_cast<char *>(&header), sizeof(header)) || memcmp(header.tag, SNAPSHOT_FILE_TAG, sizeof(SNAPSHOT_FILE_TAG)) != 0)
+    {
+        throw std::runtime_error(snapshot_fname + " is not a snapshot file");
+    }
+    if (header.version != SNAPSHOT_FILE_VERSION)
+    {
+        throw std::runtime_error(snapshot_fname + " has unsupported snapshot version " + std::to_string(header.version));
+    }
+    in_file.seekg(header.header_bytes);
+
+    std::vector<double> xs(header.n_points);
+    std::vector<double> ys(header.n_points);
+    in_file.read(reinterpret_cast<char *>(xs.data()), header.n_points * sizeof(double));
+    in_file.read(reinterpret_cast<char *>(ys.data()), header.n_points * sizeof(double));
+
+    std::ofstream out_file(json_fname);
+    out_file << "{\"points\": [";
+    for (int64_t p = 0; p < header.n_points; p++)
+    {
+        if (p > 0)
+        {
+            out_file << ", ";
+        }
+        out_file << "[" << xs[p] << ", " << ys[p] << "]";
+    }
+    out_file << "],\n\"slices\":[";
+
+    // Read slices until the count in the header, or the end of the file if it was never closed
+    std::vector<double> values(header.n_points);
+    for (int64_t s = 0; header.n_slices == 0 || s < header.n_slices; s++)
+    {
+        double time;
+        if (!in_file.read(reinterpret_cast<char *>(&time), sizeof(double)) ||
+            !in_file.read(reinterpret_cast<char *>(values.data()), header.n_points * sizeof(double)))
+        {
+            break;
+        }
+        if (s > 0)
+        {
+            out_file << ",";
+        }
+        out_file << std::endl
+                 << "[";
+        for (int64_t p = 0; p < header.n_points; p++)
+        {
+            if (p > 0)
+            {
+                out_file << ", ";
+            }
+            out_file << values[p];
+        }
+        out_file << "]";
+    }
+    out_file << "]}";
+}
@@ -1,126 +1,1229 @@
 #include <Kokkos_Core.hpp>
+#include <KokkosSparse_spmv.hpp>
+#include <KokkosBlas1_axpby.hpp>
+#include <KokkosBlas1_dot.hpp>
+#include <KokkosBlas1_mult.hpp>
 #include "mesh.hpp"
 #include "solver.hpp"
+#include "linear_element.hpp"
 #include "analytical.hpp"
+#include "instrumentation.hpp"
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 #include "scatter_pattern.hpp"
 
 using namespace TFEM;
 
-template <typename ScatterPattern>
-Solver<ScatterPattern>::Solver(DeviceMesh mesh, ScatterPattern pattern, Analytical::ZeroBoundary<> boundary_conditions, double timestep, double k)
-    : mesh(mesh),
+namespace
+{
+    // Checkpoint sections go through a pinned host copy of the view, in a single transfer each way
+    template <class ViewT>
+    void write_view_section(const Kokkos::DefaultExecutionSpace &space, CheckpointImpl::Writer &writer, int section, ViewT view)
+    {
+        auto staged = Kokkos::create_mirror(CheckpointPinnedSpace(), view);
+        Kokkos::deep_copy(space, staged, view);
+        space.fence();
+        writer.write_section(section, staged.data());
+    }
+
+    template <class ViewT>
+    void read_view_section(const Kokkos::DefaultExecutionSpace &space, CheckpointImpl::Reader &reader, int section, ViewT view)
+    {
+        auto staged = Kokkos::create_mirror(CheckpointPinnedSpace(), view);
+        reader.read_view(section, staged);
+        Kokkos::deep_copy(space, view, staged);
+        // The staging buffer goes away with this scope
+        space.fence();
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+Solver<ScatterPattern, StorageScalar, ComputeScalar>::Solver(MeshT mesh, ScatterPattern pattern, Analytical::PolynomialBoundary<> boundary_conditions, double timestep, double k, SolverOptions options)
+    : point_mass_inv("Inverse Point Masses", mesh.point_count()),
+      last_cg_iterations(0),
+      next_step_graph(0),
+      n_levels(1),
+      max_tile_points(0),
+      max_tile_regions(0),
+      tile_scratch_level(0),
+      mesh(mesh),
+      scatter_pattern(pattern),
+      exec_space(pattern_execution_space(pattern)),
+      boundary(boundary_conditions),
       dt(timestep),
-      n_total_steps(0),
       k(k),
+      n_total_steps(0),
+      options(options),
       current_point_weights("Current Point Weights", mesh.point_count()),
-      prev_point_weights("Prev Point Weights", mesh.point_count()),
-      point_mass_inv("Inverse Point Masses", mesh.point_count()),
-      scatter_pattern(pattern),
-      boundary(boundary_conditions)
+      prev_point_weights("Prev Point Weights", mesh.point_count())
 {
+    ScopedPhase phase(exec_space, "Solver::Solver");
     // By assigning the non-const view to the const view, we
     // essentialy point the const view to the same memory- they
     // will update in parallel.
     prev_point_weights_readonly = prev_point_weights;
     point_mass_inv_readonly = point_mass_inv;
+    if (dt <= 0 && options.step_mode != StepMode::Multirate)
+    {
+        dt = stable_timestep(mesh, k, options.timestep_safety, exec_space);
+    }
+    setup_multirate_levels();
     setup_mass_matrix();
+    setup_element_geometry();
+    setup_step_operator();
+    setup_implicit();
+    release_setup_edges();
+    setup_temporal_tiles();
+    if (options.tabulate_analytic)
+    {
+        tabulated_boundary = Analytical::TabulatedZeroBoundary(boundary.zero_boundary_part(), mesh, exec_space);
+    }
     setup_initial_conditions();
-    Kokkos::fence();
+    // Start the boundary points at their exact values. Unless there is a boundary pass, they
+    // keep them: masked points never receive contributions, and multirate substeps only add to
+    // the points that are due.
+    fix_boundary();
+    setup_dirichlet_fill();
+    setup_step_graphs();
+    exec_space.fence();
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+Solver<ScatterPattern, StorageScalar, ComputeScalar>::Solver(std::string checkpoint_file, MeshT mesh, ScatterPattern pattern, Analytical::PolynomialBoundary<> boundary_conditions, SolverOptions options)
+    : point_mass_inv("Inverse Point Masses", mesh.point_count()),
+      last_cg_iterations(0),
+      next_step_graph(0),
+      n_levels(1),
+      max_tile_points(0),
+      max_tile_regions(0),
+      tile_scratch_level(0),
+      mesh(mesh),
+      scatter_pattern(pattern),
+      exec_space(pattern_execution_space(pattern)),
+      boundary(boundary_conditions),
+      dt(0),
+      k(0),
+      n_total_steps(0),
+      options(options),
+      current_point_weights("Current Point Weights", mesh.point_count()),
+      prev_point_weights("Prev Point Weights", mesh.point_count())
+{
+    prev_point_weights_readonly = prev_point_weights;
+    point_mass_inv_readonly = point_mass_inv;
+    restore_checkpoint(checkpoint_file);
 }
 
-template <typename ScatterPattern>
-void Solver<ScatterPattern>::setup_mass_matrix()
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::restore_checkpoint(std::string fname)
+{
+    ScopedPhase phase(exec_space, "Solver::restore_checkpoint");
+    CheckpointImpl::Reader reader(fname);
+    const CheckpointHeader &header = reader.file_header();
+    if (header.storage_bytes != sizeof(StorageScalar))
+    {
+        throw std::runtime_error("Checkpoint " + fname + " was written by a solver with another storage precision");
+    }
+    if (header.n_points != mesh.point_count() || header.n_regions != mesh.region_count() || header.mesh_hash != mesh_connectivity_hash(mesh))
+    {
+        throw std::runtime_error("Checkpoint " + fname + " was written for a different mesh");
+    }
+    dt = header.dt;
+    k = header.k;
+    n_total_steps = header.n_total_steps;
+
+    // Level groups are scatter patterns of their own, so they are not stored
+    setup_multirate_levels();
+
+    read_view_section(exec_space, reader, CHECKPOINT_STATE, current_point_weights);
+    if ((bool)header.mass_masked == masks_boundary_mass())
+    {
+        read_view_section(exec_space, reader, CHECKPOINT_MASS_INV, point_mass_inv);
+    }
+    else
+    {
+        setup_mass_matrix();
+    }
+
+    if (caches_element_geometry())
+    {
+        // The cache is in slot order and may have the lumped mass folded in
+        if (reader.has_section(CHECKPOINT_GEOMETRY) && (bool)header.geometry_fused == uses_fused_update() && header.slot_order_hash == slot_order_hash())
+        {
+            element_geometry = ElementGeometryCache("Element geometry cache", mesh.region_count());
+            read_view_section(exec_space, reader, CHECKPOINT_GEOMETRY, element_geometry);
+        }
+        else
+        {
+            setup_element_geometry();
+        }
+    }
+
+    if (options.step_mode == StepMode::AssembledSpMV)
+    {
+        if (reader.has_section(CHECKPOINT_OPERATOR_VALUES))
+        {
+            int n_points = mesh.point_count();
+            int nnz = header.section_bytes[CHECKPOINT_OPERATOR_ENTRIES] / sizeof(int);
+            Kokkos::View<int *> row_map("Step operator row map", n_points + 1);
+            Kokkos::View<int *> entries("Step operator entries", nnz);
+            Kokkos::View<StorageScalar *> values("Step operator values", nnz);
+            read_view_section(exec_space, reader, CHECKPOINT_OPERATOR_ROW_MAP, row_map);
+            read_view_section(exec_space, reader, CHECKPOINT_OPERATOR_ENTRIES, entries);
+            read_view_section(exec_space, reader, CHECKPOINT_OPERATOR_VALUES, values);
+            step_operator = StepOperator("Step operator", n_points, n_points, nnz, values, row_map, entries);
+        }
+        else
+        {
+            setup_step_operator();
+        }
+    }
+    setup_implicit();
+    release_setup_edges();
+    // Tiles are rebuilt rather than stored; partitioning is deterministic, so they come out the same
+    setup_temporal_tiles();
+
+    if (options.tabulate_analytic)
+    {
+        tabulated_boundary = Analytical::TabulatedZeroBoundary(boundary.zero_boundary_part(), mesh, exec_space);
+    }
+    setup_dirichlet_fill();
+    setup_step_graphs();
+    exec_space.fence();
+
+    uint64_t bytes = 0;
+    for (int s = 0; s < CHECKPOINT_MESH; s++)
+    {
+        bytes += header.section_bytes[s];
+    }
+    phase.add_work(bytes);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+uint64_t Solver<ScatterPattern, StorageScalar, ComputeScalar>::slot_order_hash()
+{
+    if constexpr (std::is_same_v<ScatterPattern, BasicColoredElementScatterAdd<MeshT>>)
+    {
+        std::vector<int32_t> ids = scatter_pattern.color_map().color_ordered_region_ids();
+        return checkpoint_order_hash(ids.data(), ids.size());
+    }
+    else
+    {
+        // Every other pattern uses region IDs as slots
+        return 0;
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::checkpoint(std::string fname)
+{
+    write_checkpoint(fname, nullptr);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::checkpoint(std::string fname, typename MeshT::HostMirrorMesh &host_mesh)
+{
+    write_checkpoint(fname, &host_mesh);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::write_checkpoint(std::string fname, typename MeshT::HostMirrorMesh *host_mesh)
+{
+    ScopedPhase phase(exec_space, "Solver::checkpoint");
+    if (host_mesh && (!std::is_same_v<typename MeshT::Scalar, double> || MeshT::has_compact_regions || !std::is_same_v<typename MeshT::Index, pointID>))
+    {
+        // The binary mesh format stores double coordinates and full pointID regions
+        throw std::invalid_argument("Solver::checkpoint: only double precision meshes with full pointID regions can be embedded");
+    }
+    if (host_mesh)
+    {
+        // The embedded mesh must match the one the checkpoint is keyed on, which a host mirror
+        // left in the old region order by share_mesh_regions does not
+        auto device_regions = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), mesh.regions);
+        bool matches = host_mesh->point_count() == mesh.point_count() && host_mesh->region_count() == mesh.region_count();
+        for (int r = 0; matches && r < mesh.region_count(); r++)
+        {
+            Region device_region = load_region(device_regions, r);
+            Region host_region = host_mesh->region(r);
+            for (int j = 0; j < 3; j++)
+            {
+                matches = matches && device_region[j] == host_region[j];
+            }
+        }
+        if (!matches)
+        {
+            throw std::invalid_argument("Solver::checkpoint: the host mesh does not match the solver's mesh (after share_mesh_regions, copy mesh.regions back to the host mirror)");
+        }
+    }
+    CheckpointHeader header = {};
+    header.storage_bytes = sizeof(StorageScalar);
+    header.step_mode = static_cast<int32_t>(options.step_mode);
+    header.mass_masked = masks_boundary_mass();
+    header.geometry_fused = uses_fused_update();
+    header.n_points = mesh.point_count();
+    header.n_regions = mesh.region_count();
+    header.n_total_steps = n_total_steps;
+    header.dt = dt;
+    header.k = k;
+    header.mesh_hash = mesh_connectivity_hash(mesh);
+    header.slot_order_hash = slot_order_hash();
+
+    header.section_bytes[CHECKPOINT_STATE] = current_point_weights.span() * sizeof(StorageScalar);
+    header.section_bytes[CHECKPOINT_MASS_INV] = point_mass_inv.span() * sizeof(StorageScalar);
+    header.section_bytes[CHECKPOINT_GEOMETRY] = element_geometry.span() * sizeof(StorageScalar);
+    bool has_operator = options.step_mode == StepMode::AssembledSpMV;
+    if (has_operator)
+    {
+        header.section_bytes[CHECKPOINT_OPERATOR_ROW_MAP] = step_operator.graph.row_map.span() * sizeof(int);
+        header.section_bytes[CHECKPOINT_OPERATOR_ENTRIES] = step_operator.graph.entries.span() * sizeof(int);
+        header.section_bytes[CHECKPOINT_OPERATOR_VALUES] = step_operator.values.span() * sizeof(StorageScalar);
+    }
+    std::vector<int32_t> color_starts;
+    std::vector<int32_t> member_ids;
+    if constexpr (std::is_same_v<ScatterPattern, BasicColoredElementScatterAdd<MeshT>>)
+    {
+        auto &coloring = scatter_pattern.color_map();
+        header.n_colors = coloring.color_count();
+        for (int color = 0; color < coloring.color_count(); color++)
+        {
+            color_starts.push_back(coloring.color_start(color));
+        }
+        color_starts.push_back(mesh.region_count());
+        member_ids = coloring.color_ordered_region_ids();
+        header.section_bytes[CHECKPOINT_COLOR_STARTS] = color_starts.size() * sizeof(int32_t);
+        header.section_bytes[CHECKPOINT_COLOR_MEMBERS] = member_ids.size() * sizeof(int32_t);
+    }
+
+    CheckpointImpl::Writer writer(fname, header);
+    write_view_section(exec_space, writer, CHECKPOINT_STATE, current_point_weights);
+    write_view_section(exec_space, writer, CHECKPOINT_MASS_INV, point_mass_inv);
+    if (element_geometry.extent(0) > 0)
+    {
+        write_view_section(exec_space, writer, CHECKPOINT_GEOMETRY, element_geometry);
+    }
+    if (has_operator)
+    {
+        write_view_section(exec_space, writer, CHECKPOINT_OPERATOR_ROW_MAP, step_operator.graph.row_map);
+        write_view_section(exec_space, writer, CHECKPOINT_OPERATOR_ENTRIES, step_operator.graph.entries);
+        write_view_section(exec_space, writer, CHECKPOINT_OPERATOR_VALUES, step_operator.values);
+    }
+    if (!member_ids.empty())
+    {
+        writer.write_section(CHECKPOINT_COLOR_STARTS, color_starts.data());
+        writer.write_section(CHECKPOINT_COLOR_MEMBERS, member_ids.data());
+    }
+    uint64_t bytes = 0;
+    for (int s = 0; s < CHECKPOINT_MESH; s++)
+    {
+        bytes += header.section_bytes[s];
+    }
+    if (host_mesh)
+    {
+        if constexpr (std::is_same_v<typename MeshT::Scalar, double> && !MeshT::has_compact_regions && std::is_same_v<typename MeshT::Index, pointID>)
+        {
+            bytes += save_mesh_to_binary_file(writer.begin_mesh_section(), *host_mesh);
+        }
+    }
+    writer.close();
+    phase.add_work(bytes);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_mass_matrix()
 {
     // Create local var to avoid capturing the "this" pointer
     auto point_mass_inv = this->point_mass_inv;
 
     // Dispatch the mass matrix assembly functor to the scatter pattern.
-    SolverImpl::MassMatrixFunctor<ScatterPattern> mass_functor(point_mass_inv, mesh, k, dt);
+    SolverImpl::MassMatrixFunctor<ScatterPattern, StorageScalar, ComputeScalar> mass_functor(point_mass_inv, mesh, k, dt);
     scatter_pattern.distribute_work(mass_functor);
 
     // pre-invert the diagonal now to avoid an operation each timestep.
-    Kokkos::parallel_for(mesh.point_count(), KOKKOS_LAMBDA(const int &i) { //
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(const int &i) { //
         point_mass_inv(i) = 1 / point_mass_inv(i);
     });
-    Kokkos::fence();
+
+    if (masks_boundary_mass())
+    {
+        // Masking out the boundary points means they never receive any contributions, which
+        // takes the place of the separate boundary pass. (For the assembled operator, it leaves
+        // just the identity on the boundary rows.)
+        auto boundary_points = mesh.boundary_points;
+        Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(const int &i) {
+            if (boundary_points(i)) {
+                point_mass_inv(i) = 0;
+            } });
+    }
+    exec_space.fence();
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_multirate_levels()
+{
+    if (options.step_mode != StepMode::Multirate)
+    {
+        return;
+    }
+    int max_levels = options.multirate_levels;
+    if (max_levels < 1 || max_levels > 30)
+    {
+        throw std::invalid_argument("Solver: multirate_levels must be between 1 and 30, got " + std::to_string(max_levels));
+    }
+
+    auto mesh = this->mesh;
+    int n_regions = mesh.region_count();
+    // Filled on the solver's instance, like everything reading it below
+    auto element_dt = element_stable_timesteps(mesh, k, exec_space);
+    double safety = options.timestep_safety;
+    if (dt <= 0)
+    {
+        // The largest step that still leaves the most restrictive element within the finest level,
+        // but no larger than the least restrictive element needs.
+        double min_dt;
+        double max_dt;
+        Kokkos::parallel_reduce(Kokkos::RangePolicy<>(exec_space, 0, n_regions), KOKKOS_LAMBDA(int r, double &partial) { partial = Kokkos::fmin(partial, element_dt(r)); }, Kokkos::Min<double>(min_dt));
+        Kokkos::parallel_reduce(Kokkos::RangePolicy<>(exec_space, 0, n_regions), KOKKOS_LAMBDA(int r, double &partial) { partial = Kokkos::fmax(partial, element_dt(r)); }, Kokkos::Max<double>(max_dt));
+        dt = safety * std::min(max_dt, min_dt * (1 << (max_levels - 1)));
+    }
+
+    // Element level: the coarsest level whose step is within the element's (scaled) limit
+    double coarse_dt = this->dt;
+    Kokkos::View<int *> element_levels("Element multirate levels", n_regions);
+    point_levels = Kokkos::View<int *>("Point multirate levels", mesh.point_count());
+    auto point_levels = this->point_levels;
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_regions), KOKKOS_LAMBDA(int r) {
+        int level = 0;
+        while (level < 31 && coarse_dt / (1 << level) > safety * element_dt(r)) {
+            level++;
+        }
+        element_levels(r) = level;
+        Region element = mesh.region(r);
+        for (int j = 0; j < 3; j++) {
+            Kokkos::atomic_max(&point_levels(element[j]), level);
+        } });
+    int finest_level;
+    Kokkos::parallel_reduce(Kokkos::RangePolicy<>(exec_space, 0, n_regions), KOKKOS_LAMBDA(int r, int &partial) { partial = Kokkos::max(partial, element_levels(r)); }, Kokkos::Max<int>(finest_level));
+    if (finest_level >= max_levels)
+    {
+        throw std::invalid_argument("Solver: timestep " + std::to_string(coarse_dt) + " needs " + std::to_string(finest_level + 1) + " multirate levels, but only " + std::to_string(max_levels) + " are allowed");
+    }
+    // Levels finer than any element needs would only add empty substeps
+    n_levels = finest_level + 1;
+
+    // Group the elements by the finest level among their points, since that is how often they
+    // have a point to update
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_regions), KOKKOS_LAMBDA(int r) {
+        Region element = mesh.region(r);
+        element_levels(r) = Kokkos::max(point_levels(element[0]), Kokkos::max(point_levels(element[1]), point_levels(element[2]))); });
+    auto element_levels_host = Kokkos::create_mirror_view(Kokkos::HostSpace(), element_levels);
+    Kokkos::deep_copy(exec_space, element_levels_host, element_levels);
+    exec_space.fence();
+    std::vector<std::vector<int>> level_ids(n_levels);
+    for (int r = 0; r < n_regions; r++)
+    {
+        level_ids[element_levels_host(r)].push_back(r);
+    }
+    level_meshes.clear();
+    level_patterns.clear();
+    for (int level = 0; level < n_levels; level++)
+    {
+        Kokkos::View<int *> ids("Multirate level region IDs", level_ids[level].size());
+        auto ids_host = Kokkos::create_mirror_view(ids);
+        for (size_t i = 0; i < level_ids[level].size(); i++)
+        {
+            ids_host(i) = level_ids[level][i];
+        }
+        Kokkos::deep_copy(exec_space, ids, ids_host);
+        level_meshes.push_back(mesh.with_region_subset(ids, exec_space));
+        // Some patterns (e.g. coloring) cannot be built over an empty mesh
+        level_patterns.emplace_back();
+        if (level_meshes.back().region_count() > 0)
+        {
+            // On the solver's instance, for the patterns that can be built on one
+            if constexpr (std::is_constructible_v<ScatterPattern, MeshT, Kokkos::DefaultExecutionSpace>)
+            {
+                level_patterns.back().emplace(level_meshes.back(), exec_space);
+            }
+            else
+            {
+                level_patterns.back().emplace(level_meshes.back());
+            }
+        }
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+std::vector<int> Solver<ScatterPattern, StorageScalar, ComputeScalar>::level_element_counts()
+{
+    std::vector<int> counts;
+    for (auto &level_mesh : level_meshes)
+    {
+        counts.push_back(level_mesh.region_count());
+    }
+    return counts;
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_temporal_tiles()
+{
+    if (options.step_mode != StepMode::TemporalBlocked)
+    {
+        return;
+    }
+    int n_layers = options.temporal_block_steps;
+    if (n_layers < 1 || options.tile_points < 1)
+    {
+        throw std::invalid_argument("Solver: temporal_block_steps and tile_points must be positive");
+    }
+    if (boundary.is_time_dependent())
+    {
+        // Tiles would need the boundary values at every step inside a block
+        throw std::invalid_argument("Solver: StepMode::TemporalBlocked needs boundary values that do not change with time");
+    }
+    ScopedPhase phase(exec_space, "Solver::setup_temporal_tiles");
+
+    auto host_mesh = mesh.create_host_mirror();
+    mesh.deep_copy_all_to(host_mesh);
+    int n_points = mesh.point_count();
+    int n_regions = mesh.region_count();
+    int n_tiles = std::max(1, (n_points + options.tile_points - 1) / options.tile_points);
+    auto region_tiles = partition_mesh_regions(host_mesh, n_tiles);
+
+    // Regions touching each point as a CSR, and each point's owner: the lowest tile among its
+    // regions (tile 0 for a point without any)
+    std::vector<int> point_region_starts(n_points + 1, 0);
+    std::vector<int> owners(n_points, n_tiles);
+    for (int r = 0; r < n_regions; r++)
+    {
+        Region element = host_mesh.region(r);
+        for (int j = 0; j < 3; j++)
+        {
+            point_region_starts[element[j] + 1]++;
+            owners[element[j]] = std::min(owners[element[j]], region_tiles(r));
+        }
+    }
+    for (int p = 0; p < n_points; p++)
+    {
+        point_region_starts[p + 1] += point_region_starts[p];
+    }
+    std::vector<int> point_regions(point_region_starts[n_points]);
+    std::vector<int> fill(point_region_starts.begin(), point_region_starts.end() - 1);
+    for (int r = 0; r < n_regions; r++)
+    {
+        Region element = host_mesh.region(r);
+        for (int j = 0; j < 3; j++)
+        {
+            point_regions[fill[element[j]]++] = r;
+        }
+    }
+    std::vector<std::vector<pointID>> owned(n_tiles);
+    for (int p = 0; p < n_points; p++)
+    {
+        owned[owners[p] == n_tiles ? 0 : owners[p]].push_back(p);
+    }
+
+    // Grow each tile by n_layers layers: every layer adds the regions touching the points added
+    // last, and their vertices. After s steps inside the tile, the points within s - l layers of
+    // the owned ones are still exact after l steps, since all of their regions are present.
+    std::vector<int> point_starts = {0};
+    std::vector<int> owned_counts;
+    std::vector<pointID> point_ids;
+    std::vector<int> region_starts = {0};
+    std::vector<int> region_vertices;
+    std::vector<int> local_ids(n_points, -1);
+    std::vector<int> region_stamp(n_regions, -1);
+    max_tile_points = 0;
+    max_tile_regions = 0;
+    for (int t = 0; t < n_tiles; t++)
+    {
+        std::vector<pointID> tile_points = owned[t];
+        for (size_t i = 0; i < tile_points.size(); i++)
+        {
+            local_ids[tile_points[i]] = i;
+        }
+        size_t first_region = region_vertices.size() / 3;
+        size_t layer_begin = 0;
+        for (int layer = 0; layer < n_layers; layer++)
+        {
+            size_t layer_end = tile_points.size();
+            for (size_t i = layer_begin; i < layer_end; i++)
+            {
+                pointID p = tile_points[i];
+                for (int n = point_region_starts[p]; n < point_region_starts[p + 1]; n++)
+                {
+                    int r = point_regions[n];
+                    if (region_stamp[r] == t)
+                    {
+                        continue;
+                    }
+                    region_stamp[r] = t;
+                    Region element = host_mesh.region(r);
+                    for (int j = 0; j < 3; j++)
+                    {
+                        if (local_ids[element[j]] < 0)
+                        {
+                            local_ids[element[j]] = tile_points.size();
+                            tile_points.push_back(element[j]);
+                        }
+                        region_vertices.push_back(local_ids[element[j]]);
+                    }
+                }
+            }
+            layer_begin = layer_end;
+        }
+        int n_tile_regions = region_vertices.size() / 3 - first_region;
+        max_tile_points = std::max(max_tile_points, (int)tile_points.size());
+        max_tile_regions = std::max(max_tile_regions, n_tile_regions);
+        for (pointID p : tile_points)
+        {
+            local_ids[p] = -1;
+        }
+        point_ids.insert(point_ids.end(), tile_points.begin(), tile_points.end());
+        point_starts.push_back(point_ids.size());
+        owned_counts.push_back(owned[t].size());
+        region_starts.push_back(region_vertices.size() / 3);
+    }
+
+    tile_point_starts = Kokkos::View<int *>("Tile point starts", n_tiles + 1);
+    tile_owned_counts = Kokkos::View<int *>("Tile owned point counts", n_tiles);
+    tile_point_ids = Kokkos::View<pointID *>("Tile point IDs", point_ids.size());
+    tile_region_starts = Kokkos::View<int *>("Tile region starts", n_tiles + 1);
+    tile_region_vertices = Kokkos::View<int *[3]>("Tile region vertices", region_starts.back());
+    auto point_starts_host = Kokkos::create_mirror_view(tile_point_starts);
+    auto owned_counts_host = Kokkos::create_mirror_view(tile_owned_counts);
+    auto point_ids_host = Kokkos::create_mirror_view(tile_point_ids);
+    auto region_starts_host = Kokkos::create_mirror_view(tile_region_starts);
+    auto region_vertices_host = Kokkos::create_mirror_view(tile_region_vertices);
+    for (int t = 0; t <= n_tiles; t++)
+    {
+        point_starts_host(t) = point_starts[t];
+        region_starts_host(t) = region_starts[t];
+    }
+    for (int t = 0; t < n_tiles; t++)
+    {
+        owned_counts_host(t) = owned_counts[t];
+    }
+    for (size_t i = 0; i < point_ids.size(); i++)
+    {
+        point_ids_host(i) = point_ids[i];
+    }
+    for (int r = 0; r < region_starts.back(); r++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            region_vertices_host(r, j) = region_vertices[3 * r + j];
+        }
+    }
+    Kokkos::deep_copy(exec_space, tile_point_starts, point_starts_host);
+    Kokkos::deep_copy(exec_space, tile_owned_counts, owned_counts_host);
+    Kokkos::deep_copy(exec_space, tile_point_ids, point_ids_host);
+    Kokkos::deep_copy(exec_space, tile_region_starts, region_starts_host);
+    Kokkos::deep_copy(exec_space, tile_region_vertices, region_vertices_host);
+
+    // Fast (shared) scratch if the largest tile fits, otherwise the larger, slower level
+    using BlockFunctor = SolverImpl::TemporalBlockFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+    size_t scratch_bytes = BlockFunctor::scratch_bytes(max_tile_points, max_tile_regions);
+    tile_scratch_level = scratch_bytes <= (size_t)Kokkos::TeamPolicy<>::scratch_size_max(0) ? 0 : 1;
+    if (scratch_bytes > (size_t)Kokkos::TeamPolicy<>::scratch_size_max(tile_scratch_level))
+    {
+        throw std::invalid_argument("Solver: tiles need " + std::to_string(scratch_bytes) + " bytes of scratch memory, more than the device has; lower tile_points");
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+double Solver<ScatterPattern, StorageScalar, ComputeScalar>::element_pass_bytes(int n_elements)
+{
+    double n_points = mesh.point_count();
+    double geometry_bytes = element_geometry.extent(0) > 0 ? 6.0 * sizeof(StorageScalar) * n_elements : n_points * sizeof(typename MeshT::PointType);
+    double region_bytes = MeshT::has_compact_regions ? sizeof(CompactRegion) : 3.0 * sizeof(typename MeshT::Index);
+    return region_bytes * n_elements + geometry_bytes + 4.0 * sizeof(StorageScalar) * n_points;
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_element_geometry()
+{
+    if (!caches_element_geometry())
+    {
+        return;
+    }
+    element_geometry = ElementGeometryCache("Element geometry cache", mesh.region_count());
+    SolverImpl::ElementGeometryFunctor<ScatterPattern, StorageScalar, ComputeScalar> geometry_functor(element_geometry, mesh, k, dt, uses_fused_update());
+    scatter_pattern.distribute_work(geometry_functor);
+    exec_space.fence();
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+typename Solver<ScatterPattern, StorageScalar, ComputeScalar>::StepOperator Solver<ScatterPattern, StorageScalar, ComputeScalar>::assemble_stiffness_operator(ConstInvMassMatrix row_scale, double scaled_dt)
+{
+    if (!mesh.has_edges())
+    {
+        throw std::invalid_argument("Solver: assembling the step operator needs the mesh edges, which were released");
+    }
+    auto mesh = this->mesh;
+    int n_points = mesh.point_count();
+
+    // Each point couples to itself and to every point it shares an edge with.
+    Kokkos::View<int *> row_map("Step operator row map", n_points + 1);
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_points), KOKKOS_LAMBDA(int p) { row_map(p + 1) = 1; });
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.edge_count()), KOKKOS_LAMBDA(int e) {
+        auto edge = mesh.edges(e);
+        Kokkos::atomic_add(&row_map(edge[0] + 1), 1);
+        Kokkos::atomic_add(&row_map(edge[1] + 1), 1); });
+    Kokkos::parallel_scan(Kokkos::RangePolicy<>(exec_space, 0, n_points + 1), KOKKOS_LAMBDA(int i, int &partial, bool final) {
+        partial += row_map(i);
+        if (final) {
+            row_map(i) = partial;
+        } });
+    int nnz;
+    Kokkos::deep_copy(exec_space, nnz, Kokkos::subview(row_map, n_points));
+    exec_space.fence();
+
+    // Diagonal first, then the neighbors, sorted so the layout does not depend on thread timing.
+    Kokkos::View<int *> entries("Step operator entries", nnz);
+    Kokkos::View<int *> fill("Step operator fill counts", n_points);
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_points), KOKKOS_LAMBDA(int p) {
+        entries(row_map(p)) = p;
+        fill(p) = 1; });
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.edge_count()), KOKKOS_LAMBDA(int e) {
+        auto edge = mesh.edges(e);
+        for (int side = 0; side < 2; side++) {
+            int row = edge[side];
+            entries(row_map(row) + Kokkos::atomic_fetch_add(&fill(row), 1)) = edge[1 - side];
+        } });
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_points), KOKKOS_LAMBDA(int p) {
+        for (int a = row_map(p) + 2; a < row_map(p + 1); a++) {
+            int value = entries(a);
+            int b = a - 1;
+            for (; b > row_map(p) && entries(b) > value; b--) {
+                entries(b + 1) = entries(b);
+            }
+            entries(b + 1) = value;
+        } });
+
+    // Stiffness terms go through the scatter pattern, since elements share rows.
+    Kokkos::View<StorageScalar *> values("Step operator values", nnz);
+    SolverImpl::OperatorAssemblyFunctor<ScatterPattern, StorageScalar, ComputeScalar> assembly_functor(values, row_map, entries, row_scale, mesh, k, scaled_dt);
+    scatter_pattern.distribute_work(assembly_functor);
+    return StepOperator("Step operator", n_points, n_points, nnz, values, row_map, entries);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_step_operator()
+{
+    if (options.step_mode != StepMode::AssembledSpMV)
+    {
+        return;
+    }
+    step_operator = assemble_stiffness_operator(point_mass_inv_readonly, dt);
+
+    // Identity term. The zeroed inverse mass kept the stiffness out of the boundary rows, so
+    // they are just the identity and hold their Dirichlet values.
+    auto row_map = step_operator.graph.row_map;
+    auto values = step_operator.values;
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(int p) { values(row_map(p)) += 1; });
+    exec_space.fence();
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::release_setup_edges()
+{
+    this->mesh.release_edges();
+    pattern_release_mesh_edges(scatter_pattern);
+    for (auto &level_mesh : level_meshes)
+    {
+        level_mesh.release_edges();
+    }
+    for (auto &level_pattern : level_patterns)
+    {
+        if (level_pattern)
+        {
+            pattern_release_mesh_edges(*level_pattern);
+        }
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_implicit()
+{
+    if (!is_implicit())
+    {
+        return;
+    }
+    int n_points = mesh.point_count();
+    implicit_mask = InvMassMatrix("Implicit boundary mask", n_points);
+    cg_residual = Kokkos::View<StorageScalar *>("CG residual", n_points);
+    cg_preconditioned = Kokkos::View<StorageScalar *>("CG preconditioned residual", n_points);
+    cg_search = Kokkos::View<StorageScalar *>("CG search direction", n_points);
+    cg_product = Kokkos::View<StorageScalar *>("CG operator product", n_points);
+
+    auto implicit_mask = this->implicit_mask;
+    auto boundary_points = mesh.boundary_points;
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_points), KOKKOS_LAMBDA(int p) { implicit_mask(p) = boundary_points(p) ? 0 : 1; });
+
+    if (options.assemble_implicit_operator)
+    {
+        // -k * (-theta * dt) * S = theta*dt*k*S on the interior rows, plus the lumped mass
+        implicit_operator = assemble_stiffness_operator(implicit_mask, -implicit_theta() * dt);
+        auto row_map = implicit_operator.graph.row_map;
+        auto values = implicit_operator.values;
+        auto point_mass_inv = this->point_mass_inv;
+        Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, n_points), KOKKOS_LAMBDA(int p) { values(row_map(p)) += implicit_mask(p) / point_mass_inv(p); });
+    }
+    exec_space.fence();
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_step_graphs()
+{
+    if (options.step_mode != StepMode::Graph)
+    {
+        return;
+    }
+    if constexpr (pattern_supports_graph_v<ScatterPattern>)
+    {
+        // Buffer 0 is the one holding the initial conditions
+        PointWeightBuffer buffers[2] = {current_point_weights, prev_point_weights};
+        for (int from = 0; from < 2; from++)
+        {
+            PointWeightBuffer to_buffer = buffers[1 - from];
+            ConstPointWeightBuffer from_buffer = buffers[from];
+            step_graphs[from] = Kokkos::Experimental::create_graph(exec_space, [&](auto root)
+                                                                   { record_graph_step(root, to_buffer, from_buffer); });
+        }
+    }
+    else
+    {
+        throw std::runtime_error("StepMode::Graph is not supported by this scatter pattern");
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+ScatterGraphNode Solver<ScatterPattern, StorageScalar, ComputeScalar>::record_graph_step(ScatterGraphNode root, PointWeightBuffer to, ConstPointWeightBuffer from)
+{
+    if constexpr (pattern_supports_graph_v<ScatterPattern>)
+    {
+        // Same as swap_buffers() followed by compute_fused_step()
+        ScatterGraphNode cleared = root;
+        if (dirichlet_fill.extent(0) > 0)
+        {
+            auto fill = this->dirichlet_fill;
+            cleared = root.then_parallel_for(Kokkos::RangePolicy<>(0, to.extent(0)), KOKKOS_LAMBDA(int i) { to(i) = fill(i); });
+        }
+        else
+        {
+            cleared = root.then_parallel_for(Kokkos::RangePolicy<>(0, to.extent(0)), KOKKOS_LAMBDA(int i) { to(i) = 0; });
+        }
+        SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar> per_element_functor(to, from, point_mass_inv_readonly, mesh, k, dt, true, element_geometry);
+        return scatter_pattern.then_distribute_work(cleared, per_element_functor);
+    }
+    else
+    {
+        return root;
+    }
 }
 
-template <typename ScatterPattern>
-void Solver<ScatterPattern>::setup_initial_conditions()
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_initial_conditions()
 {
     // Manifest individual variables needed for capture-by-copy to avoid capturing
     // the "this" pointer.
-    auto point_coords = this->mesh.points;
+    auto mesh = this->mesh;
     auto current_points = this->current_point_weights;
     auto boundary = this->boundary;
 
-    Kokkos::parallel_for(mesh.point_count(), KOKKOS_LAMBDA(int i) {
-        Point p = point_coords(i);
+    if (options.tabulate_analytic)
+    {
+        // Only the zero-boundary part is tabulated; the polynomial is cheap to evaluate.
+        auto tabulated = this->tabulated_boundary;
+        auto factors = tabulated.time_factors(0);
+        bool with_polynomial = boundary.has_polynomial();
+        Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(int i) {
+            double value = tabulated(i, factors);
+            if (with_polynomial) {
+                auto p = mesh.point(i);
+                value += boundary.polynomial(p[0], p[1], 0);
+            }
+            current_points(i) = value; });
+        return;
+    }
+
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(int i) {
+        auto p = mesh.point(i);
         double x = p[0];
         double y = p[1];
         current_points(i) = boundary(x, y, 0); });
 }
 
-template <typename ScatterPattern>
-void Solver<ScatterPattern>::simulate_steps(int n_steps)
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::simulate_steps(int n_steps)
 {
+    if (options.step_mode == StepMode::Fused)
+    {
+        // Everything is queued on the same execution space instance, so the steps
+        // run in order without any host synchronization.
+        for (int i = 0; i < n_steps; i++)
+        {
+            n_total_steps++;
+            swap_buffers();
+            compute_fused_step();
+            if (boundary.is_time_dependent())
+            {
+                fix_boundary();
+            }
+        }
+        return;
+    }
+
+    if (options.step_mode == StepMode::Graph)
+    {
+        for (int i = 0; i < n_steps; i++)
+        {
+            n_total_steps++;
+            ScopedPhase phase(exec_space, "Solver::graph_step", sizeof(StorageScalar) * mesh.point_count() + element_pass_bytes(mesh.region_count()), mesh.region_count());
+            step_graphs[next_step_graph]->submit();
+            next_step_graph = 1 - next_step_graph;
+            // Keep the handles pointing at the same buffers as the replayed graph wrote.
+            swap_buffers(false);
+            if (boundary.is_time_dependent())
+            {
+                fix_boundary();
+            }
+        }
+        return;
+    }
+
+    if (options.step_mode == StepMode::Multirate)
+    {
+        for (int i = 0; i < n_steps; i++)
+        {
+            n_total_steps++;
+            compute_multirate_step();
+            if (boundary.is_time_dependent())
+            {
+                fix_boundary();
+            }
+        }
+        return;
+    }
+
+    if (options.step_mode == StepMode::TemporalBlocked)
+    {
+        // A shorter last block is fine, since the tiles have ghosts for a full one
+        for (int done = 0; done < n_steps; done += options.temporal_block_steps)
+        {
+            int block_steps = std::min(options.temporal_block_steps, n_steps - done);
+            n_total_steps += block_steps;
+            // Every point is written by its owning tile, so there is nothing to clear.
+            swap_buffers(false);
+            compute_temporal_block(block_steps);
+        }
+        return;
+    }
+
+    if (is_implicit())
+    {
+        for (int i = 0; i < n_steps; i++)
+        {
+            n_total_steps++;
+            // The solve overwrites the new state, starting from a copy of the previous one.
+            swap_buffers(false);
+            compute_implicit_step();
+        }
+        return;
+    }
+
+    if (options.step_mode == StepMode::AssembledSpMV)
+    {
+        for (int i = 0; i < n_steps; i++)
+        {
+            n_total_steps++;
+            // The SpMV overwrites the new state, so there is nothing to clear.
+            swap_buffers(false);
+            compute_spmv_step();
+            if (boundary.is_time_dependent())
+            {
+                fix_boundary();
+            }
+        }
+        return;
+    }
+
+    // No fences between the phases: launches on one instance run in order, and leaving the host
+    // free lets it queue work for solvers on other instances meanwhile.
     for (int i = 0; i < n_steps; i++)
     {
         n_total_steps++;
         prepare_next_step();
-        Kokkos::fence();
         compute_step();
-        Kokkos::fence();
-        fix_boundary();
-        Kokkos::fence();
+        if (uses_boundary_pass())
+        {
+            fix_boundary();
+        }
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::swap_buffers(bool clear_current)
+{
+    bool from_fill = clear_current && dirichlet_fill.extent(0) > 0;
+    ScopedPhase phase(exec_space, "Solver::swap_buffers", clear_current ? (from_fill ? 2.0 : 1.0) * sizeof(StorageScalar) * mesh.point_count() : 0);
+    // Only the view handles are swapped, the data stays where it is.
+    std::swap(current_point_weights, prev_point_weights);
+    prev_point_weights_readonly = prev_point_weights;
+    if (from_fill)
+    {
+        // Accumulated from scratch on top of the fixed boundary values
+        Kokkos::deep_copy(exec_space, current_point_weights, dirichlet_fill);
+    }
+    else if (clear_current)
+    {
+        // The new state is accumulated from scratch, which only needs a write-only fill.
+        Kokkos::deep_copy(exec_space, current_point_weights, StorageScalar(0));
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::compute_fused_step()
+{
+    ScopedPhase phase(exec_space, "Solver::compute_fused_step", element_pass_bytes(mesh.region_count()), mesh.region_count());
+    SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar> per_element_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, mesh, k, dt, true, element_geometry);
+    scatter_pattern.distribute_work(per_element_functor);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::compute_spmv_step()
+{
+    // Values and column indices once, row starts, and the two state vectors
+    double n_points = mesh.point_count();
+    double bytes = step_operator.nnz() * (sizeof(StorageScalar) + sizeof(int)) + (n_points + 1) * sizeof(int) + 2 * n_points * sizeof(StorageScalar);
+    ScopedPhase phase(exec_space, "Solver::compute_spmv_step", bytes, mesh.region_count());
+    KokkosSparse::spmv(exec_space, "N", StorageScalar(1), step_operator, prev_point_weights_readonly, StorageScalar(0), current_point_weights);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::compute_multirate_step()
+{
+    ScopedPhase phase(exec_space, "Solver::compute_multirate_step");
+    int n_substeps = 1 << (n_levels - 1);
+    for (int substep = 0; substep < n_substeps; substep++)
+    {
+        // Level l steps every 2^(n_levels - 1 - l) substeps, so the finest level is always due and
+        // the coarsest only at the start.
+        int min_level = n_levels - 1;
+        for (int stride = 1; min_level > 0 && substep % (2 * stride) == 0; stride *= 2)
+        {
+            min_level--;
+        }
+
+        // Points that are not due keep their value through the copy
+        prepare_next_step();
+        for (int level = min_level; level < n_levels; level++)
+        {
+            if (!level_patterns[level])
+            {
+                continue;
+            }
+            SolverImpl::MultirateContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar> per_element_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, point_levels, level_meshes[level], k, dt, min_level);
+            level_patterns[level]->distribute_work(per_element_functor);
+            // Each pass also reads the point levels
+            int n_elements = level_meshes[level].region_count();
+            phase.add_work(element_pass_bytes(n_elements) + sizeof(int) * mesh.point_count(), n_elements);
+        }
     }
 }
 
-template <typename ScatterPattern>
-void Solver<ScatterPattern>::prepare_next_step()
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::apply_implicit_operator(ConstPointWeightBuffer x, PointWeightBuffer y)
 {
+    if (options.assemble_implicit_operator)
+    {
+        double n_points = mesh.point_count();
+        double bytes = implicit_operator.nnz() * (sizeof(StorageScalar) + sizeof(int)) + (n_points + 1) * sizeof(int) + 2 * n_points * sizeof(StorageScalar);
+        ScopedPhase phase(exec_space, "Solver::apply_implicit_operator spmv", bytes);
+        KokkosSparse::spmv(exec_space, "N", StorageScalar(1), implicit_operator, x, StorageScalar(0), y);
+        return;
+    }
+    ScopedPhase phase(exec_space, "Solver::apply_implicit_operator", sizeof(StorageScalar) * mesh.point_count() + element_pass_bytes(mesh.region_count()), mesh.region_count());
+    // With the mask in place of the inverse mass and dt = -theta * dt, the fused element update
+    // adds exactly (M + theta*dt*k*S) x to the interior rows and nothing to the boundary rows.
+    Kokkos::deep_copy(exec_space, y, StorageScalar(0));
+    SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar> per_element_functor(y, x, implicit_mask, mesh, k, -implicit_theta() * dt, true);
+    scatter_pattern.distribute_work(per_element_functor);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::compute_implicit_step()
+{
+    // The CG iterations are phases of their own, so only count the elements advanced
+    ScopedPhase phase(exec_space, "Solver::compute_implicit_step", 0, mesh.region_count());
+    double theta = implicit_theta();
+    auto mesh = this->mesh;
+    auto point_mass_inv = this->point_mass_inv;
+    auto implicit_mask = this->implicit_mask;
+    auto prev_points = this->prev_point_weights_readonly;
+    auto residual = this->cg_residual;
+    auto product = this->cg_product;
+
+    // Right hand side (M - (1 - theta)*dt*k*S) u^n = (M u^n - (1 - theta) * A u^n) / theta, with
+    // A the system operator, on the interior rows. Boundary rows are left out of the solve.
+    if (theta < 1)
+    {
+        apply_implicit_operator(prev_points, product);
+    }
+    Kokkos::parallel_for("Solver::compute_implicit_step rhs", Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(int p) {
+        StorageScalar rhs = prev_points(p) / point_mass_inv(p);
+        if (theta < 1) {
+            rhs -= (1 - theta) * product(p);
+        }
+        residual(p) = implicit_mask(p) * rhs / theta; });
+    double rhs_norm = std::sqrt(KokkosBlas::dot(exec_space, residual, residual));
+
+    // Start from u^n with the new boundary values, which then stay put: the operator has no
+    // boundary rows, so neither the residual nor the search direction has boundary entries.
+    Kokkos::deep_copy(exec_space, current_point_weights, prev_point_weights);
+    fix_boundary();
+    apply_implicit_operator(current_point_weights, product);
+    KokkosBlas::axpy(exec_space, StorageScalar(-1), product, residual);
+
+    // Jacobi preconditioning by the lumped mass, the bulk of the system's diagonal
+    KokkosBlas::mult(exec_space, StorageScalar(0), cg_preconditioned, StorageScalar(1), point_mass_inv_readonly, residual);
+    Kokkos::deep_copy(exec_space, cg_search, cg_preconditioned);
+    double rz = KokkosBlas::dot(exec_space, residual, cg_preconditioned);
+    double rr = KokkosBlas::dot(exec_space, residual, residual);
+    int iteration = 0;
+    for (; std::sqrt(rr) > options.cg_tolerance * rhs_norm; iteration++)
+    {
+        if (iteration == options.cg_max_iterations)
+        {
+            throw std::runtime_error("Solver: CG did not converge in " + std::to_string(options.cg_max_iterations) + " iterations (relative residual " +
+                                     std::to_string(std::sqrt(rr) / rhs_norm) + ")");
+        }
+        apply_implicit_operator(cg_search, product);
+        double alpha = rz / KokkosBlas::dot(exec_space, cg_search, product);
+        KokkosBlas::axpy(exec_space, StorageScalar(alpha), cg_search, current_point_weights);
+        KokkosBlas::axpy(exec_space, StorageScalar(-alpha), product, residual);
+        KokkosBlas::mult(exec_space, StorageScalar(0), cg_preconditioned, StorageScalar(1), point_mass_inv_readonly, residual);
+        double rz_next = KokkosBlas::dot(exec_space, residual, cg_preconditioned);
+        rr = KokkosBlas::dot(exec_space, residual, residual);
+        KokkosBlas::axpby(exec_space, StorageScalar(1), cg_preconditioned, StorageScalar(rz_next / rz), cg_search);
+        rz = rz_next;
+    }
+    last_cg_iterations = iteration;
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::compute_temporal_block(int n_steps)
+{
+    // Each tile point's ID, value, inverse mass and coordinates, each tile element's vertices, and
+    // the owned points written back, once for the whole block
+    double n_tile_points = tile_point_ids.extent(0);
+    double bytes = n_tile_points * (sizeof(pointID) + 2 * sizeof(StorageScalar) + sizeof(typename MeshT::PointType)) +
+                   3.0 * sizeof(int) * tile_region_vertices.extent(0) + sizeof(StorageScalar) * mesh.point_count();
+    ScopedPhase phase(exec_space, "Solver::compute_temporal_block", bytes, (double)n_steps * mesh.region_count());
+    using BlockFunctor = SolverImpl::TemporalBlockFunctor<ScatterPattern, StorageScalar, ComputeScalar>;
+    BlockFunctor block_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, mesh,
+                               tile_point_starts, tile_owned_counts, tile_point_ids, tile_region_starts, tile_region_vertices,
+                               k, dt, n_steps, tile_scratch_level);
+    int n_tiles = tile_owned_counts.extent(0);
+    Kokkos::TeamPolicy<> policy(exec_space, n_tiles, Kokkos::AUTO);
+    policy.set_scratch_size(tile_scratch_level, Kokkos::PerTeam(BlockFunctor::scratch_bytes(max_tile_points, max_tile_regions)));
+    Kokkos::parallel_for("Solver::compute_temporal_block", policy, block_functor);
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::prepare_next_step()
+{
+    ScopedPhase phase(exec_space, "Solver::prepare_next_step", 2.0 * sizeof(StorageScalar) * mesh.point_count());
     // When we move to the next step, the current state becomes the previous state.
-    Kokkos::deep_copy(prev_point_weights, current_point_weights);
+    Kokkos::deep_copy(exec_space, prev_point_weights, current_point_weights);
 }
 
-template <typename ScatterPattern>
-void Solver<ScatterPattern>::compute_step()
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::compute_step()
 {
+    ScopedPhase phase(exec_space, "Solver::compute_step", element_pass_bytes(mesh.region_count()), mesh.region_count());
     // Dispatch element-wise contributions. The identity-matrix term already handled
     // as a precondition to calling this function.
-    SolverImpl::ElementContributionFunctor<ScatterPattern> per_element_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, mesh, k, dt);
+    SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar> per_element_functor(current_point_weights, prev_point_weights_readonly, point_mass_inv_readonly, mesh, k, dt, false, element_geometry);
     scatter_pattern.distribute_work(per_element_functor);
 }
 
-template <typename ScatterPattern>
-void Solver<ScatterPattern>::fix_boundary()
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::fix_boundary()
 {
+    // Point ID, its coordinates if the values are non-zero, and the write
+    bool with_polynomial = boundary.has_polynomial();
+    double point_bytes = sizeof(pointID) + sizeof(StorageScalar) + (with_polynomial ? sizeof(typename MeshT::PointType) : 0);
+    ScopedPhase phase(exec_space, "Solver::fix_boundary", mesh.n_boundary_points * point_bytes);
     auto mesh = this->mesh;
     auto current_points = this->current_point_weights;
-    // Set all points on a boundary edge to 0.
-    Kokkos::parallel_for(mesh.boundary_edge_count(), KOKKOS_LAMBDA(int i) {
-        auto edge_id = mesh.boundary_edges.entries(i);
-        auto e = mesh.edges(edge_id);
-        
-        // This will likely double-set every boundary point, but is more robust
-        // against errors like one edge of a segment being reversed and a point
-        // not getting set at all.
-        current_points(e[0]) = 0; 
-        current_points(e[1]) = 0; });
+    auto boundary = this->boundary;
+    double t = time();
+    // Each boundary point is listed once, so each gets exactly one write.
+    Kokkos::parallel_for("Solver::fix_boundary", Kokkos::RangePolicy<>(exec_space, 0, mesh.n_boundary_points), KOKKOS_LAMBDA(int i) {
+        pointID p = mesh.boundary_point_ids(i);
+        StorageScalar value = 0;
+        if (with_polynomial) {
+            auto pt = mesh.point(p);
+            value = boundary.polynomial(pt[0], pt[1], t);
+        }
+        current_points(p) = value; });
 }
 
-template <typename ScatterPattern>
-double Solver<ScatterPattern>::measure_error()
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+void Solver<ScatterPattern, StorageScalar, ComputeScalar>::setup_dirichlet_fill()
 {
+    // Time-dependent values are written by the boundary pass after each step instead
+    if (!uses_fused_update() || !boundary.has_polynomial() || boundary.is_time_dependent())
+    {
+        dirichlet_fill = Kokkos::View<StorageScalar *>();
+        return;
+    }
+    dirichlet_fill = Kokkos::View<StorageScalar *>("Dirichlet fill", mesh.point_count());
+    auto mesh = this->mesh;
+    auto dirichlet_fill = this->dirichlet_fill;
+    auto boundary = this->boundary;
+    Kokkos::parallel_for("Solver::setup_dirichlet_fill", Kokkos::RangePolicy<>(exec_space, 0, mesh.n_boundary_points), KOKKOS_LAMBDA(int i) {
+        pointID p = mesh.boundary_point_ids(i);
+        auto pt = mesh.point(p);
+        dirichlet_fill(p) = boundary.polynomial(pt[0], pt[1], 0); });
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+double Solver<ScatterPattern, StorageScalar, ComputeScalar>::measure_error()
+{
+    // The state and boundary flag of each point, plus its coordinates or tabulated factors
+    double n_points = mesh.point_count();
+    double analytic_bytes = options.tabulate_analytic ? n_points * boundary.term_count() * sizeof(double) : n_points * sizeof(typename MeshT::PointType);
+    ScopedPhase phase(exec_space, "Solver::measure_error", n_points * (sizeof(StorageScalar) + sizeof(typename MeshT::BoundaryPointIndicator::value_type)) + analytic_bytes);
     double t = time();
     auto mesh = this->mesh;
     auto current_points = this->current_point_weights;
     auto analytic = this->boundary;
     double interior_result = 0;
-    Kokkos::parallel_reduce(mesh.point_count(), KOKKOS_LAMBDA(const int &i, double &err_sum) {
+    if (options.tabulate_analytic)
+    {
+        auto tabulated = this->tabulated_boundary;
+        auto factors = tabulated.time_factors(t);
+        bool with_polynomial = analytic.has_polynomial();
+        Kokkos::parallel_reduce("Solver::measure_error tabulated", Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(const int &i, double &err_sum) {
+            if (!mesh.boundary_points(i)) {
+                double numerical_value = current_points(i);
+                double analytic_value = tabulated(i, factors);
+                if (with_polynomial) {
+                    auto p = mesh.point(i);
+                    analytic_value += analytic.polynomial(p[0], p[1], t);
+                }
+                err_sum += pow(analytic_value - numerical_value, 2);
+            } }, interior_result);
+        return (interior_result) / (mesh.point_count() - mesh.n_boundary_points);
+    }
+    Kokkos::parallel_reduce("Solver::measure_error", Kokkos::RangePolicy<>(exec_space, 0, mesh.point_count()), KOKKOS_LAMBDA(const int &i, double &err_sum) {
         if(!mesh.boundary_points(i)) { // only compute error for interior
-            Point p = mesh.points(i);
+            auto p = mesh.point(i);
             double numerical_value = current_points(i);
             double analytic_value = analytic(p[0], p[1], t);
             err_sum += pow(analytic_value - numerical_value, 2);} }, interior_result);
@@ -131,85 +1234,428 @@ double Solver<ScatterPattern>::measure_error()
     return (interior_result) / (mesh.point_count() - mesh.n_boundary_points);
 }
 
-KOKKOS_INLINE_FUNCTION double det_jacobian(Point pts[3])
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::MassMatrixFunctor<ScatterPattern, StorageScalar, ComputeScalar>::operator()(Region element, int slot) const
 {
-    return 0.25 * ((pts[2][0] - pts[1][0]) * (pts[0][1] - pts[1][1]) - (pts[0][0] - pts[1][0]) * (pts[2][1] - pts[1][1]));
+    ComputeScalar contributions[3];
+    element_contributions(element, slot, contributions);
+    for (int j = 0; j < 3; j++)
+    {
+        ScatterPattern::contribute(target(element[j]), static_cast<StorageScalar>(contributions[j]));
+    }
 }
 
-template <typename ScatterPattern>
-KOKKOS_INLINE_FUNCTION void SolverImpl::MassMatrixFunctor<ScatterPattern>::operator()(Region element) const
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::MassMatrixFunctor<ScatterPattern, StorageScalar, ComputeScalar>::element_contributions(Region element, int, ComputeScalar contributions[3]) const
 {
     // Fetch coordinates for the element
-    Point pts[3];
+    BasicPoint<ComputeScalar> pts[3];
     for (int j = 0; j < 3; j++)
     {
-        pts[j] = mesh.points(element[j]);
+        pts[j] = point_cast<ComputeScalar>(mesh.point(element[j]));
     }
 
     // compute |J| for this triangle
-    double jacob = det_jacobian(pts);
+    ComputeScalar jacob = det_jacobian(pts);
 
     // compute mass-lumped entries for the inverse of the mass matrix.
-    // The contribution is the sum of the main |J|/3 diagonal plus two |J|/6 off-diagonals for this element,
-    // and the contribution is the same for each point. (In the linear case).
-    double c = (jacob * 2 / 3);
+    ComputeScalar c = lumped_mass_contribution(jacob);
+    for (int j = 0; j < 3; j++)
+    {
+        contributions[j] = c;
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::ElementGeometryFunctor<ScatterPattern, StorageScalar, ComputeScalar>::operator()(Region element, int slot) const
+{
+    BasicPoint<ComputeScalar> pts[3];
     for (int j = 0; j < 3; j++)
     {
-        ScatterPattern::contribute(&inv_mass(element[j]), c);
+        pts[j] = point_cast<ComputeScalar>(mesh.point(element[j]));
+    }
+
+    ComputeScalar stiffness[6];
+    local_stiffness(pts, -k * dt, stiffness);
+    if (fold_identity)
+    {
+        // Same identity share as added in ElementContributionFunctor
+        ComputeScalar mass = lumped_mass_contribution(det_jacobian(pts));
+        for (int j = 0; j < 3; j++)
+        {
+            stiffness[packed_index(j, j)] += mass;
+        }
+    }
+    for (int c = 0; c < 6; c++)
+    {
+        geometry(slot, c) = static_cast<StorageScalar>(stiffness[c]);
     }
 }
 
-template <typename ScatterPattern>
-KOKKOS_INLINE_FUNCTION void SolverImpl::ElementContributionFunctor<ScatterPattern>::operator()(Region element) const
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::OperatorAssemblyFunctor<ScatterPattern, StorageScalar, ComputeScalar>::operator()(Region element, int) const
 {
+    BasicPoint<ComputeScalar> pts[3];
+    for (int j = 0; j < 3; j++)
+    {
+        pts[j] = point_cast<ComputeScalar>(mesh.point(element[j]));
+    }
+
+    ComputeScalar stiffness[6];
+    local_stiffness(pts, -k * dt, stiffness);
+    for (int j = 0; j < 3; j++)
+    {
+        int row = element[j];
+        ComputeScalar row_scale = inv_mass(row);
+        for (int i = 0; i < 3; i++)
+        {
+            // Rows are short, so a linear search for the column is fine for a one-time assembly.
+            for (int n = row_map(row); n < row_map(row + 1); n++)
+            {
+                if (entries(n) == element[i])
+                {
+                    ScatterPattern::contribute(&values(n), static_cast<StorageScalar>(row_scale * stiffness[packed_index(i, j)]));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>::operator()(Region element, int slot) const
+{
+    ComputeScalar contributions[3];
+    element_contributions(element, slot, contributions);
+    for (int j = 0; j < 3; j++)
+    {
+        ScatterPattern::contribute(target(element[j]), static_cast<StorageScalar>(contributions[j]));
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>::element_contributions(Region element, int slot, ComputeScalar contributions[3]) const
+{
+    if (geometry.extent(0) > 0)
+    {
+        // Cached path: only the previous values and the precomputed matrix are read.
+        // Any identity term is already on the diagonal.
+        ComputeScalar u[3];
+        for (int i = 0; i < 3; i++)
+        {
+            u[i] = prev_points(element[i]);
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            ComputeScalar c = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                c += geometry(slot, packed_index(i, j)) * u[i];
+            }
+            contributions[j] = inv_mass(element[j]) * c;
+        }
+        return;
+    }
+
     // Fetch coordinates for the element
-    Point pts[3];
+    BasicPoint<ComputeScalar> pts[3];
     for (int j = 0; j < 3; j++)
     {
-        pts[j] = mesh.points(element[j]);
+        pts[j] = point_cast<ComputeScalar>(mesh.point(element[j]));
     }
 
     // compute |J| for this triangle
-    double jacob = det_jacobian(pts);
+    ComputeScalar jacob = det_jacobian(pts);
 
     // compute entries in the vector S*c^n, where S is the stiffness matrix and c^n is the vector of coefficients from the n-th time step
     // Calculate change-of-variable partial derivatives
-    double dx_de = 0.5 * (pts[2][0] - pts[1][0]); // point 2 switched with 0
-    double dx_dn = 0.5 * (pts[0][0] - pts[1][0]); // ""
-    double dy_de = 0.5 * (pts[2][1] - pts[1][1]); // ""
-    double dy_dn = 0.5 * (pts[0][1] - pts[1][1]); // ""
+    ComputeScalar dx_de = ComputeScalar(0.5) * (pts[2][0] - pts[1][0]); // point 2 switched with 0
+    ComputeScalar dx_dn = ComputeScalar(0.5) * (pts[0][0] - pts[1][0]); // ""
+    ComputeScalar dy_de = ComputeScalar(0.5) * (pts[2][1] - pts[1][1]); // ""
+    ComputeScalar dy_dn = ComputeScalar(0.5) * (pts[0][1] - pts[1][1]); // ""
     // Calculate gradients
-    double du_de = 0.5 * (prev_points(element[2]) - prev_points(element[1]));
-    double du_dn = 0.5 * (prev_points(element[0]) - prev_points(element[1]));
-    double du_dx = (1 / jacob) * (dy_dn * du_de - dy_de * du_dn);
-    double du_dy = (1 / jacob) * (-dx_dn * du_de + dx_de * du_dn);
+    ComputeScalar du_de = ComputeScalar(0.5) * (static_cast<ComputeScalar>(prev_points(element[2])) - prev_points(element[1]));
+    ComputeScalar du_dn = ComputeScalar(0.5) * (static_cast<ComputeScalar>(prev_points(element[0])) - prev_points(element[1]));
+    ComputeScalar du_dx = (1 / jacob) * (dy_dn * du_de - dy_de * du_dn);
+    ComputeScalar du_dy = (1 / jacob) * (-dx_dn * du_de + dx_de * du_dn);
     // Based on gradients, calculate interaction
     for (int j = 0; j < 3; j++)
     {
-        double dp_dx;
-        double dp_dy;
+        ComputeScalar dp_dx;
+        ComputeScalar dp_dy;
         switch (j)
         {
         case 0:
-            dp_dx = (0.5 / jacob) * (-dy_de);
-            dp_dy = (0.5 / jacob) * (dx_de);
+            dp_dx = (ComputeScalar(0.5) / jacob) * (-dy_de);
+            dp_dy = (ComputeScalar(0.5) / jacob) * (dx_de);
             break;
         case 1:
-            dp_dx = (0.5 / jacob) * (-dy_dn + dy_de);
-            dp_dy = (0.5 / jacob) * (dx_dn - dx_de);
+            dp_dx = (ComputeScalar(0.5) / jacob) * (-dy_dn + dy_de);
+            dp_dy = (ComputeScalar(0.5) / jacob) * (dx_dn - dx_de);
             break;
         case 2:
-            dp_dx = (0.5 / jacob) * (dy_dn);
-            dp_dy = (0.5 / jacob) * (-dx_dn);
+            dp_dx = (ComputeScalar(0.5) / jacob) * (dy_dn);
+            dp_dy = (ComputeScalar(0.5) / jacob) * (-dx_dn);
+        }
+
+        ComputeScalar c = 2 * jacob * (dp_dx * du_dx + dp_dy * du_dy);
+        ComputeScalar contribution = -k * dt * inv_mass(element[j]) * c;
+        if (fold_identity)
+        {
+            // The lumped mass of a point is the sum of its elements' contributions, so adding this
+            // element's share of M^-1 * M * u^n over all elements recovers the identity term.
+            contribution += inv_mass(element[j]) * lumped_mass_contribution(jacob) * prev_points(element[j]);
+        }
+        contributions[j] = contribution;
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+template <typename SimdT>
+KOKKOS_INLINE_FUNCTION void SolverImpl::ElementContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>::simd_element_contributions(const Region elements[], const int slots[], SimdT contributions[3]) const
+{
+    // Same arithmetic as element_contributions, in the same order, with one element per lane.
+    // The gathers are generator constructors, which compilers turn into gather instructions
+    // where the target has them.
+    SimdT u[3];
+    SimdT m[3];
+    for (int i = 0; i < 3; i++)
+    {
+        u[i] = SimdT([&](std::size_t l)
+                     { return static_cast<ComputeScalar>(prev_points(elements[l][i])); });
+        m[i] = SimdT([&](std::size_t l)
+                     { return static_cast<ComputeScalar>(inv_mass(elements[l][i])); });
+    }
+
+    if (geometry.extent(0) > 0)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            SimdT c(ComputeScalar(0));
+            for (int i = 0; i < 3; i++)
+            {
+                SimdT g([&](std::size_t l)
+                        { return static_cast<ComputeScalar>(geometry(slots[l], packed_index(i, j))); });
+                c = c + g * u[i];
+            }
+            contributions[j] = m[j] * c;
+        }
+        return;
+    }
+
+    SimdT x[3];
+    SimdT y[3];
+    for (int i = 0; i < 3; i++)
+    {
+        x[i] = SimdT([&](std::size_t l)
+                     { return static_cast<ComputeScalar>(mesh.point(elements[l][i])[0]); });
+        y[i] = SimdT([&](std::size_t l)
+                     { return static_cast<ComputeScalar>(mesh.point(elements[l][i])[1]); });
+    }
+
+    const SimdT half(ComputeScalar(0.5));
+    SimdT jacob = SimdT(ComputeScalar(0.25)) * ((x[2] - x[1]) * (y[0] - y[1]) - (x[0] - x[1]) * (y[2] - y[1]));
+    SimdT dx_de = half * (x[2] - x[1]);
+    SimdT dx_dn = half * (x[0] - x[1]);
+    SimdT dy_de = half * (y[2] - y[1]);
+    SimdT dy_dn = half * (y[0] - y[1]);
+    SimdT du_de = half * (u[2] - u[1]);
+    SimdT du_dn = half * (u[0] - u[1]);
+    SimdT inv_jacob = SimdT(ComputeScalar(1)) / jacob;
+    SimdT du_dx = inv_jacob * (dy_dn * du_de - dy_de * du_dn);
+    SimdT du_dy = inv_jacob * (-dx_dn * du_de + dx_de * du_dn);
+    // Basis gradients for each vertex, written out in place of the switch
+    SimdT half_inv_jacob = half / jacob;
+    SimdT dp_dx[3] = {half_inv_jacob * (-dy_de), half_inv_jacob * (-dy_dn + dy_de), half_inv_jacob * dy_dn};
+    SimdT dp_dy[3] = {half_inv_jacob * dx_de, half_inv_jacob * (dx_dn - dx_de), half_inv_jacob * (-dx_dn)};
+    const SimdT scale(-k * dt);
+    for (int j = 0; j < 3; j++)
+    {
+        SimdT c = SimdT(ComputeScalar(2)) * jacob * (dp_dx[j] * du_dx + dp_dy[j] * du_dy);
+        SimdT contribution = scale * m[j] * c;
+        if (fold_identity)
+        {
+            // lumped_mass_contribution, lane-wise
+            contribution = contribution + m[j] * (jacob * SimdT(ComputeScalar(2)) / SimdT(ComputeScalar(3))) * u[j];
         }
+        contributions[j] = contribution;
+    }
+}
 
-        double c = 2 * jacob * (dp_dx * du_dx + dp_dy * du_dy);
-        double contribution = -k * dt * inv_mass(element[j]) * c;
-        ScatterPattern::contribute(&new_points(element[j]), contribution);
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::MultirateContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>::operator()(Region element, int slot) const
+{
+    ComputeScalar contributions[3];
+    element_contributions(element, slot, contributions);
+    for (int j = 0; j < 3; j++)
+    {
+        if (point_levels(element[j]) >= min_level)
+        {
+            ScatterPattern::contribute(target(element[j]), static_cast<StorageScalar>(contributions[j]));
+        }
     }
 }
 
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::MultirateContributionFunctor<ScatterPattern, StorageScalar, ComputeScalar>::element_contributions(Region element, int, ComputeScalar contributions[3]) const
+{
+    BasicPoint<ComputeScalar> pts[3];
+    ComputeScalar u[3];
+    for (int j = 0; j < 3; j++)
+    {
+        pts[j] = point_cast<ComputeScalar>(mesh.point(element[j]));
+        u[j] = prev_points(element[j]);
+    }
+
+    ComputeScalar stiffness[6];
+    local_stiffness(pts, ComputeScalar(1), stiffness);
+    for (int j = 0; j < 3; j++)
+    {
+        int level = point_levels(element[j]);
+        if (level < min_level)
+        {
+            // Not due this substep
+            contributions[j] = 0;
+            continue;
+        }
+        ComputeScalar c = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            c += stiffness[packed_index(j, i)] * u[i];
+        }
+        contributions[j] = -k * (dt / (1 << level)) * inv_mass(element[j]) * c;
+    }
+}
+
+template <typename ScatterPattern, typename StorageScalar, typename ComputeScalar>
+KOKKOS_INLINE_FUNCTION void SolverImpl::TemporalBlockFunctor<ScatterPattern, StorageScalar, ComputeScalar>::operator()(const member_type &team) const
+{
+    int tile = team.league_rank();
+    int point_start = tile_point_starts(tile);
+    int n_points = tile_point_starts(tile + 1) - point_start;
+    int region_start = tile_region_starts(tile);
+    int n_regions = tile_region_starts(tile + 1) - region_start;
+    ScratchScalars values[2] = {ScratchScalars(team.team_scratch(scratch_level), n_points), ScratchScalars(team.team_scratch(scratch_level), n_points)};
+    ScratchScalars inv_masses(team.team_scratch(scratch_level), n_points);
+    ScratchCoords coords(team.team_scratch(scratch_level), n_points);
+    ScratchRegions regions(team.team_scratch(scratch_level), n_regions);
+
+    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, n_points), [&](int i) {
+        pointID p = tile_point_ids(point_start + i);
+        auto pt = mesh.point(p);
+        values[0](i) = prev_points(p);
+        inv_masses(i) = inv_mass(p);
+        coords(i, 0) = pt[0];
+        coords(i, 1) = pt[1]; });
+    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, n_regions), [&](int r) {
+        for (int j = 0; j < 3; j++) {
+            regions(r, j) = tile_region_vertices(region_start + r, j);
+        } });
+    team.team_barrier();
+
+    for (int step = 0; step < n_steps; step++)
+    {
+        ScratchScalars from = values[step % 2];
+        ScratchScalars to = values[1 - step % 2];
+        // The identity term, then each element adds its stiffness terms as in the CopyAndFix step
+        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, n_points), [&](int i) { to(i) = from(i); });
+        team.team_barrier();
+        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, n_regions), [&](int r) {
+            BasicPoint<ComputeScalar> pts[3];
+            ComputeScalar u[3];
+            for (int j = 0; j < 3; j++) {
+                pts[j][0] = coords(regions(r, j), 0);
+                pts[j][1] = coords(regions(r, j), 1);
+                u[j] = from(regions(r, j));
+            }
+            ComputeScalar stiffness[6];
+            local_stiffness(pts, -k * dt, stiffness);
+            for (int j = 0; j < 3; j++) {
+                ComputeScalar c = 0;
+                for (int i = 0; i < 3; i++) {
+                    c += stiffness[packed_index(i, j)] * u[i];
+                }
+                Kokkos::atomic_add(&to(regions(r, j)), inv_masses(regions(r, j)) * c);
+            } });
+        team.team_barrier();
+    }
+
+    // Owned points come first, and are exact after all n_steps
+    ScratchScalars result = values[n_steps % 2];
+    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, tile_owned_counts(tile)), [&](int i) { //
+        new_points(tile_point_ids(point_start + i)) = static_cast<StorageScalar>(result(i));
+    });
+}
+
+template <class MeshT>
+Kokkos::View<double *> TFEM::element_stable_timesteps(MeshT mesh, double k, Kokkos::DefaultExecutionSpace space)
+{
+    Kokkos::View<double *> timesteps("Element stable timesteps", mesh.region_count());
+    Kokkos::parallel_for(
+        Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int r) {
+        Region element = mesh.region(r);
+        BasicPoint<double> pts[3];
+        for (int j = 0; j < 3; j++) {
+            pts[j] = point_cast<double>(mesh.point(element[j]));
+        }
+        timesteps(r) = 2 / (k * element_stiffness_bound(pts)); });
+    return timesteps;
+}
+
+template <class MeshT>
+double TFEM::stable_timestep(MeshT mesh, double k, double safety, Kokkos::DefaultExecutionSpace space)
+{
+    double min_timestep;
+    Kokkos::parallel_reduce(
+        Kokkos::RangePolicy<>(space, 0, mesh.region_count()), KOKKOS_LAMBDA(int r, double &partial) {
+        Region element = mesh.region(r);
+        BasicPoint<double> pts[3];
+        for (int j = 0; j < 3; j++) {
+            pts[j] = point_cast<double>(mesh.point(element[j]));
+        }
+        partial = Kokkos::fmin(partial, 2 / (k * element_stiffness_bound(pts))); }, Kokkos::Min<double>(min_timestep));
+    return safety * min_timestep;
+}
+
 // We need to specify what classes we might be using so the linker doesn't get mad
 template class Solver<ColoredElementScatterAdd>;
 template class Solver<AtomicElementScatterAdd>;
-template class Solver<SerialElementScatterAdd>;
\ No newline at end of file
+template class Solver<SerialElementScatterAdd>;
+template class Solver<GatherElementScatterAdd>;
+template class Solver<SoAColoredElementScatterAdd>;
+template class Solver<SoAAtomicElementScatterAdd>;
+template class Solver<SoASerialElementScatterAdd>;
+template class Solver<SoAGatherElementScatterAdd>;
+// Reduced precision variants, see solver.hpp
+template class Solver<ColoredElementScatterAdd, float, double>;
+template class Solver<AtomicElementScatterAdd, float, double>;
+template class Solver<GatherElementScatterAdd, float, double>;
+template class Solver<FloatColoredElementScatterAdd, float, double>;
+template class Solver<FloatColoredElementScatterAdd, float, float>;
+template class Solver<FloatAtomicElementScatterAdd, float, double>;
+template class Solver<FloatAtomicElementScatterAdd, float, float>;
+template class Solver<FloatGatherElementScatterAdd, float, float>;
+template class Solver<SoAFloatColoredElementScatterAdd, float, double>;
+template class Solver<SoAFloatColoredElementScatterAdd, float, float>;
+// Compact regions
+template class Solver<CompactColoredElementScatterAdd>;
+template class Solver<CompactAtomicElementScatterAdd>;
+template class Solver<CompactFloatColoredElementScatterAdd, float, float>;
+// 32 bit unsigned vertex IDs
+template class Solver<UInt32ColoredElementScatterAdd>;
+template class Solver<UInt32AtomicElementScatterAdd>;
+
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceMesh>(DeviceMesh, double, Kokkos::DefaultExecutionSpace);
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceSoAMesh>(DeviceSoAMesh, double, Kokkos::DefaultExecutionSpace);
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceFloatMesh>(DeviceFloatMesh, double, Kokkos::DefaultExecutionSpace);
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceSoAFloatMesh>(DeviceSoAFloatMesh, double, Kokkos::DefaultExecutionSpace);
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceCompactMesh>(DeviceCompactMesh, double, Kokkos::DefaultExecutionSpace);
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceCompactFloatMesh>(DeviceCompactFloatMesh, double, Kokkos::DefaultExecutionSpace);
+template Kokkos::View<double *> TFEM::element_stable_timesteps<DeviceUInt32Mesh>(DeviceUInt32Mesh, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceMesh>(DeviceMesh, double, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceSoAMesh>(DeviceSoAMesh, double, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceFloatMesh>(DeviceFloatMesh, double, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceSoAFloatMesh>(DeviceSoAFloatMesh, double, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceCompactMesh>(DeviceCompactMesh, double, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceCompactFloatMesh>(DeviceCompactFloatMesh, double, double, Kokkos::DefaultExecutionSpace);
+template double TFEM::stable_timestep<DeviceUInt32Mesh>(DeviceUInt32Mesh, double, double, Kokkos::DefaultExecutionSpace);
@@ -1,140 +1,447 @@
 #include "mesh.hpp"
+#include "instrumentation.hpp"
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <vector>
 #include <random>
+#include <charconv> // from_chars
+#include <climits>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
 #include <utility> // pair, etc
 
 using namespace TFEM;
 using namespace std;
 
-std::default_random_engine rnd{std::random_device{}()};
-uniform_real_distribution<double> dist(-1.0, 1.0);
-// Reasonable heuristic for unit circle random. Not quite uniform, since we remap the corners.
-std::pair<double, double> unit_circle_almost_random()
+namespace
 {
+    // Number of lines handed to each parallel work item when parsing the large sections
+    const int LINES_PER_CHUNK = 4096;
 
-    double x = dist(rnd);
-    double y = dist(rnd);
+    inline void skip_blanks(const char *&cursor, const char *end)
+    {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+        {
+            cursor++;
+        }
+    }
 
-    // this will deform the distribution a little bit but unimportant for our use case.
-    double rad = sqrt(pow(x, 2) + pow(y, 2));
-    if (rad > 1.0)
+    // Moves the cursor to the start of the next line (or the end of the buffer)
+    inline void skip_line(const char *&cursor, const char *end)
     {
-        double rescale = dist(rnd) / rad;
-        x = x * rescale;
-        y = y * rescale;
+        const char *eol = static_cast<const char *>(memchr(cursor, '\n', end - cursor));
+        cursor = eol ? eol + 1 : end;
     }
-    return std::make_pair(x, y);
-}
 
-void TFEM::load_meshes_from_grd_file(string fname, DeviceMesh &device_mesh, DeviceMesh::HostMirrorMesh &host_mesh, bool fuzz)
-{
-    ifstream input_file(fname);
-    stringstream line_stream;
-    // Read first line, get sizes, then initialize device view, then create host mirror. Read into
-    // host mirror, then deep copy it back to the device view
-    string cur_line;
-    string string_buff;
-    int line_no = 0;
+    template <typename T>
+    inline bool parse_number(const char *&cursor, const char *end, T &value)
+    {
+        skip_blanks(cursor, end);
+        auto result = from_chars(cursor, end, value);
+        if (result.ec != errc())
+        {
+            return false;
+        }
+        cursor = result.ptr;
+        return true;
+    }
 
-    pointID n_points;
-    int n_edges;
-    int n_regions;
-    double fuzz_radius = 0.0;
+    // Consumes the given label (i.e. "npnt:") if it is the next token
+    inline bool parse_label(const char *&cursor, const char *end, const char *label)
+    {
+        skip_blanks(cursor, end);
+        size_t len = strlen(label);
+        if (end - cursor < (ptrdiff_t)len || strncmp(cursor, label, len) != 0)
+        {
+            return false;
+        }
+        cursor += len;
+        return true;
+    }
 
-    // Read header
-    getline(input_file, cur_line);
-    line_no++;
-    line_stream = stringstream(cur_line);
-    line_stream >> string_buff;
-    assert(string_buff == "npnt:");
-    line_stream >> n_points;
-    line_stream >> string_buff;
-    assert(string_buff == "nseg:");
-    line_stream >> n_edges;
-    line_stream >> string_buff;
-    assert(string_buff == "ntri:");
-    line_stream >> n_regions;
-
-    // if fuzz, assume a square grid on [-1, 1]^2 and calculate a safe fuzzing radius
-    if (fuzz)
+    /**
+     * Parses a line of the form "<id>: <v_0> ... <v_N-1>" and leaves the cursor at the
+     * start of the next line, whether or not parsing succeeded.
+     */
+    template <typename T, int N>
+    inline bool parse_entry_line(const char *&cursor, const char *end, int &read_id, T (&values)[N])
     {
-        double grid_square_size = 2.0 / (sqrt(n_points) - 1);
-        fuzz_radius = grid_square_size / 4; // could go up to sqrt(2)/4, but no need
+        bool ok = parse_number(cursor, end, read_id) && parse_label(cursor, end, ":");
+        for (int v = 0; v < N && ok; v++)
+        {
+            ok = parse_number(cursor, end, values[v]);
+        }
+        skip_line(cursor, end);
+        return ok;
     }
 
-    // Create the meshes!
-    device_mesh = DeviceMesh(n_points, n_edges, n_regions);
-    host_mesh = device_mesh.create_host_mirror();
+    /**
+     * Describes where a section of n_lines entry lines sits in the file buffer. Every LINES_PER_CHUNK-th
+     * line start is recorded so that chunks can be parsed independently.
+     */
+    struct Section
+    {
+        int n_lines;
+        int first_line_no; // 1-based line number of the first entry, for error messages
+        std::vector<size_t> chunk_starts; // n_chunks + 1 offsets, the last one being the end of the section
+    };
 
-    // Read into host mesh
-    // point coords
-    for (pointID p_id = 0; p_id < n_points; p_id++)
+    /**
+     * Walks over n_lines lines starting at offset pos, and fills in the chunk boundaries. Returns the offset
+     * just past the section.
+     */
+    size_t scan_section(const string &buffer, size_t pos, int n_lines, int first_line_no, Section &section)
     {
-        getline(input_file, cur_line);
-        line_no++;
-        line_stream = stringstream(cur_line);
+        const char *cursor = buffer.data() + pos;
+        const char *end = buffer.data() + buffer.size();
+        section.n_lines = n_lines;
+        section.first_line_no = first_line_no;
+        section.chunk_starts.clear();
+        for (int line = 0; line < n_lines; line++)
+        {
+            if (cursor >= end)
+            {
+                throw runtime_error(string("Unexpected end of file at line ") + to_string(first_line_no + line));
+            }
+            if (line % LINES_PER_CHUNK == 0)
+            {
+                section.chunk_starts.push_back(cursor - buffer.data());
+            }
+            skip_line(cursor, end);
+        }
+        section.chunk_starts.push_back(cursor - buffer.data());
+        return cursor - buffer.data();
+    }
 
-        pointID read_point_id;
-        line_stream >> read_point_id;
-        if (read_point_id != p_id)
+    /**
+     * Parses every entry line of the section in parallel on the host, handing the ID and values of each line
+     * to store(id, values). The IDs must count up from id_offset in order; store gets them relative to it.
+     *
+     * Exceptions can't escape a parallel region, so the first bad line is found with a min-reduction and the
+     * error is reported afterwards.
+     */
+    template <typename T, int N, typename StoreFunc>
+    void parse_section(const string &buffer, const Section &section, StoreFunc store, int id_offset = 0)
+    {
+        int n_chunks = section.chunk_starts.size() - 1;
+        int first_bad_entry = INT_MAX;
+        Kokkos::parallel_reduce(
+            "Parse mesh section", Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, n_chunks), [&](int chunk, int &bad_entry)
+            {
+                const char *cursor = buffer.data() + section.chunk_starts[chunk];
+                const char *end = buffer.data() + section.chunk_starts[chunk + 1];
+                int first_id = chunk * LINES_PER_CHUNK;
+                int last_id = std::min(first_id + LINES_PER_CHUNK, section.n_lines);
+                for (int id = first_id; id < last_id; id++)
+                {
+                    int read_id;
+                    T values[N];
+                    if (!parse_entry_line(cursor, end, read_id, values) || read_id != id_offset + id)
+                    {
+                        // Later lines of this chunk can't be the first error
+                        bad_entry = std::min(bad_entry, id);
+                        return;
+                    }
+                    store(id, values);
+                } },
+            Kokkos::Min<int>(first_bad_entry));
+
+        if (first_bad_entry == INT_MAX)
         {
-            throw runtime_error((string("Found unexpected / out-of-order ID at line ") + to_string(line_no)) + ": " + to_string(read_point_id));
+            return;
         }
-        // flush out the ":"
-        line_stream >> string_buff;
 
-        // Read point
-        line_stream >> host_mesh.points(p_id)[0];
-        line_stream >> host_mesh.points(p_id)[1];
+        // Re-parse the offending line to find out what went wrong
+        const char *cursor = buffer.data() + section.chunk_starts[first_bad_entry / LINES_PER_CHUNK];
+        const char *end = buffer.data() + buffer.size();
+        for (int skip = 0; skip < first_bad_entry % LINES_PER_CHUNK; skip++)
+        {
+            skip_line(cursor, end);
+        }
+        int line_no = section.first_line_no + first_bad_entry;
+        int read_id = -1;
+        if (parse_number(cursor, end, read_id) && read_id != id_offset + first_bad_entry)
+        {
+            throw runtime_error((string("Found unexpected / out-of-order ID at line ") + to_string(line_no)) + ": " + to_string(read_id));
+        }
+        throw runtime_error(string("Could not parse entry at line ") + to_string(line_no));
     }
-    // edge ID's
-    for (int e_id = 0; e_id < n_edges; e_id++)
+
+    /**
+     * Reads a file a given number of lines at a time, so only the lines being parsed are held
+     * in memory (plus whatever of the next line was read along with them).
+     */
+    class LineChunkReader
     {
-        getline(input_file, cur_line);
-        line_no++;
-        line_stream = stringstream(cur_line);
+    protected:
+        static const size_t READ_BLOCK_BYTES = 1 << 22;
+        ifstream input_file;
+        string pending;
+        size_t bytes_read = 0;
 
-        int read_edge_id;
-        line_stream >> read_edge_id;
-        if (read_edge_id != e_id)
+    public:
+        LineChunkReader(string fname)
+            : input_file(fname, ios::binary)
         {
-            throw runtime_error((string("Found unexpected / out-of-order ID at line ") + to_string(line_no)) + ": " + to_string(read_edge_id));
+            if (!input_file)
+            {
+                throw runtime_error("Could not open mesh file " + fname);
+            }
         }
-        // flush out the ":"
-        line_stream >> string_buff;
-        line_stream >> host_mesh.edges(e_id)[0] >> host_mesh.edges(e_id)[1];
-    }
-    // region ID's
-    for (int r_id = 0; r_id < n_regions; r_id++)
+
+        /**
+         * Replaces the contents of out with the next n_lines lines (a last line without a newline
+         * counts). Returns how many lines there were, fewer than n_lines only at the end of the file.
+         */
+        int read_lines(int n_lines, string &out)
+        {
+            out.swap(pending);
+            pending.clear();
+            size_t pos = 0;
+            int found = 0;
+            while (found < n_lines)
+            {
+                const char *eol = static_cast<const char *>(memchr(out.data() + pos, '\n', out.size() - pos));
+                if (eol)
+                {
+                    pos = eol - out.data() + 1;
+                    found++;
+                    continue;
+                }
+                if (!input_file)
+                {
+                    if (pos < out.size())
+                    {
+                        pos = out.size();
+                        found++;
+                    }
+                    break;
+                }
+                size_t old_size = out.size();
+                out.resize(old_size + READ_BLOCK_BYTES);
+                input_file.read(&out[old_size], READ_BLOCK_BYTES);
+                out.resize(old_size + input_file.gcount());
+                bytes_read += input_file.gcount();
+            }
+            pending.assign(out, pos, string::npos);
+            out.resize(pos);
+            return found;
+        }
+
+        size_t total_bytes_read() const { return bytes_read; }
+    };
+
+    // Chunk staging views, one row per entry line
+    template <typename T, int N>
+    using PinnedChunk = Kokkos::View<T *[N], Kokkos::LayoutRight, PinnedHostSpace>;
+    template <typename T, int N>
+    using DeviceChunk = Kokkos::View<T *[N], Kokkos::LayoutRight>;
+
+    /**
+     * Writes an uploaded chunk of point coordinates into the mesh, in either layout.
+     */
+    template <class MeshT>
+    struct PointChunkScatter
     {
-        getline(input_file, cur_line);
-        line_no++;
-        line_stream = stringstream(cur_line);
+        MeshT mesh;
+        DeviceChunk<double, 2> chunk;
+        int first_id;
+
+        PointChunkScatter(MeshT mesh, DeviceChunk<double, 2> chunk, int first_id)
+            : mesh(mesh), chunk(chunk), first_id(first_id)
+        { // Pretty much just the initializer list
+        }
+
+        KOKKOS_INLINE_FUNCTION void operator()(int i) const
+        {
+            for (int dim = 0; dim < 2; dim++)
+            {
+                mesh.coord(first_id + i, dim) = chunk(i, dim);
+            }
+        }
+    };
+
+    template <class MeshT>
+    struct EdgeChunkScatter
+    {
+        MeshT mesh;
+        DeviceChunk<pointID, 2> chunk;
+        int first_id;
+
+        EdgeChunkScatter(MeshT mesh, DeviceChunk<pointID, 2> chunk, int first_id)
+            : mesh(mesh), chunk(chunk), first_id(first_id)
+        { // Pretty much just the initializer list
+        }
+
+        KOKKOS_INLINE_FUNCTION void operator()(int i) const
+        {
+            for (int end = 0; end < 2; end++)
+            {
+                mesh.edges(first_id + i)[end] = chunk(i, end);
+            }
+        }
+    };
+
+    template <class MeshT>
+    struct RegionChunkScatter
+    {
+        MeshT mesh;
+        DeviceChunk<pointID, 3> chunk;
+        int first_id;
+
+        RegionChunkScatter(MeshT mesh, DeviceChunk<pointID, 3> chunk, int first_id)
+            : mesh(mesh), chunk(chunk), first_id(first_id)
+        { // Pretty much just the initializer list
+        }
+
+        KOKKOS_INLINE_FUNCTION void operator()(int i) const
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                mesh.vertex(first_id + i, j) = chunk(i, j);
+            }
+        }
+    };
+
+    /**
+     * Streams one section of n_lines entry lines into the mesh through a ring of staging buffers,
+     * one per copy space. Scatter<MeshT> writes an uploaded chunk into the mesh. line_no is the
+     * file line number of the first entry, and is advanced past the section.
+     */
+    template <typename T, int N, template <class> class Scatter, class MeshT>
+    void stream_section(LineChunkReader &reader, MeshT &mesh, int n_lines, int &line_no, const MeshStreamOptions &options,
+                        std::vector<Kokkos::DefaultExecutionSpace> &copy_spaces, string &text)
+    {
+        int n_buffers = copy_spaces.size();
+        std::vector<PinnedChunk<T, N>> host_chunks;
+        std::vector<DeviceChunk<T, N>> device_chunks;
+        for (int b = 0; b < n_buffers && b * options.chunk_lines < n_lines; b++)
+        {
+            int rows = std::min(options.chunk_lines, n_lines);
+            host_chunks.push_back(PinnedChunk<T, N>("Mesh staging chunk", rows));
+            device_chunks.push_back(DeviceChunk<T, N>("Mesh device chunk", rows));
+        }
 
-        int read_region_id;
-        line_stream >> read_region_id;
-        if (read_region_id != r_id)
+        Section section;
+        for (int first_id = 0, chunk = 0; first_id < n_lines; first_id += options.chunk_lines, chunk++)
         {
-            throw runtime_error((string("Found unexpected / out-of-order ID at line ") + to_string(line_no)) + ": " + to_string(read_region_id));
+            int chunk_size = std::min(options.chunk_lines, n_lines - first_id);
+            if (reader.read_lines(chunk_size, text) < chunk_size)
+            {
+                throw runtime_error(string("Unexpected end of file at line ") + to_string(line_no + chunk_size));
+            }
+            scan_section(text, 0, chunk_size, line_no, section);
+
+            // Wait for this buffer's previous upload before parsing over it
+            int b = chunk % host_chunks.size();
+            copy_spaces[b].fence();
+            auto host_chunk = host_chunks[b];
+            parse_section<T, N>(text, section, [&](int id, T(&values)[N])
+                                {
+                for (int v = 0; v < N; v++)
+                {
+                    host_chunk(id, v) = values[v];
+                } },
+                                first_id);
+
+            auto range = Kokkos::pair<int, int>(0, chunk_size);
+            auto device_chunk = Kokkos::subview(device_chunks[b], range, Kokkos::ALL);
+            Kokkos::deep_copy(copy_spaces[b], device_chunk, Kokkos::subview(host_chunk, range, Kokkos::ALL));
+            Kokkos::parallel_for("stream_mesh_from_grd_file scatter", Kokkos::RangePolicy<Kokkos::DefaultExecutionSpace>(copy_spaces[b], 0, chunk_size),
+                                 Scatter<MeshT>(mesh, device_chunks[b], first_id));
+            line_no += chunk_size;
         }
-        // flush out the ":"
-        line_stream >> string_buff;
-        line_stream >> host_mesh.regions(r_id)[0] >> host_mesh.regions(r_id)[1] >> host_mesh.regions(r_id)[2];
+        // The staging buffers go away with this call
+        for (auto &space : copy_spaces)
+        {
+            space.fence();
+        }
+    }
+}
+
+template <class MeshT>
+void TFEM::load_meshes_from_grd_file(string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, bool fuzz)
+{
+    // Traffic is the file size, filled in once it is known
+    ScopedPhase phase("load_meshes_from_grd_file");
+    // Read the whole file into a single buffer. Everything after this works on
+    // offsets into the buffer and writes straight into the mesh views.
+    ifstream input_file(fname, ios::binary);
+    if (!input_file)
+    {
+        throw runtime_error("Could not open mesh file " + fname);
     }
+    input_file.seekg(0, ios::end);
+    string buffer(static_cast<size_t>(input_file.tellg()), '\0');
+    input_file.seekg(0, ios::beg);
+    input_file.read(&buffer[0], buffer.size());
+
+    const char *cursor = buffer.data();
+    const char *end = buffer.data() + buffer.size();
+
+    pointID n_points;
+    int n_edges;
+    int n_regions;
+
+    // Read header
+    if (!(parse_label(cursor, end, "npnt:") && parse_number(cursor, end, n_points) &&
+          parse_label(cursor, end, "nseg:") && parse_number(cursor, end, n_edges) &&
+          parse_label(cursor, end, "ntri:") && parse_number(cursor, end, n_regions)))
+    {
+        throw runtime_error("Could not parse mesh header at line 1");
+    }
+    skip_line(cursor, end);
+    phase.add_work(buffer.size(), n_regions);
+
+    // Pre-scan: find where each of the sections start and split them into chunks
+    Section point_section, edge_section, region_section;
+    size_t pos = cursor - buffer.data();
+    int line_no = 2;
+    pos = scan_section(buffer, pos, n_points, line_no, point_section);
+    line_no += n_points;
+    pos = scan_section(buffer, pos, n_edges, line_no, edge_section);
+    line_no += n_edges;
+    pos = scan_section(buffer, pos, n_regions, line_no, region_section);
+    line_no += n_regions;
+
+    // Create the meshes! The sizes are known up front, so parse straight into the host mirror.
+    device_mesh = MeshT(n_points, n_edges, n_regions);
+    host_mesh = device_mesh.create_host_mirror();
+
+    // point coords
+    parse_section<double, 2>(buffer, point_section, [&](int id, double(&coords)[2])
+                             {
+        host_mesh.coord(id, 0) = coords[0];
+        host_mesh.coord(id, 1) = coords[1]; });
+    // edge ID's
+    auto edges = host_mesh.edges;
+    parse_section<pointID, 2>(buffer, edge_section, [&](int id, pointID(&ends)[2])
+                              {
+        edges(id)[0] = ends[0];
+        edges(id)[1] = ends[1]; });
+    // region ID's
+    parse_section<pointID, 3>(buffer, region_section, [&](int id, pointID(&vertices)[3])
+                              {
+        for (int j = 0; j < 3; j++)
+        {
+            host_mesh.vertex(id, j) = vertices[j];
+        } });
     // copy over to device
     host_mesh.deep_copy_all_to(device_mesh);
 
-    // Special handling of boundary edges
-    getline(input_file, cur_line);
-    line_no++;
-    line_stream = stringstream(cur_line);
+    // Special handling of boundary edges. This block is small, so parse serially.
     // line should read nebd: <n_boundary_segments>
+    cursor = buffer.data() + pos;
     int n_boundary_segments;
-    line_stream >> string_buff >> n_boundary_segments;
-    std::vector<std::vector<int>> boundary_segments(n_boundary_segments);
+    if (!(parse_label(cursor, end, "nebd:") && parse_number(cursor, end, n_boundary_segments)))
+    {
+        throw runtime_error(string("Could not parse boundary segment count at line ") + to_string(line_no));
+    }
+    skip_line(cursor, end);
+    line_no++;
+    std::vector<int> segment_starts(1, 0);
+    std::vector<int> boundary_edge_ids;
     // For each boundary segment, we expect two header lines followed by segment edges, i.e.
     // idnum: <i>
     // number: <n_edges_in_segment>
@@ -143,60 +450,251 @@ void TFEM::load_meshes_from_grd_file(string fname, DeviceMesh &device_mesh, Devi
     // ...
     for (int seg = 0; seg < n_boundary_segments; seg++)
     {
-        getline(input_file, cur_line);
-        line_no++;
         // Don't care about first header right now so skip to next
-        getline(input_file, cur_line);
+        skip_line(cursor, end);
         line_no++;
-        line_stream = stringstream(cur_line);
         int n_edges_in_segment;
-        line_stream >> string_buff >> n_edges_in_segment;
+        if (!(parse_label(cursor, end, "number:") && parse_number(cursor, end, n_edges_in_segment)))
+        {
+            throw runtime_error(string("Could not parse boundary segment size at line ") + to_string(line_no));
+        }
+        skip_line(cursor, end);
+        line_no++;
         for (int i = 0; i < n_edges_in_segment; i++)
         {
-            getline(input_file, cur_line);
+            int read_index;
+            int edge_id[1];
+            if (!parse_entry_line(cursor, end, read_index, edge_id))
+            {
+                throw runtime_error(string("Could not parse boundary edge at line ") + to_string(line_no));
+            }
             line_no++;
-            line_stream = stringstream(cur_line);
-
-            int edge_id;
-            line_stream >> string_buff >> edge_id;
-            boundary_segments[seg].push_back(edge_id);
+            boundary_edge_ids.push_back(edge_id[0]);
         }
+        segment_starts.push_back(boundary_edge_ids.size());
     }
 
     // Construct the graph
-    device_mesh.boundary_edges = Kokkos::create_staticcrsgraph<DeviceMesh::BoundaryEdgeMap>("Boundary edge segments", boundary_segments);
-    host_mesh.boundary_edges = Kokkos::create_staticcrsgraph<DeviceMesh::HostMirrorMesh::BoundaryEdgeMap>("Boundary edge segments", boundary_segments);
+    device_mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::BoundaryEdgeMap>("Boundary edge segments", segment_starts.data(), n_boundary_segments, boundary_edge_ids.data());
+    host_mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::HostMirrorMesh::BoundaryEdgeMap>("Boundary edge segments", segment_starts.data(), n_boundary_segments, boundary_edge_ids.data());
 
-    // track which points are boundaries and which are not. Fuzz points that are not, list points that are.
-    host_mesh.boundary_points = DeviceMesh::HostMirrorMesh::BoundaryPointIndicator("Boundary edge flags", host_mesh.point_count());
+    // track which points are boundaries and which are not.
+    host_mesh.boundary_points = typename MeshT::HostMirrorMesh::BoundaryPointIndicator("Boundary edge flags", host_mesh.point_count());
     Kokkos::deep_copy(host_mesh.boundary_points, false);
-    device_mesh.boundary_points = DeviceMesh::BoundaryPointIndicator("Boundary edge flags", host_mesh.point_count());
+    device_mesh.boundary_points = typename MeshT::BoundaryPointIndicator("Boundary edge flags", host_mesh.point_count());
 
-    Kokkos::parallel_for(Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, host_mesh.boundary_edge_count()), KOKKOS_LAMBDA(int i) {
+    Kokkos::parallel_for("load_meshes_from_grd_file boundary flags", Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, host_mesh.boundary_edge_count()), KOKKOS_LAMBDA(int i) {
         Edge e = host_mesh.edges(host_mesh.boundary_edges.entries(i));
         host_mesh.boundary_points(e[0]) = true;
-        host_mesh.boundary_points(e[0] = true); });
+        host_mesh.boundary_points(e[1]) = true; });
 
-    host_mesh.n_boundary_points = 0;
+    MeshImpl::set_boundary_point_ids(device_mesh, host_mesh);
 
-    for (int pointID = 0; pointID < host_mesh.point_count(); pointID++)
+    if (fuzz)
     {
-        if (host_mesh.boundary_points(pointID))
-        {
-            host_mesh.n_boundary_points++;
-        }
-        else if (fuzz)
-        {
-            // fuzz
-            Point &point = host_mesh.points(pointID);
-            auto displacement = unit_circle_almost_random();
-            point[0] += fuzz_radius * displacement.first;
-            point[1] += fuzz_radius * displacement.second;
-        }
+        MeshImpl::fuzz_interior_points(host_mesh, std::random_device{}());
     }
     // Deep copy point displacements
     Kokkos::deep_copy(device_mesh.points, host_mesh.points);
     // Copy point boundary keys
     Kokkos::deep_copy(device_mesh.boundary_points, host_mesh.boundary_points);
-    device_mesh.n_boundary_points = host_mesh.n_boundary_points;
-}
\ No newline at end of file
+}
+
+template <class MeshT>
+void TFEM::stream_mesh_from_grd_file(string fname, MeshT &device_mesh, bool fuzz, MeshStreamOptions options)
+{
+    ScopedPhase phase("stream_mesh_from_grd_file");
+    if (options.chunk_lines < 1 || options.n_buffers < 1)
+    {
+        throw invalid_argument("stream_mesh_from_grd_file: chunk_lines and n_buffers must be positive");
+    }
+    LineChunkReader reader(fname);
+    string text;
+    const char *cursor;
+    const char *end;
+
+    pointID n_points;
+    int n_edges;
+    int n_regions;
+    reader.read_lines(1, text);
+    cursor = text.data();
+    end = text.data() + text.size();
+    if (!(parse_label(cursor, end, "npnt:") && parse_number(cursor, end, n_points) &&
+          parse_label(cursor, end, "nseg:") && parse_number(cursor, end, n_edges) &&
+          parse_label(cursor, end, "ntri:") && parse_number(cursor, end, n_regions)))
+    {
+        throw runtime_error("Could not parse mesh header at line 1");
+    }
+    int line_no = 2;
+
+    device_mesh = MeshT(n_points, n_edges, n_regions);
+    std::vector<Kokkos::DefaultExecutionSpace> copy_spaces;
+    for (int b = 0; b < options.n_buffers; b++)
+    {
+        copy_spaces.push_back(Kokkos::Experimental::partition_space(Kokkos::DefaultExecutionSpace(), 1)[0]);
+    }
+    stream_section<double, 2, PointChunkScatter>(reader, device_mesh, n_points, line_no, options, copy_spaces, text);
+    stream_section<pointID, 2, EdgeChunkScatter>(reader, device_mesh, n_edges, line_no, options, copy_spaces, text);
+    stream_section<pointID, 3, RegionChunkScatter>(reader, device_mesh, n_regions, line_no, options, copy_spaces, text);
+
+    // The boundary section is small, so read and parse it a line at a time.
+    auto next_line = [&]()
+    {
+        if (reader.read_lines(1, text) < 1)
+        {
+            throw runtime_error(string("Unexpected end of file at line ") + to_string(line_no));
+        }
+        cursor = text.data();
+        end = text.data() + text.size();
+    };
+    next_line();
+    int n_boundary_segments;
+    if (!(parse_label(cursor, end, "nebd:") && parse_number(cursor, end, n_boundary_segments)))
+    {
+        throw runtime_error(string("Could not parse boundary segment count at line ") + to_string(line_no));
+    }
+    line_no++;
+    std::vector<int> segment_starts(1, 0);
+    std::vector<int> boundary_edge_ids;
+    for (int seg = 0; seg < n_boundary_segments; seg++)
+    {
+        // Skip the "idnum:" line, as the other loader does
+        next_line();
+        line_no++;
+        next_line();
+        int n_edges_in_segment;
+        if (!(parse_label(cursor, end, "number:") && parse_number(cursor, end, n_edges_in_segment)))
+        {
+            throw runtime_error(string("Could not parse boundary segment size at line ") + to_string(line_no));
+        }
+        line_no++;
+        for (int i = 0; i < n_edges_in_segment; i++)
+        {
+            next_line();
+            int read_index;
+            int edge_id[1];
+            if (!parse_entry_line(cursor, end, read_index, edge_id))
+            {
+                throw runtime_error(string("Could not parse boundary edge at line ") + to_string(line_no));
+            }
+            line_no++;
+            boundary_edge_ids.push_back(edge_id[0]);
+        }
+        segment_starts.push_back(boundary_edge_ids.size());
+    }
+    phase.add_work(reader.total_bytes_read(), n_regions);
+    device_mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::BoundaryEdgeMap>("Boundary edge segments", segment_starts.data(), n_boundary_segments, boundary_edge_ids.data());
+
+    // Boundary flags straight from the uploaded edges
+    device_mesh.boundary_points = typename MeshT::BoundaryPointIndicator("Boundary edge flags", n_points);
+    auto mesh = device_mesh;
+    Kokkos::parallel_for("stream_mesh_from_grd_file boundary flags", device_mesh.boundary_edge_count(), KOKKOS_LAMBDA(int i) {
+        Edge e = mesh.edges(mesh.boundary_edges.entries(i));
+        mesh.boundary_points(e[0]) = true;
+        mesh.boundary_points(e[1]) = true; });
+    MeshImpl::set_boundary_point_ids(device_mesh);
+
+    if (fuzz)
+    {
+        MeshImpl::fuzz_interior_points_device(device_mesh, std::random_device{}());
+    }
+    Kokkos::fence();
+}
+
+template <class MeshT>
+void TFEM::MeshImpl::fuzz_interior_points_device(MeshT &mesh, uint64_t seed)
+{
+    // Same radius and displacements as on the host
+    double grid_square_size = 2.0 / (sqrt(mesh.point_count()) - 1);
+    double fuzz_radius = grid_square_size / 4;
+
+    auto mesh_copy = mesh;
+    Kokkos::parallel_for("fuzz_interior_points_device", mesh.point_count(), KOKKOS_LAMBDA(int p) {
+        if (mesh_copy.boundary_points(p)) {
+            return;
+        }
+        double x;
+        double y;
+        fuzz_displacement(seed, p, x, y);
+        mesh_copy.coord(p, 0) += fuzz_radius * x;
+        mesh_copy.coord(p, 1) += fuzz_radius * y; });
+}
+
+template <class HostMeshT>
+void TFEM::MeshImpl::fuzz_interior_points(HostMeshT &host_mesh, uint64_t seed)
+{
+    // Assume a square grid on [-1, 1]^2 and calculate a safe fuzzing radius
+    double grid_square_size = 2.0 / (sqrt(host_mesh.point_count()) - 1);
+    double fuzz_radius = grid_square_size / 4; // could go up to sqrt(2)/4, but no need
+
+    // Fuzz points that are not on the boundary, leave the ones that are. Each point draws its
+    // own counters, so the points are independent.
+    Kokkos::parallel_for("fuzz_interior_points", Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, host_mesh.point_count()), KOKKOS_LAMBDA(int p) {
+        if (!host_mesh.boundary_points(p)) {
+            double x;
+            double y;
+            fuzz_displacement(seed, p, x, y);
+            host_mesh.coord(p, 0) += fuzz_radius * x;
+            host_mesh.coord(p, 1) += fuzz_radius * y;
+        } });
+}
+
+template <class MeshT>
+void TFEM::load_meshes_from_file(string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, bool fuzz)
+{
+    string extension = fname.substr(fname.find_last_of('.') + 1);
+    if (extension == "tfm")
+    {
+        load_meshes_from_binary_file(fname, device_mesh, host_mesh, fuzz);
+    }
+    else
+    {
+        load_meshes_from_grd_file(fname, device_mesh, host_mesh, fuzz);
+    }
+}
+
+template <class MeshT>
+uint64_t TFEM::mesh_connectivity_hash(MeshT &mesh)
+{
+    auto host_regions = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), mesh.regions);
+
+    uint64_t hash = 14695981039346656037ull; // FNV offset basis
+    auto mix = [&hash](int64_t value)
+    {
+        for (int byte = 0; byte < 8; byte++)
+        {
+            hash ^= (value >> (8 * byte)) & 0xff;
+            hash *= 1099511628211ull; // FNV prime
+        }
+    };
+    mix(mesh.point_count());
+    mix(mesh.region_count());
+    for (int r = 0; r < mesh.region_count(); r++)
+    {
+        Region element = load_region(host_regions, r);
+        for (int j = 0; j < 3; j++)
+        {
+            mix(element[j]);
+        }
+    }
+    return hash;
+}
+
+// Instantiate the loaders for both mesh layouts
+template void TFEM::load_meshes_from_grd_file<DeviceMesh>(string, DeviceMesh &, DeviceMesh::HostMirrorMesh &, bool);
+template void TFEM::load_meshes_from_grd_file<DeviceSoAMesh>(string, DeviceSoAMesh &, DeviceSoAMesh::HostMirrorMesh &, bool);
+template void TFEM::stream_mesh_from_grd_file<DeviceMesh>(string, DeviceMesh &, bool, MeshStreamOptions);
+template void TFEM::stream_mesh_from_grd_file<DeviceSoAMesh>(string, DeviceSoAMesh &, bool, MeshStreamOptions);
+template void TFEM::load_meshes_from_file<DeviceMesh>(string, DeviceMesh &, DeviceMesh::HostMirrorMesh &, bool);
+template void TFEM::load_meshes_from_file<DeviceSoAMesh>(string, DeviceSoAMesh &, DeviceSoAMesh::HostMirrorMesh &, bool);
+template void TFEM::MeshImpl::fuzz_interior_points<DeviceMesh::HostMirrorMesh>(DeviceMesh::HostMirrorMesh &, uint64_t);
+template void TFEM::MeshImpl::fuzz_interior_points<DeviceSoAMesh::HostMirrorMesh>(DeviceSoAMesh::HostMirrorMesh &, uint64_t);
+template void TFEM::MeshImpl::fuzz_interior_points_device<DeviceMesh>(DeviceMesh &, uint64_t);
+template void TFEM::MeshImpl::fuzz_interior_points_device<DeviceSoAMesh>(DeviceSoAMesh &, uint64_t);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceMesh>(DeviceMesh &);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceSoAMesh>(DeviceSoAMesh &);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceFloatMesh>(DeviceFloatMesh &);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceSoAFloatMesh>(DeviceSoAFloatMesh &);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceCompactMesh>(DeviceCompactMesh &);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceCompactFloatMesh>(DeviceCompactFloatMesh &);
+template uint64_t TFEM::mesh_connectivity_hash<DeviceUInt32Mesh>(DeviceUInt32Mesh &);
@@ -0,0 +1,382 @@
+#include "mesh.hpp"
+#include "instrumentation.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// POSIX memory mapping
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace TFEM;
+using namespace std;
+
+namespace
+{
+    const char MESH_BINARY_TAG[8] = {'T', 'F', 'E', 'M', 'M', 'S', 'H', '\0'};
+    const uint32_t MESH_BINARY_VERSION = 1;
+
+    // Order of the sections following the header
+    enum MeshSection
+    {
+        POINTS_SECTION = 0,
+        EDGES_SECTION,
+        REGIONS_SECTION,
+        SEGMENT_STARTS_SECTION,
+        BOUNDARY_EDGES_SECTION,
+        BOUNDARY_FLAGS_SECTION,
+        N_SECTIONS
+    };
+
+    struct MeshBinaryHeader
+    {
+        char tag[8];
+        uint32_t version;
+        uint32_t header_bytes;
+        int64_t n_points;
+        int64_t n_edges;
+        int64_t n_regions;
+        int64_t n_boundary_segments;
+        int64_t n_boundary_edges;
+        int64_t n_boundary_points;
+        uint64_t section_offsets[N_SECTIONS];
+        uint64_t section_bytes[N_SECTIONS];
+    };
+
+    // The raw structs are written straight to disk, so they must be plain data.
+    static_assert(std::is_trivially_copyable_v<Point>, "Points are copied as raw bytes");
+    static_assert(std::is_trivially_copyable_v<Edge>, "Edges are copied as raw bytes");
+    static_assert(std::is_trivially_copyable_v<Region>, "Regions are copied as raw bytes");
+    static_assert(sizeof(bool) == 1, "Boundary flags are stored one byte per point");
+
+    uint64_t align_up(uint64_t offset)
+    {
+        return (offset + MESH_BINARY_ALIGNMENT - 1) / MESH_BINARY_ALIGNMENT * MESH_BINARY_ALIGNMENT;
+    }
+
+    // Fill in the section sizes and offsets from the counts in the header.
+    void layout_sections(MeshBinaryHeader &header)
+    {
+        header.section_bytes[POINTS_SECTION] = header.n_points * sizeof(Point);
+        header.section_bytes[EDGES_SECTION] = header.n_edges * sizeof(Edge);
+        header.section_bytes[REGIONS_SECTION] = header.n_regions * sizeof(Region);
+        header.section_bytes[SEGMENT_STARTS_SECTION] = (header.n_boundary_segments + 1) * sizeof(int32_t);
+        header.section_bytes[BOUNDARY_EDGES_SECTION] = header.n_boundary_edges * sizeof(int32_t);
+        header.section_bytes[BOUNDARY_FLAGS_SECTION] = header.n_points * sizeof(uint8_t);
+
+        uint64_t offset = align_up(sizeof(MeshBinaryHeader));
+        for (int s = 0; s < N_SECTIONS; s++)
+        {
+            header.section_offsets[s] = offset;
+            offset = align_up(offset + header.section_bytes[s]);
+        }
+    }
+
+    // Check that every ID stored in the sections refers to an entry that exists, so a
+    // corrupt file is rejected here rather than read out of bounds by the solver.
+    void validate_section_ids(const MeshBinaryHeader &header, const char *mesh_data, const string &fname)
+    {
+        auto corrupt = [&](const string &what, int64_t i)
+        { return runtime_error("Binary mesh file " + fname + " has an out-of-range " + what + " at entry " + to_string(i)); };
+        const char *edges = mesh_data + header.section_offsets[EDGES_SECTION];
+        for (int64_t i = 0; i < header.n_edges; i++)
+        {
+            Edge e;
+            memcpy(&e, edges + i * sizeof(Edge), sizeof(Edge));
+            if (e[0] < 0 || e[0] >= header.n_points || e[1] < 0 || e[1] >= header.n_points)
+            {
+                throw corrupt("edge endpoint", i);
+            }
+        }
+        const char *regions = mesh_data + header.section_offsets[REGIONS_SECTION];
+        for (int64_t i = 0; i < header.n_regions; i++)
+        {
+            Region r;
+            memcpy(&r, regions + i * sizeof(Region), sizeof(Region));
+            for (int j = 0; j < 3; j++)
+            {
+                if (r[j] < 0 || r[j] >= header.n_points)
+                {
+                    throw corrupt("region vertex", i);
+                }
+            }
+        }
+        const char *segment_starts = mesh_data + header.section_offsets[SEGMENT_STARTS_SECTION];
+        int32_t previous_start = 0;
+        for (int64_t i = 0; i <= header.n_boundary_segments; i++)
+        {
+            int32_t start;
+            memcpy(&start, segment_starts + i * sizeof(int32_t), sizeof(int32_t));
+            if ((i == 0 && start != 0) || start < previous_start || start > header.n_boundary_edges)
+            {
+                throw corrupt("boundary segment start", i);
+            }
+            previous_start = start;
+        }
+        const char *boundary_edge_ids = mesh_data + header.section_offsets[BOUNDARY_EDGES_SECTION];
+        for (int64_t i = 0; i < header.n_boundary_edges; i++)
+        {
+            int32_t id;
+            memcpy(&id, boundary_edge_ids + i * sizeof(int32_t), sizeof(int32_t));
+            if (id < 0 || id >= header.n_edges)
+            {
+                throw corrupt("boundary edge ID", i);
+            }
+        }
+    }
+
+    /**
+     * Read-only memory mapping of a whole file, unmapped when it goes out of scope.
+     */
+    class MappedFile
+    {
+    public:
+        const char *data;
+        size_t size;
+
+        MappedFile(const string &fname) : data(nullptr), size(0)
+        {
+            int fd = open(fname.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw runtime_error("Could not open binary mesh file " + fname);
+            }
+            struct stat file_stats;
+            if (fstat(fd, &file_stats) != 0)
+            {
+                close(fd);
+                throw runtime_error("Could not stat binary mesh file " + fname);
+            }
+            size = file_stats.st_size;
+            void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            // The mapping keeps its own reference to the file
+            close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                throw runtime_error("Could not memory-map binary mesh file " + fname);
+            }
+            // Every section is read front to back exactly once
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            madvise(mapping, size, MADV_WILLNEED);
+            data = static_cast<const char *>(mapping);
+        }
+
+        ~MappedFile()
+        {
+            munmap(const_cast<char *>(data), size);
+        }
+    };
+}
+
+template <class MeshT>
+void TFEM::load_meshes_from_binary_file(string fname, MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, bool fuzz, uint64_t file_offset)
+{
+    ScopedPhase phase("load_meshes_from_binary_file");
+    MappedFile file(fname);
+
+    // Validate the header before trusting any of the offsets
+    if (file.size < file_offset || file.size - file_offset < sizeof(MeshBinaryHeader))
+    {
+        throw runtime_error("Binary mesh file " + fname + " is too small to contain a header");
+    }
+    // Everything below is relative to where the mesh starts
+    const char *mesh_data = file.data + file_offset;
+    uint64_t mesh_size = file.size - file_offset;
+    MeshBinaryHeader header;
+    memcpy(&header, mesh_data, sizeof(MeshBinaryHeader));
+    if (memcmp(header.tag, MESH_BINARY_TAG, sizeof(MESH_BINARY_TAG)) != 0)
+    {
+        throw runtime_error("File " + fname + " is not a binary mesh file");
+    }
+    if (header.version != MESH_BINARY_VERSION || header.header_bytes != sizeof(MeshBinaryHeader))
+    {
+        throw runtime_error("Binary mesh file " + fname + " has unsupported version " + to_string(header.version));
+    }
+    if (header.n_points < 0 || header.n_edges < 0 || header.n_regions < 0 || header.n_boundary_segments < 0 ||
+        header.n_boundary_edges < 0 || header.n_boundary_points < 0)
+    {
+        throw runtime_error("Binary mesh file " + fname + " has negative entity counts");
+    }
+    MeshBinaryHeader expected_layout = header;
+    layout_sections(expected_layout);
+    for (int s = 0; s < N_SECTIONS; s++)
+    {
+        if (header.section_offsets[s] != expected_layout.section_offsets[s] ||
+            header.section_bytes[s] != expected_layout.section_bytes[s] ||
+            header.section_offsets[s] + header.section_bytes[s] > mesh_size)
+        {
+            throw runtime_error("Binary mesh file " + fname + " is truncated or corrupt (section " + to_string(s) + ")");
+        }
+    }
+    validate_section_ids(header, mesh_data, fname);
+    auto section = [&](int s)
+    { return mesh_data + header.section_offsets[s]; };
+    phase.add_work(mesh_size, header.n_regions);
+
+    // Create the meshes! When the host and device share memory the host
+    // mirror is the device mesh, so the copies below land in place.
+    device_mesh = MeshT(header.n_points, header.n_edges, header.n_regions);
+    host_mesh = device_mesh.create_host_mirror();
+
+    memcpy(host_mesh.edges.data(), section(EDGES_SECTION), header.section_bytes[EDGES_SECTION]);
+    if constexpr (MeshT::is_soa)
+    {
+        // The file is stored as structs, so points and regions need to be split into columns
+        const char *points = section(POINTS_SECTION);
+        const char *regions = section(REGIONS_SECTION);
+        Kokkos::parallel_for(
+            "Transpose binary mesh", Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0, std::max(header.n_points, header.n_regions)), [&](int64_t i)
+            {
+                if (i < header.n_points)
+                {
+                    Point p;
+                    memcpy(&p, points + i * sizeof(Point), sizeof(Point));
+                    host_mesh.coord(i, 0) = p[0];
+                    host_mesh.coord(i, 1) = p[1];
+                }
+                if (i < header.n_regions)
+                {
+                    Region r;
+                    memcpy(&r, regions + i * sizeof(Region), sizeof(Region));
+                    for (int j = 0; j < 3; j++)
+                    {
+                        host_mesh.vertex(i, j) = r[j];
+                    }
+                } });
+    }
+    else
+    {
+        memcpy(host_mesh.points.data(), section(POINTS_SECTION), header.section_bytes[POINTS_SECTION]);
+        memcpy(host_mesh.regions.data(), section(REGIONS_SECTION), header.section_bytes[REGIONS_SECTION]);
+    }
+
+    // Boundary segments are stored as a plain CSR
+    const int32_t *segment_starts = reinterpret_cast<const int32_t *>(section(SEGMENT_STARTS_SECTION));
+    const int32_t *boundary_edge_ids = reinterpret_cast<const int32_t *>(section(BOUNDARY_EDGES_SECTION));
+    if (segment_starts[header.n_boundary_segments] != header.n_boundary_edges)
+    {
+        throw runtime_error("Binary mesh file " + fname + " has inconsistent boundary segments");
+    }
+    device_mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::BoundaryEdgeMap>("Boundary edge segments", segment_starts, header.n_boundary_segments, boundary_edge_ids);
+    host_mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::HostMirrorMesh::BoundaryEdgeMap>("Boundary edge segments", segment_starts, header.n_boundary_segments, boundary_edge_ids);
+
+    // Boundary point flags were computed when the file was written
+    device_mesh.boundary_points = typename MeshT::BoundaryPointIndicator("Boundary edge flags", header.n_points);
+    host_mesh.boundary_points = Kokkos::create_mirror_view(device_mesh.boundary_points);
+    memcpy(host_mesh.boundary_points.data(), section(BOUNDARY_FLAGS_SECTION), header.section_bytes[BOUNDARY_FLAGS_SECTION]);
+    MeshImpl::set_boundary_point_ids(device_mesh, host_mesh);
+    if (host_mesh.n_boundary_points != header.n_boundary_points)
+    {
+        throw runtime_error("Binary mesh file " + fname + " has inconsistent boundary flags");
+    }
+
+    if (fuzz)
+    {
+        MeshImpl::fuzz_interior_points(host_mesh, std::random_device{}());
+    }
+
+    // copy over to device (no-ops when the host mirror aliases the device views)
+    host_mesh.deep_copy_all_to(device_mesh);
+    Kokkos::deep_copy(device_mesh.boundary_points, host_mesh.boundary_points);
+}
+
+template <class HostMeshT>
+void TFEM::save_mesh_to_binary_file(string fname, HostMeshT &host_mesh)
+{
+    ofstream out_file(fname, ios::binary);
+    if (!out_file)
+    {
+        throw runtime_error("Could not open " + fname + " for writing");
+    }
+    save_mesh_to_binary_file(out_file, host_mesh);
+    if (!out_file)
+    {
+        throw runtime_error("Failed while writing binary mesh file " + fname);
+    }
+}
+
+template <class HostMeshT>
+uint64_t TFEM::save_mesh_to_binary_file(ostream &out_file, HostMeshT &host_mesh)
+{
+    MeshBinaryHeader header = {};
+    memcpy(header.tag, MESH_BINARY_TAG, sizeof(MESH_BINARY_TAG));
+    header.version = MESH_BINARY_VERSION;
+    header.header_bytes = sizeof(MeshBinaryHeader);
+    header.n_points = host_mesh.point_count();
+    header.n_edges = host_mesh.edge_count();
+    header.n_regions = host_mesh.region_count();
+    header.n_boundary_segments = host_mesh.boundary_edges.numRows();
+    header.n_boundary_edges = host_mesh.boundary_edge_count();
+    header.n_boundary_points = host_mesh.n_boundary_points;
+    layout_sections(header);
+
+    // The graph's index types are not necessarily 32 bit, so convert them on the way out
+    std::vector<int32_t> segment_starts(header.n_boundary_segments + 1);
+    std::vector<int32_t> boundary_edge_ids(header.n_boundary_edges);
+    for (int s = 0; s <= header.n_boundary_segments; s++)
+    {
+        segment_starts[s] = host_mesh.boundary_edges.row_map(s);
+    }
+    for (int i = 0; i < header.n_boundary_edges; i++)
+    {
+        boundary_edge_ids[i] = host_mesh.boundary_edges.entries(i);
+    }
+
+    // The file always stores points and regions as structs
+    const char *point_data = reinterpret_cast<const char *>(host_mesh.points.data());
+    const char *region_data = reinterpret_cast<const char *>(host_mesh.regions.data());
+    std::vector<Point> points;
+    std::vector<Region> regions;
+    if constexpr (HostMeshT::is_soa)
+    {
+        points.resize(header.n_points);
+        regions.resize(header.n_regions);
+        for (int i = 0; i < header.n_points; i++)
+        {
+            points[i] = host_mesh.point(i);
+        }
+        for (int i = 0; i < header.n_regions; i++)
+        {
+            regions[i] = host_mesh.region(i);
+        }
+        point_data = reinterpret_cast<const char *>(points.data());
+        region_data = reinterpret_cast<const char *>(regions.data());
+    }
+
+    const char *section_data[N_SECTIONS] = {
+        point_data,
+        reinterpret_cast<const char *>(host_mesh.edges.data()),
+        region_data,
+        reinterpret_cast<const char *>(segment_starts.data()),
+        reinterpret_cast<const char *>(boundary_edge_ids.data()),
+        reinterpret_cast<const char *>(host_mesh.boundary_points.data())};
+
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(MeshBinaryHeader));
+    uint64_t written = sizeof(MeshBinaryHeader);
+    const char padding[MESH_BINARY_ALIGNMENT] = {};
+    for (int s = 0; s < N_SECTIONS; s++)
+    {
+        out_file.write(padding, header.section_offsets[s] - written);
+        out_file.write(section_data[s], header.section_bytes[s]);
+        written = header.section_offsets[s] + header.section_bytes[s];
+    }
+    if (!out_file)
+    {
+        throw runtime_error("Failed while writing binary mesh");
+    }
+    return written;
+}
+
+// Instantiate for both mesh layouts
+template void TFEM::load_meshes_from_binary_file<DeviceMesh>(string, DeviceMesh &, DeviceMesh::HostMirrorMesh &, bool, uint64_t);
+template void TFEM::load_meshes_from_binary_file<DeviceSoAMesh>(string, DeviceSoAMesh &, DeviceSoAMesh::HostMirrorMesh &, bool, uint64_t);
+template void TFEM::save_mesh_to_binary_file<DeviceMesh::HostMirrorMesh>(string, DeviceMesh::HostMirrorMesh &);
+template void TFEM::save_mesh_to_binary_file<DeviceSoAMesh::HostMirrorMesh>(string, DeviceSoAMesh::HostMirrorMesh &);
+template uint64_t TFEM::save_mesh_to_binary_file<DeviceMesh::HostMirrorMesh>(ostream &, DeviceMesh::HostMirrorMesh &);
+template uint64_t TFEM::save_mesh_to_binary_file<DeviceSoAMesh::HostMirrorMesh>(ostream &, DeviceSoAMesh::HostMirrorMesh &);
@@ -1,8 +1,17 @@
 #include <Kokkos_StaticCrsGraph.hpp>
+#include <Kokkos_Sort.hpp>
 #include <KokkosGraph_Distance2Color.hpp>
 #include <KokkosSparse_CrsMatrix.hpp>
 
 #include "mesh.hpp"
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
 
 // debug includes
 #include <vector>
@@ -10,17 +19,195 @@
 
 using namespace TFEM;
 
-MeshColorMap::MeshColorMap(DeviceMesh &mesh)
+namespace
+{
+    // One bit per color, so the balanced coloring is limited to 64 colors
+    typedef uint64_t ColorMask;
+    const int MAX_BALANCED_COLORS = 64;
+
+    /**
+     * Greedy coloring visiting the regions in the given order, giving each the lowest color not
+     * already used at one of its points. Returns the number of colors.
+     */
+    int greedy_color(const std::vector<Region> &regions, int n_points, const std::vector<int> &order, std::vector<int> &colors)
+    {
+        std::vector<ColorMask> point_masks(n_points, 0);
+        int n_colors = 0;
+        for (int r : order)
+        {
+            Region element = regions[r];
+            ColorMask used = point_masks[element[0]] | point_masks[element[1]] | point_masks[element[2]];
+            int color = 0;
+            while (color < MAX_BALANCED_COLORS && (used >> color) & 1)
+            {
+                color++;
+            }
+            if (color == MAX_BALANCED_COLORS)
+            {
+                throw std::runtime_error("Balanced mesh coloring needs more than 64 colors");
+            }
+            colors[r] = color;
+            for (int j = 0; j < 3; j++)
+            {
+                point_masks[element[j]] |= ColorMask(1) << color;
+            }
+            n_colors = std::max(n_colors, color + 1);
+        }
+        return n_colors;
+    }
+
+    /**
+     * Deterministic coloring with few, evenly sized colors. Returns the color of each region.
+     */
+    std::vector<int> balanced_coloring(const std::vector<Region> &regions, int n_points, int &n_colors)
+    {
+        int n_regions = regions.size();
+        std::vector<int> colors(n_regions);
+        std::vector<int> order(n_regions);
+        for (int r = 0; r < n_regions; r++)
+        {
+            order[r] = r;
+        }
+        n_colors = greedy_color(regions, n_points, order, colors);
+
+        // Regions around a point all need different colors, so the most regions at a point is a
+        // lower bound on the color count.
+        std::vector<int> point_degrees(n_points, 0);
+        for (const Region &region : regions)
+        {
+            Region element = region;
+            for (int j = 0; j < 3; j++)
+            {
+                point_degrees[element[j]]++;
+            }
+        }
+        int lower_bound = n_points > 0 ? *std::max_element(point_degrees.begin(), point_degrees.end()) : 0;
+
+        // Iterated greedy: recoloring one color class at a time, last class first, can only
+        // keep or reduce the number of colors.
+        for (int pass = 0; pass < 16 && n_colors > lower_bound; pass++)
+        {
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+                             { return colors[a] > colors[b]; });
+            std::vector<int> new_colors(n_regions);
+            int new_n_colors = greedy_color(regions, n_points, order, new_colors);
+            if (new_n_colors > n_colors)
+            {
+                break;
+            }
+            colors.swap(new_colors);
+            n_colors = new_n_colors;
+        }
+
+        // Rebalance: move regions out of colors above the average size into the smallest color
+        // that is free at all of their points.
+        std::vector<ColorMask> point_masks(n_points, 0);
+        std::vector<int> color_sizes(n_colors, 0);
+        for (int r = 0; r < n_regions; r++)
+        {
+            Region element = regions[r];
+            for (int j = 0; j < 3; j++)
+            {
+                point_masks[element[j]] |= ColorMask(1) << colors[r];
+            }
+            color_sizes[colors[r]]++;
+        }
+        int target_size = (n_regions + n_colors - 1) / std::max(n_colors, 1);
+        for (int pass = 0; pass < 4; pass++)
+        {
+            bool moved = false;
+            for (int r = 0; r < n_regions; r++)
+            {
+                int color = colors[r];
+                if (color_sizes[color] <= target_size)
+                {
+                    continue;
+                }
+                // A valid coloring uses each color once per point, so this region is the only
+                // user of its color at each of its points.
+                Region element = regions[r];
+                ColorMask used = point_masks[element[0]] | point_masks[element[1]] | point_masks[element[2]];
+                int best = -1;
+                for (int c = 0; c < n_colors; c++)
+                {
+                    if (!((used >> c) & 1) && color_sizes[c] < target_size && (best < 0 || color_sizes[c] < color_sizes[best]))
+                    {
+                        best = c;
+                    }
+                }
+                if (best < 0)
+                {
+                    continue;
+                }
+                for (int j = 0; j < 3; j++)
+                {
+                    point_masks[element[j]] &= ~(ColorMask(1) << color);
+                    point_masks[element[j]] |= ColorMask(1) << best;
+                }
+                color_sizes[color]--;
+                color_sizes[best]++;
+                colors[r] = best;
+                moved = true;
+            }
+            if (!moved)
+            {
+                break;
+            }
+        }
+        return colors;
+    }
+
+    const char COLORING_CACHE_TAG[8] = {'T', 'F', 'E', 'M', 'C', 'L', 'R', '\0'};
+    const uint32_t COLORING_CACHE_VERSION = 2;
+
+    // Followed by (n_colors + 1) int32 color starts and n_regions int32 region IDs
+    struct ColoringCacheHeader
+    {
+        char tag[8];
+        uint32_t version;
+        uint32_t n_colors;
+        uint32_t mode; // ColoringMode
+        uint32_t reserved;
+        uint64_t mesh_hash;
+        int64_t n_regions;
+    };
+}
+
+template <class MeshT>
+BasicMeshColorMap<MeshT>::BasicMeshColorMap(MeshT &mesh, ColoringMode mode, std::string cache_file, Kokkos::DefaultExecutionSpace space)
+    : space(space)
 {
     // constructor activities placed in a separate function since to
     // call lambdas on a GPU, the nvidia compiler wants them to be located
     // inside of a function inside of a public scope.
     // Aparently the constructor doesn't qualify.
-    do_color(mesh);
+    if (cache_file.empty() || !load(cache_file, mesh, mode))
+    {
+        do_color(mesh, mode);
+        if (!cache_file.empty())
+        {
+            save(cache_file, mesh, mode);
+        }
+    }
 }
 
-void MeshColorMap::do_color(DeviceMesh &mesh)
+template <class MeshT>
+BasicMeshColorMap<MeshT>::BasicMeshColorMap(MeshT &mesh, const std::vector<int32_t> &color_starts, const std::vector<int32_t> &member_ids, Kokkos::DefaultExecutionSpace space)
+    : space(space)
 {
+    set_color_csr(mesh, color_starts, member_ids, "Saved coloring");
+}
+
+template <class MeshT>
+void BasicMeshColorMap<MeshT>::do_color(MeshT &mesh, ColoringMode mode)
+{
+    ScopedPhase phase(space, "MeshColorMap::do_color", 0, mesh.region_count());
+    if (mode == ColoringMode::Balanced)
+    {
+        do_balanced_color(mesh);
+        return;
+    }
+
     // Call the bipartite row coloring kernel to assign different colors to any element sharing a
     // neighboring vertex, as described at:
     // https://github.com/kokkos/kokkos-kernels/wiki/D2-Graph-Coloring#bipartite-graph-row-coloring
@@ -42,19 +229,20 @@ void MeshColorMap::do_color(DeviceMesh &mesh)
     IndexArrayType indices_array("Column indices", 3 * n_elements); // a region is a triangle of 3 points
 
     // Populate the array with the points to color on
-    Kokkos::parallel_for(row_start_map.extent(0), KOKKOS_LAMBDA(int i) {
+    Kokkos::parallel_for("MeshColorMap::do_color row map", Kokkos::RangePolicy<>(space, 0, row_start_map.extent(0)), KOKKOS_LAMBDA(int i) {
         if(i >= n_elements){
             // per design of the kokkos_kernels function, this must store the extent of the indices/entries array
             row_start_map(i) = indices_array.extent(0);
         } else {
             row_start_map(i) = 3 * i;
-            Region points = mesh.regions(i);
+            Region points = mesh.region(i);
             for(int j = 0; j < 3; j++){
                 indices_array(3*i + j) = points[j];
             }
         } });
 
-    // Call into the kernel
+    // Call into the kernel. It runs on the default instance, so hand over in both directions.
+    space.fence();
     HandleType handle;
     handle.create_distance2_graph_coloring_handle();
     KokkosGraph::Experimental::bipartite_color_rows(&handle, mesh.region_count(), mesh.point_count(), row_start_map, indices_array);
@@ -66,66 +254,259 @@ void MeshColorMap::do_color(DeviceMesh &mesh)
 
     // Cleanup.
     handle.destroy_distance2_graph_coloring_handle();
+    Kokkos::DefaultExecutionSpace().fence();
 
     // Colors indexes by region and gives the color. We want to pick a color
     // and iterate over the regions, requiring some restructuring.
-    // This can be done in two parallel passes over the original color array,
-    // one to find where the starts of each color section should be and one to place
-    // each region within its section.
+    // Counts and a scan give the start of each color section, and a sort by
+    // (color, region ID) places the regions. The sort keeps the original region order
+    // within each color, so the members are the same on every run and keep whatever
+    // locality the mesh numbering has (e.g. after reorder_mesh).
+    int n_regions = mesh.region_count();
     Kokkos::View<int *> color_counts("Color counts", n_colors);
     Kokkos::View<int *> color_index("Color index", n_colors + 1);
-    Kokkos::View<Region *> color_members("Color members", region_to_colors.extent(0));
     Kokkos::View<int *> color_member_ids("Color member_ids", region_to_colors.extent(0));
 
     // Step 1: count how many items are in each color.
     // Atomic increment should be a fairly safe operation for most hardware.
-    Kokkos::parallel_for(mesh.region_count(), KOKKOS_LAMBDA(int i) {
+    Kokkos::parallel_for("MeshColorMap::do_color count", Kokkos::RangePolicy<>(space, 0, n_regions), KOKKOS_LAMBDA(int i) {
         int color = region_to_colors(i) - 1;
         Kokkos::atomic_increment(&color_counts(color)); });
-    Kokkos::fence();
-
-    // Step 2: cumulative sum to get start points.
-    // A parallel for with 1 iteration is a bit awkward, but is a simple way
-    // to run something in the device execution space, and we expect the number
-    // of colors to be small.
-    Kokkos::parallel_for(1, KOKKOS_LAMBDA(int _) {
-        for(int c = 0; c < n_colors; c++){
-            color_index[c + 1] = color_index[c] + color_counts[c];
+
+    // Step 2: exclusive scan of the counts to get start points, with the total at the end.
+    Kokkos::parallel_scan("MeshColorMap::do_color offsets", Kokkos::RangePolicy<>(space, 0, n_colors + 1), KOKKOS_LAMBDA(int c, int &partial, bool final) {
+        if (final) {
+            color_index(c) = partial;
+        }
+        if (c < n_colors) {
+            partial += color_counts(c);
         } });
-    Kokkos::fence();
-
-    // Step 3: If we reset the counts and do atomic_fetch_increment,
-    // will will be able to tell which item within each color we are,
-    // so we can index relative to the startpoint.
-    Kokkos::deep_copy(color_counts, 0);
-    Kokkos::parallel_for(mesh.region_count(), KOKKOS_LAMBDA(int i) {
-        int color = region_to_colors(i) - 1; // colors start at 1 but our array starts at 0
-        int place_ind = color_index(color) + Kokkos::atomic_fetch_add(&color_counts[color], 1);
-        color_members(place_ind) = mesh.regions(i);
-        color_member_ids(place_ind) = i; });
-    Kokkos::fence();
+
+    // Step 3: sort the (unique) keys color * n_regions + region ID, which orders by color and then
+    // by region ID, and read the region IDs back off the sorted keys.
+    Kokkos::View<int64_t *> color_keys("Color sort keys", n_regions);
+    Kokkos::parallel_for("MeshColorMap::do_color keys", Kokkos::RangePolicy<>(space, 0, n_regions), KOKKOS_LAMBDA(int i) {
+        color_keys(i) = static_cast<int64_t>(region_to_colors(i) - 1) * n_regions + i; });
+    Kokkos::sort(space, color_keys);
+    Kokkos::parallel_for("MeshColorMap::do_color place", Kokkos::RangePolicy<>(space, 0, n_regions), KOKKOS_LAMBDA(int i) {
+        color_member_ids(i) = static_cast<int>(color_keys(i) % n_regions); });
+
+    set_color_members(mesh, n_colors, color_index, color_member_ids);
+}
+
+template <class MeshT>
+void BasicMeshColorMap<MeshT>::do_balanced_color(MeshT &mesh)
+{
+    int n_regions = mesh.region_count();
+    auto host_regions = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), mesh.regions);
+    std::vector<Region> regions(n_regions);
+    for (int r = 0; r < n_regions; r++)
+    {
+        regions[r] = load_region(host_regions, r);
+    }
+
+    int n_colors;
+    std::vector<int> colors = balanced_coloring(regions, mesh.point_count(), n_colors);
+
+    // Counting sort by color, keeping region order within each color
+    Kokkos::View<int *> color_index("Color index", n_colors + 1);
+    Kokkos::View<int *> color_member_ids("Color member_ids", n_regions);
+    auto color_index_host = Kokkos::create_mirror_view(color_index);
+    auto color_member_ids_host = Kokkos::create_mirror_view(color_member_ids);
+    Kokkos::deep_copy(color_index_host, 0);
+    for (int r = 0; r < n_regions; r++)
+    {
+        color_index_host(colors[r] + 1)++;
+    }
+    for (int c = 0; c < n_colors; c++)
+    {
+        color_index_host(c + 1) += color_index_host(c);
+    }
+    std::vector<int> fill(color_index_host.data(), color_index_host.data() + n_colors);
+    for (int r = 0; r < n_regions; r++)
+    {
+        color_member_ids_host(fill[colors[r]]++) = r;
+    }
+    Kokkos::deep_copy(space, color_index, color_index_host);
+    Kokkos::deep_copy(space, color_member_ids, color_member_ids_host);
+
+    set_color_members(mesh, n_colors, color_index, color_member_ids);
+}
+
+template <class MeshT>
+void BasicMeshColorMap<MeshT>::set_color_members(MeshT &mesh, int n_colors, Kokkos::View<int *> color_index, Kokkos::View<int *> color_member_ids)
+{
+    // Copy the regions into color order
+    typename ColorMemberView::non_const_type color_members("Color members", color_member_ids.extent(0));
+    Kokkos::parallel_for(Kokkos::RangePolicy<>(space, 0, color_member_ids.extent(0)), KOKKOS_LAMBDA(int i) {
+        store_region(color_members, i, mesh.region(color_member_ids(i))); });
 
     // Now we should have a nice CSR-like structure for iterating over colors!
     // Just need to make the indexing available at the host:
+    this->n_colors = n_colors;
     this->color_index = color_index;
     this->color_index_host = Kokkos::create_mirror_view(color_index);
-    Kokkos::deep_copy(this->color_index_host, color_index);
+    Kokkos::deep_copy(space, this->color_index_host, color_index);
     this->color_members = color_members;
     this->color_ids = color_member_ids;
     this->color_ids_host = Kokkos::create_mirror_view(color_member_ids);
-    Kokkos::deep_copy(this->color_ids_host, color_member_ids);
+    Kokkos::deep_copy(space, this->color_ids_host, color_member_ids);
+    // The host mirrors are read right away, e.g. by color_count()
+    space.fence();
+}
+
+template <class MeshT>
+void BasicMeshColorMap<MeshT>::share_mesh_regions(MeshT &mesh)
+{
+    if (shares_regions)
+    {
+        return;
+    }
+    // The color members already are the mesh's regions in color order, in the mesh's layout
+    mesh.regions = color_members;
+    color_ids = Kokkos::View<const int *>();
+    color_ids_host = Kokkos::View<const int *>::HostMirror();
+    shares_regions = true;
+}
+
+template <class MeshT>
+std::vector<int32_t> BasicMeshColorMap<MeshT>::color_ordered_region_ids()
+{
+    int n_regions = color_index_host(n_colors);
+    std::vector<int32_t> ids(n_regions);
+    if (shares_regions)
+    {
+        std::iota(ids.begin(), ids.end(), 0);
+    }
+    else
+    {
+        std::copy(color_ids_host.data(), color_ids_host.data() + n_regions, ids.begin());
+    }
+    return ids;
+}
+
+template <class MeshT>
+void BasicMeshColorMap<MeshT>::save(std::string fname, MeshT &mesh, ColoringMode mode)
+{
+    ColoringCacheHeader header = {};
+    memcpy(header.tag, COLORING_CACHE_TAG, sizeof(COLORING_CACHE_TAG));
+    header.version = COLORING_CACHE_VERSION;
+    header.n_colors = n_colors;
+    header.mode = (uint32_t)mode;
+    header.mesh_hash = mesh_connectivity_hash(mesh);
+    header.n_regions = mesh.region_count();
+
+    std::ofstream out_file(fname, std::ios::binary);
+    if (!out_file)
+    {
+        throw std::runtime_error("Could not open " + fname + " for writing");
+    }
+    std::vector<int32_t> color_starts(color_index_host.data(), color_index_host.data() + n_colors + 1);
+    std::vector<int32_t> member_ids = color_ordered_region_ids();
+    out_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out_file.write(reinterpret_cast<const char *>(color_starts.data()), color_starts.size() * sizeof(int32_t));
+    out_file.write(reinterpret_cast<const char *>(member_ids.data()), member_ids.size() * sizeof(int32_t));
+    if (!out_file)
+    {
+        throw std::runtime_error("Failed writing coloring to " + fname);
+    }
+}
+
+template <class MeshT>
+bool BasicMeshColorMap<MeshT>::load(std::string fname, MeshT &mesh, ColoringMode mode)
+{
+    std::ifstream in_file(fname, std::ios::binary);
+    if (!in_file)
+    {
+        return false;
+    }
+
+    ColoringCacheHeader header;
+    in_file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in_file || memcmp(header.tag, COLORING_CACHE_TAG, sizeof(COLORING_CACHE_TAG)) != 0)
+    {
+        throw std::runtime_error(fname + " is not a mesh coloring file");
+    }
+    // Files from another version or coloring mode are misses, and get overwritten by the constructor
+    if (header.version != COLORING_CACHE_VERSION || header.mode != (uint32_t)mode || header.n_regions != mesh.region_count() || header.mesh_hash != mesh_connectivity_hash(mesh))
+    {
+        return false;
+    }
+
+    std::vector<int32_t> color_starts(header.n_colors + 1);
+    std::vector<int32_t> member_ids(header.n_regions);
+    in_file.read(reinterpret_cast<char *>(color_starts.data()), color_starts.size() * sizeof(int32_t));
+    in_file.read(reinterpret_cast<char *>(member_ids.data()), member_ids.size() * sizeof(int32_t));
+    if (!in_file)
+    {
+        throw std::runtime_error("Coloring file " + fname + " is truncated");
+    }
+
+    set_color_csr(mesh, color_starts, member_ids, "Coloring file " + fname);
+    return true;
+}
+
+template <class MeshT>
+void BasicMeshColorMap<MeshT>::set_color_csr(MeshT &mesh, const std::vector<int32_t> &color_starts, const std::vector<int32_t> &member_ids, const std::string &source)
+{
+    int n_colors = (int)color_starts.size() - 1;
+    int n_regions = mesh.region_count();
+    if (n_colors < 0 || (int)member_ids.size() != n_regions)
+    {
+        throw std::runtime_error(source + " does not match the mesh");
+    }
+
+    // Check what could make the device kernels read out of bounds, or race on a region
+    if (color_starts[0] != 0 || color_starts[n_colors] != n_regions || !std::is_sorted(color_starts.begin(), color_starts.end()))
+    {
+        throw std::runtime_error(source + " has invalid color starts");
+    }
+    Kokkos::View<int *> color_index("Color index", n_colors + 1);
+    Kokkos::View<int *> color_member_ids("Color member_ids", n_regions);
+    auto color_index_host = Kokkos::create_mirror_view(color_index);
+    auto color_member_ids_host = Kokkos::create_mirror_view(color_member_ids);
+    std::vector<char> seen(n_regions, 0);
+    for (int i = 0; i < n_regions; i++)
+    {
+        if (member_ids[i] < 0 || member_ids[i] >= n_regions)
+        {
+            throw std::runtime_error(source + " has an invalid region ID");
+        }
+        if (seen[member_ids[i]])
+        {
+            throw std::runtime_error(source + " lists region " + std::to_string(member_ids[i]) + " more than once");
+        }
+        seen[member_ids[i]] = 1;
+        color_member_ids_host(i) = member_ids[i];
+    }
+    for (int c = 0; c <= n_colors; c++)
+    {
+        color_index_host(c) = color_starts[c];
+    }
+    Kokkos::deep_copy(space, color_index, color_index_host);
+    Kokkos::deep_copy(space, color_member_ids, color_member_ids_host);
+
+    set_color_members(mesh, n_colors, color_index, color_member_ids);
 }
 
-int MeshColorMap::color_count()
+template <class MeshT>
+int BasicMeshColorMap<MeshT>::color_count()
 {
     return n_colors;
 }
 
-int MeshColorMap::member_count(int color)
+template <class MeshT>
+int BasicMeshColorMap<MeshT>::member_count(int color)
 {
     return color_index_host(color + 1) - color_index_host(color);
 }
 
+template <class MeshT>
+int BasicMeshColorMap<MeshT>::color_start(int color)
+{
+    return color_index_host(color);
+}
+
 /**
  * Runs a check and prints to the console that a coloring is a correct. A coloring is correct if
  * every region in the mesh has exactly one color, and no regions within a single color share a point.
@@ -133,7 +514,8 @@ int MeshColorMap::member_count(int color)
  * In a more mature project this would be part of a test suite instead. Has no real value for an
  * active simulation.
  */
-void TFEM::validate_mesh_coloring(typename DeviceMesh::HostMirrorMesh &mesh, MeshColorMap &coloring)
+template <class MeshT>
+void TFEM::validate_mesh_coloring(typename MeshT::HostMirrorMesh &mesh, BasicMeshColorMap<MeshT> &coloring)
 {
     using IntArray = Kokkos::View<int *, Kokkos::DefaultHostExecutionSpace>;
 
@@ -141,13 +523,15 @@ void TFEM::validate_mesh_coloring(typename DeviceMesh::HostMirrorMesh &mesh, Mes
     IntArray region_colors("ID occurence count", mesh.region_count());
     Kokkos::deep_copy(region_colors, -1);
 
+    // Region IDs in color order, which also works for maps sharing the mesh's regions
+    std::vector<int32_t> ids = coloring.color_ordered_region_ids();
+
     std::cout << "Validating uniqueness of coloring..." << std::endl;
     for (int color = 0; color < coloring.color_count(); color++)
     {
-        auto color_ids = coloring.color_member_ids_host(color);
-        for (int i = 0; i < color_ids.extent(0); i++)
+        for (int i = 0; i < coloring.member_count(color); i++)
         {
-            int id = color_ids(i);
+            int id = ids[coloring.color_start(color) + i];
             if (region_colors(id) > -1)
             {
                 std::cout << "Region " << id << " already colored " << region_colors(id) << ", again colored " << color << std::endl;
@@ -167,11 +551,10 @@ void TFEM::validate_mesh_coloring(typename DeviceMesh::HostMirrorMesh &mesh, Mes
     for (int color = 0; color < coloring.color_count(); color++)
     {
         Kokkos::deep_copy(point_regions, -1);
-        auto color_ids = coloring.color_member_ids_host(color);
-        for (int i = 0; i < color_ids.extent(0); i++)
+        for (int i = 0; i < coloring.member_count(color); i++)
         {
-            int id = color_ids(i);
-            Region r = mesh.regions(id);
+            int id = ids[coloring.color_start(color) + i];
+            Region r = mesh.region(id);
             for (int j = 0; j < 3; j++)
             {
                 pointID p = r[j];
@@ -189,17 +572,15 @@ void TFEM::validate_mesh_coloring(typename DeviceMesh::HostMirrorMesh &mesh, Mes
     std::cout << "Done" << std::endl;
 
     std::cout << "Validating index-value match..." << std::endl;
+    // Copy all regions at once: per-color subviews of the column layout are strided
+    auto host_color_regions = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), coloring.all_color_member_regions());
     for (int color = 0; color < coloring.color_count(); color++)
     {
-        auto host_color_regions = Kokkos::create_mirror_view(coloring.color_member_regions(color));
-        Kokkos::deep_copy(host_color_regions, coloring.color_member_regions(color));
-        auto host_color_ids = coloring.color_member_ids_host(color);
-
-        for (int i = 0; i < host_color_regions.extent(0); i++)
+        for (int i = 0; i < coloring.member_count(color); i++)
         {
-            int id = host_color_ids(i);
-            Region r_color = host_color_regions(i);
-            Region r_mesh = mesh.regions(id);
+            int id = ids[coloring.color_start(color) + i];
+            Region r_color = load_region(host_color_regions, coloring.color_start(color) + i);
+            Region r_mesh = mesh.region(id);
 
             for (int j = 0; j < 3; j++)
             {
@@ -212,3 +593,14 @@ void TFEM::validate_mesh_coloring(typename DeviceMesh::HostMirrorMesh &mesh, Mes
     }
     std::cout << "Done" << std::endl;
 }
+
+// Instantiate for both mesh layouts
+template class TFEM::BasicMeshColorMap<DeviceMesh>;
+template class TFEM::BasicMeshColorMap<DeviceSoAMesh>;
+template class TFEM::BasicMeshColorMap<DeviceFloatMesh>;
+template class TFEM::BasicMeshColorMap<DeviceSoAFloatMesh>;
+template class TFEM::BasicMeshColorMap<DeviceCompactMesh>;
+template class TFEM::BasicMeshColorMap<DeviceCompactFloatMesh>;
+template class TFEM::BasicMeshColorMap<DeviceUInt32Mesh>;
+template void TFEM::validate_mesh_coloring<DeviceMesh>(DeviceMesh::HostMirrorMesh &, MeshColorMap &);
+template void TFEM::validate_mesh_coloring<DeviceSoAMesh>(DeviceSoAMesh::HostMirrorMesh &, SoAMeshColorMap &);
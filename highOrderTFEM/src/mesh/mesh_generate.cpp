@@ -0,0 +1,101 @@
+#include "mesh.hpp"
+#include "instrumentation.hpp"
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace TFEM;
+using namespace std;
+
+template <class MeshT>
+void TFEM::generate_square_mesh(int n, MeshT &device_mesh, bool fuzz, uint64_t seed)
+{
+    // About 3 * 4^(n-1) edges have to fit in an int
+    if (n < 1 || n > 15)
+    {
+        throw invalid_argument("generate_square_mesh: n must be between 1 and 15, got " + to_string(n));
+    }
+    int cells = 1 << (n - 1);
+    int row = cells + 1;
+    int n_points = row * row;
+    // Horizontal edges, then vertical, then the diagonals
+    int n_horizontal = cells * row;
+    int n_edges = 2 * n_horizontal + cells * cells;
+    int n_regions = 2 * cells * cells;
+    ScopedPhase phase("generate_square_mesh", 0, n_regions);
+
+    device_mesh = MeshT(n_points, n_edges, n_regions);
+    device_mesh.boundary_points = typename MeshT::BoundaryPointIndicator("Boundary edge flags", n_points);
+    auto mesh = device_mesh;
+    double h = 2.0 / cells;
+    Kokkos::parallel_for("generate_square_mesh points", n_points, KOKKOS_LAMBDA(int p) {
+        int i = p % row;
+        int j = p / row;
+        mesh.coord(p, 0) = -1 + h * i;
+        mesh.coord(p, 1) = -1 + h * j;
+        mesh.boundary_points(p) = i == 0 || j == 0 || i == cells || j == cells; });
+
+    Kokkos::parallel_for("generate_square_mesh edges", n_edges, KOKKOS_LAMBDA(int e) {
+        pointID from;
+        pointID to;
+        if (e < n_horizontal) {
+            // Cell row j, from point (i, j) to (i + 1, j)
+            from = (e / cells) * row + e % cells;
+            to = from + 1;
+        } else if (e < 2 * n_horizontal) {
+            // Point (i, j) to (i, j + 1)
+            from = e - n_horizontal;
+            to = from + row;
+        } else {
+            // Cell (i, j), from its lower left to its upper right corner
+            int cell = e - 2 * n_horizontal;
+            from = (cell / cells) * row + cell % cells;
+            to = from + row + 1;
+        }
+        mesh.edges(e)[0] = from;
+        mesh.edges(e)[1] = to; });
+
+    // Two counterclockwise triangles per cell, either side of the diagonal
+    Kokkos::parallel_for("generate_square_mesh regions", n_regions, KOKKOS_LAMBDA(int r) {
+        int cell = r / 2;
+        pointID lower_left = (cell / cells) * row + cell % cells;
+        pointID upper_right = lower_left + row + 1;
+        mesh.vertex(r, 0) = lower_left;
+        mesh.vertex(r, 1) = r % 2 == 0 ? lower_left + 1 : upper_right;
+        mesh.vertex(r, 2) = r % 2 == 0 ? upper_right : lower_left + row; });
+
+    // Four boundary segments, bottom, right, top and left, each in counterclockwise order
+    typename MeshT::BoundaryEdgeMap::row_map_type::non_const_type segment_starts("Boundary edge segments row map", 5);
+    typename MeshT::BoundaryEdgeMap::entries_type boundary_edge_ids("Boundary edge segments entries", 4 * cells);
+    Kokkos::parallel_for("generate_square_mesh boundary segments", 5, KOKKOS_LAMBDA(int s) { segment_starts(s) = s * cells; });
+    Kokkos::parallel_for("generate_square_mesh boundary edges", 4 * cells, KOKKOS_LAMBDA(int b) {
+        int segment = b / cells;
+        int i = b % cells;
+        int edge;
+        switch (segment) {
+        case 0:
+            edge = i;
+            break;
+        case 1:
+            edge = n_horizontal + i * row + cells;
+            break;
+        case 2:
+            edge = cells * cells + (cells - 1 - i);
+            break;
+        default:
+            edge = n_horizontal + (cells - 1 - i) * row;
+        }
+        boundary_edge_ids(b) = edge; });
+    device_mesh.boundary_edges = typename MeshT::BoundaryEdgeMap(boundary_edge_ids, segment_starts);
+    MeshImpl::set_boundary_point_ids(device_mesh);
+
+    if (fuzz)
+    {
+        MeshImpl::fuzz_interior_points_device(device_mesh, seed);
+    }
+    Kokkos::fence();
+}
+
+// Instantiate for both mesh layouts
+template void TFEM::generate_square_mesh<DeviceMesh>(int, DeviceMesh &, bool, uint64_t);
+template void TFEM::generate_square_mesh<DeviceSoAMesh>(int, DeviceSoAMesh &, bool, uint64_t);
@@ -0,0 +1,306 @@
+#include "mesh.hpp"
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace TFEM;
+using namespace std;
+
+namespace
+{
+    /**
+     * Assigns parts [first_part, first_part + n_parts) to the regions ids[begin, end), cutting
+     * the range in two and recursing until each range gets a single part.
+     */
+    void bisect_regions(vector<int> &ids, int begin, int end, vector<Point> &centroids,
+                        int first_part, int n_parts, Kokkos::View<int *, Kokkos::HostSpace> &region_parts)
+    {
+        if (n_parts == 1)
+        {
+            for (int i = begin; i < end; i++)
+            {
+                region_parts(ids[i]) = first_part;
+            }
+            return;
+        }
+
+        // Cut across the longer side of the bounding box
+        double lo[2] = {1e300, 1e300};
+        double hi[2] = {-1e300, -1e300};
+        for (int i = begin; i < end; i++)
+        {
+            for (int dim = 0; dim < 2; dim++)
+            {
+                lo[dim] = std::min(lo[dim], centroids[ids[i]][dim]);
+                hi[dim] = std::max(hi[dim], centroids[ids[i]][dim]);
+            }
+        }
+        int axis = (hi[0] - lo[0] >= hi[1] - lo[1]) ? 0 : 1;
+
+        int left_parts = n_parts / 2;
+        int middle = begin + (int)((long long)(end - begin) * left_parts / n_parts);
+        // Ties are broken by ID, so the cut does not depend on the standard library's nth_element
+        std::nth_element(ids.begin() + begin, ids.begin() + middle, ids.begin() + end, [&](int a, int b)
+                         { return centroids[a][axis] < centroids[b][axis] ||
+                                  (centroids[a][axis] == centroids[b][axis] && a < b); });
+        bisect_regions(ids, begin, middle, centroids, first_part, left_parts, region_parts);
+        bisect_regions(ids, middle, end, centroids, first_part + left_parts, n_parts - left_parts, region_parts);
+    }
+
+    uint64_t edge_key(pointID a, pointID b)
+    {
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+        return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+    }
+}
+
+template <class HostMeshT>
+Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions(HostMeshT &host_mesh, int n_parts)
+{
+    int n_regions = host_mesh.region_count();
+    vector<Point> centroids(n_regions);
+    for (int r = 0; r < n_regions; r++)
+    {
+        Region element = host_mesh.region(r);
+        for (int dim = 0; dim < 2; dim++)
+        {
+            centroids[r][dim] = (host_mesh.coord(element[0], dim) + host_mesh.coord(element[1], dim) + host_mesh.coord(element[2], dim)) / 3;
+        }
+    }
+
+    Kokkos::View<int *, Kokkos::HostSpace> region_parts("Region parts", n_regions);
+    vector<int> ids(n_regions);
+    std::iota(ids.begin(), ids.end(), 0);
+    bisect_regions(ids, 0, n_regions, centroids, 0, n_parts, region_parts);
+    return region_parts;
+}
+
+template <class MeshT>
+MeshPart<MeshT> TFEM::extract_mesh_part(typename MeshT::HostMirrorMesh &global_mesh, Kokkos::View<int *, Kokkos::HostSpace> region_parts, int part, int n_parts)
+{
+    typedef typename MeshPart<MeshT>::IndexView IndexView;
+    int n_global_points = global_mesh.point_count();
+    int n_global_regions = global_mesh.region_count();
+
+    // Parts touching each point, as a sorted, unique CSR
+    vector<int> point_part_offsets(n_global_points + 1, 0);
+    vector<pair<pointID, int>> point_parts;
+    point_parts.reserve(3 * n_global_regions);
+    for (int r = 0; r < n_global_regions; r++)
+    {
+        Region element = global_mesh.region(r);
+        for (int j = 0; j < 3; j++)
+        {
+            point_parts.push_back({element[j], region_parts(r)});
+        }
+    }
+    std::sort(point_parts.begin(), point_parts.end());
+    point_parts.erase(std::unique(point_parts.begin(), point_parts.end()), point_parts.end());
+    for (auto &entry : point_parts)
+    {
+        point_part_offsets[entry.first + 1]++;
+    }
+    std::partial_sum(point_part_offsets.begin(), point_part_offsets.end(), point_part_offsets.begin());
+
+    auto touches_part = [&](pointID p)
+    {
+        for (int n = point_part_offsets[p]; n < point_part_offsets[p + 1]; n++)
+        {
+            if (point_parts[n].second == part)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto is_shared = [&](pointID p)
+    { return point_part_offsets[p + 1] - point_part_offsets[p] > 1; };
+
+    // Local points keep the relative order of their global IDs
+    vector<int> point_global_to_local(n_global_points, -1);
+    vector<pointID> local_points;
+    for (pointID p = 0; p < n_global_points; p++)
+    {
+        if (touches_part(p))
+        {
+            point_global_to_local[p] = local_points.size();
+            local_points.push_back(p);
+        }
+    }
+
+    // Regions touching the interface first, each group in global order
+    vector<int> local_regions;
+    vector<int> interior_regions;
+    for (int r = 0; r < n_global_regions; r++)
+    {
+        if (region_parts(r) != part)
+        {
+            continue;
+        }
+        Region element = global_mesh.region(r);
+        if (is_shared(element[0]) || is_shared(element[1]) || is_shared(element[2]))
+        {
+            local_regions.push_back(r);
+        }
+        else
+        {
+            interior_regions.push_back(r);
+        }
+    }
+    int n_interface_regions = local_regions.size();
+    local_regions.insert(local_regions.end(), interior_regions.begin(), interior_regions.end());
+
+    // Edges of the local regions, found through a lookup of their end points
+    unordered_map<uint64_t, int> global_edge_ids;
+    for (int e = 0; e < global_mesh.edge_count(); e++)
+    {
+        global_edge_ids[edge_key(global_mesh.edges(e)[0], global_mesh.edges(e)[1])] = e;
+    }
+    vector<char> edge_is_local(global_mesh.edge_count(), 0);
+    for (int r : local_regions)
+    {
+        Region element = global_mesh.region(r);
+        for (int j = 0; j < 3; j++)
+        {
+            auto found = global_edge_ids.find(edge_key(element[j], element[(j + 1) % 3]));
+            if (found != global_edge_ids.end())
+            {
+                edge_is_local[found->second] = 1;
+            }
+        }
+    }
+    vector<int> edge_global_to_local(global_mesh.edge_count(), -1);
+    vector<int> local_edges;
+    for (int e = 0; e < global_mesh.edge_count(); e++)
+    {
+        if (edge_is_local[e])
+        {
+            edge_global_to_local[e] = local_edges.size();
+            local_edges.push_back(e);
+        }
+    }
+
+    MeshPart<MeshT> result;
+    result.part = part;
+    result.n_parts = n_parts;
+    result.n_interface_regions = n_interface_regions;
+    int n_points = local_points.size();
+    int n_regions = local_regions.size();
+    int n_edges = local_edges.size();
+
+    // Fill the host side, then copy over, as when loading
+    result.mesh = MeshT(n_points, n_edges, n_regions);
+    result.host_mesh = result.mesh.create_host_mirror();
+    auto &host_mesh = result.host_mesh;
+    result.point_local_to_global = IndexView("Part point local to global", n_points);
+    result.region_local_to_global = IndexView("Part region local to global", n_regions);
+    result.owned_points = Kokkos::View<bool *, Kokkos::HostSpace>("Part owned points", n_points);
+    for (int p = 0; p < n_points; p++)
+    {
+        pointID global = local_points[p];
+        host_mesh.coord(p, 0) = global_mesh.coord(global, 0);
+        host_mesh.coord(p, 1) = global_mesh.coord(global, 1);
+        result.point_local_to_global(p) = global;
+        // Part lists are sorted, so the first is the owner
+        result.owned_points(p) = point_parts[point_part_offsets[global]].second == part;
+    }
+    for (int r = 0; r < n_regions; r++)
+    {
+        Region element = global_mesh.region(local_regions[r]);
+        for (int j = 0; j < 3; j++)
+        {
+            host_mesh.vertex(r, j) = point_global_to_local[element[j]];
+        }
+        result.region_local_to_global(r) = local_regions[r];
+    }
+    for (int e = 0; e < n_edges; e++)
+    {
+        Edge edge = global_mesh.edges(local_edges[e]);
+        host_mesh.edges(e)[0] = point_global_to_local[edge[0]];
+        host_mesh.edges(e)[1] = point_global_to_local[edge[1]];
+    }
+
+    // Boundary segments keep their numbering, holding only the local edges
+    int n_segments = global_mesh.boundary_edges.numRows();
+    vector<int> segment_starts(n_segments + 1, 0);
+    vector<int> boundary_edge_ids;
+    for (int s = 0; s < n_segments; s++)
+    {
+        for (int i = global_mesh.boundary_edges.row_map(s); i < (int)global_mesh.boundary_edges.row_map(s + 1); i++)
+        {
+            int local = edge_global_to_local[global_mesh.boundary_edges.entries(i)];
+            if (local >= 0)
+            {
+                boundary_edge_ids.push_back(local);
+            }
+        }
+        segment_starts[s + 1] = boundary_edge_ids.size();
+    }
+    result.mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::BoundaryEdgeMap>("Boundary edge segments", segment_starts.data(), n_segments, boundary_edge_ids.data());
+    host_mesh.boundary_edges = MeshImpl::create_boundary_graph<typename MeshT::HostMirrorMesh::BoundaryEdgeMap>("Boundary edge segments", segment_starts.data(), n_segments, boundary_edge_ids.data());
+
+    // Boundary flags are those of the whole mesh; the interface between parts is not a boundary
+    result.mesh.boundary_points = typename MeshT::BoundaryPointIndicator("Boundary edge flags", n_points);
+    host_mesh.boundary_points = Kokkos::create_mirror_view(result.mesh.boundary_points);
+    for (int p = 0; p < n_points; p++)
+    {
+        host_mesh.boundary_points(p) = global_mesh.boundary_points(local_points[p]);
+    }
+    MeshImpl::set_boundary_point_ids(result.mesh, host_mesh);
+
+    host_mesh.deep_copy_all_to(result.mesh);
+    Kokkos::deep_copy(result.mesh.boundary_points, host_mesh.boundary_points);
+
+    // Shared points by neighbor. Local points are in global order, so each list is too.
+    vector<vector<int>> shared_by_part(n_parts);
+    for (int p = 0; p < n_points; p++)
+    {
+        pointID global = local_points[p];
+        for (int n = point_part_offsets[global]; n < point_part_offsets[global + 1]; n++)
+        {
+            if (point_parts[n].second != part)
+            {
+                shared_by_part[point_parts[n].second].push_back(p);
+            }
+        }
+    }
+    int n_shared = 0;
+    for (int q = 0; q < n_parts; q++)
+    {
+        if (!shared_by_part[q].empty())
+        {
+            result.neighbors.push_back(q);
+            n_shared += shared_by_part[q].size();
+        }
+    }
+    result.shared_offsets = IndexView("Part shared offsets", result.neighbors.size() + 1);
+    result.shared_points = IndexView("Part shared points", n_shared);
+    int fill = 0;
+    for (size_t n = 0; n < result.neighbors.size(); n++)
+    {
+        result.shared_offsets(n) = fill;
+        for (int p : shared_by_part[result.neighbors[n]])
+        {
+            result.shared_points(fill++) = p;
+        }
+    }
+    result.shared_offsets(result.neighbors.size()) = fill;
+    return result;
+}
+
+// Instantiate for both mesh layouts
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceMesh::HostMirrorMesh>(DeviceMesh::HostMirrorMesh &, int);
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceSoAMesh::HostMirrorMesh>(DeviceSoAMesh::HostMirrorMesh &, int);
+// Single precision, compact and 32 bit unsigned index meshes too, for the solver's temporal blocking tiles
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceFloatMesh::HostMirrorMesh>(DeviceFloatMesh::HostMirrorMesh &, int);
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceSoAFloatMesh::HostMirrorMesh>(DeviceSoAFloatMesh::HostMirrorMesh &, int);
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceCompactMesh::HostMirrorMesh>(DeviceCompactMesh::HostMirrorMesh &, int);
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceCompactFloatMesh::HostMirrorMesh>(DeviceCompactFloatMesh::HostMirrorMesh &, int);
+template Kokkos::View<int *, Kokkos::HostSpace> TFEM::partition_mesh_regions<DeviceUInt32Mesh::HostMirrorMesh>(DeviceUInt32Mesh::HostMirrorMesh &, int);
+template MeshPart<DeviceMesh> TFEM::extract_mesh_part<DeviceMesh>(DeviceMesh::HostMirrorMesh &, Kokkos::View<int *, Kokkos::HostSpace>, int, int);
+template MeshPart<DeviceSoAMesh> TFEM::extract_mesh_part<DeviceSoAMesh>(DeviceSoAMesh::HostMirrorMesh &, Kokkos::View<int *, Kokkos::HostSpace>, int, int);
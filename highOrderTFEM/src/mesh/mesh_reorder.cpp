@@ -0,0 +1,300 @@
+#include "mesh.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+using namespace TFEM;
+using namespace std;
+
+namespace
+{
+    /**
+     * Point adjacency in CSR form, built from the edge list.
+     */
+    struct PointAdjacency
+    {
+        std::vector<int> offsets;
+        std::vector<pointID> neighbors;
+
+        int degree(pointID p) const { return offsets[p + 1] - offsets[p]; }
+    };
+
+    template <class HostMeshT>
+    PointAdjacency build_point_adjacency(HostMeshT &host_mesh)
+    {
+        int n_points = host_mesh.point_count();
+        PointAdjacency adjacency;
+        adjacency.offsets.assign(n_points + 1, 0);
+        adjacency.neighbors.resize(2 * host_mesh.edge_count());
+
+        for (int e = 0; e < host_mesh.edge_count(); e++)
+        {
+            adjacency.offsets[host_mesh.edges(e)[0] + 1]++;
+            adjacency.offsets[host_mesh.edges(e)[1] + 1]++;
+        }
+        std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+        std::vector<int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for (int e = 0; e < host_mesh.edge_count(); e++)
+        {
+            pointID a = host_mesh.edges(e)[0];
+            pointID b = host_mesh.edges(e)[1];
+            adjacency.neighbors[fill[a]++] = b;
+            adjacency.neighbors[fill[b]++] = a;
+        }
+        return adjacency;
+    }
+
+    /**
+     * Breadth first search from root over unvisited points. Appends the points in visiting order to
+     * "order", with neighbors visited in order of increasing degree (i.e. a Cuthill-McKee ordering).
+     * Marks everything reached in "visited", and returns the index in "order" where the last level starts.
+     */
+    size_t cuthill_mckee_search(const PointAdjacency &adjacency, pointID root, std::vector<char> &visited, std::vector<pointID> &order)
+    {
+        size_t level_start = order.size();
+        size_t last_level_start = level_start;
+        order.push_back(root);
+        visited[root] = 1;
+        std::vector<pointID> new_neighbors;
+
+        while (level_start < order.size())
+        {
+            last_level_start = level_start;
+            size_t level_end = order.size();
+            for (size_t i = level_start; i < level_end; i++)
+            {
+                pointID p = order[i];
+                new_neighbors.clear();
+                for (int n = adjacency.offsets[p]; n < adjacency.offsets[p + 1]; n++)
+                {
+                    pointID q = adjacency.neighbors[n];
+                    if (!visited[q])
+                    {
+                        visited[q] = 1;
+                        new_neighbors.push_back(q);
+                    }
+                }
+                std::stable_sort(new_neighbors.begin(), new_neighbors.end(), [&](pointID a, pointID b)
+                                 { return adjacency.degree(a) < adjacency.degree(b); });
+                order.insert(order.end(), new_neighbors.begin(), new_neighbors.end());
+            }
+            level_start = level_end;
+        }
+        return last_level_start;
+    }
+
+    /**
+     * Reverse Cuthill-McKee ordering. Each connected component is started from a pseudo-peripheral point,
+     * found by repeatedly jumping to a minimum-degree point of the deepest BFS level.
+     */
+    template <class HostMeshT>
+    std::vector<pointID> reverse_cuthill_mckee_order(HostMeshT &host_mesh)
+    {
+        int n_points = host_mesh.point_count();
+        PointAdjacency adjacency = build_point_adjacency(host_mesh);
+
+        std::vector<pointID> order;
+        order.reserve(n_points);
+        std::vector<char> visited(n_points, 0);
+        std::vector<pointID> trial_order;
+        std::vector<char> trial_visited(n_points, 0);
+
+        for (pointID seed = 0; seed < n_points; seed++)
+        {
+            if (visited[seed])
+            {
+                continue;
+            }
+
+            // Find a root near the "edge" of this component. A few rounds is plenty in practice.
+            pointID root = seed;
+            size_t depth = 0;
+            for (int round = 0; round < 5; round++)
+            {
+                trial_order.clear();
+                size_t last_level = cuthill_mckee_search(adjacency, root, trial_visited, trial_order);
+                for (pointID p : trial_order)
+                {
+                    trial_visited[p] = 0;
+                }
+                pointID candidate = *std::min_element(trial_order.begin() + last_level, trial_order.end(), [&](pointID a, pointID b)
+                                                      { return adjacency.degree(a) < adjacency.degree(b); });
+                size_t candidate_depth = trial_order.size() - last_level;
+                if (round > 0 && candidate_depth <= depth)
+                {
+                    break;
+                }
+                depth = candidate_depth;
+                root = candidate;
+            }
+
+            cuthill_mckee_search(adjacency, root, visited, order);
+        }
+
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    // Position of (x, y) along a Hilbert curve filling an n x n grid (n a power of 2)
+    uint64_t hilbert_index(uint32_t n, uint32_t x, uint32_t y)
+    {
+        uint64_t d = 0;
+        for (uint32_t s = n / 2; s > 0; s /= 2)
+        {
+            uint32_t rx = (x & s) > 0;
+            uint32_t ry = (y & s) > 0;
+            d += (uint64_t)s * s * ((3 * rx) ^ ry);
+            // Rotate the quadrant so the curve stays continuous
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    /**
+     * Orders points along a Hilbert curve over the bounding box of the mesh, with ties broken by
+     * the original ID.
+     */
+    template <class HostMeshT>
+    std::vector<pointID> hilbert_order(HostMeshT &host_mesh)
+    {
+        int n_points = host_mesh.point_count();
+        const uint32_t grid_size = 1u << 16;
+        if (n_points == 0)
+        {
+            // No bounding box to seed from point 0
+            return {};
+        }
+
+        double min_xy[2] = {host_mesh.coord(0, 0), host_mesh.coord(0, 1)};
+        double max_xy[2] = {min_xy[0], min_xy[1]};
+        for (pointID p = 0; p < n_points; p++)
+        {
+            for (int dim = 0; dim < 2; dim++)
+            {
+                min_xy[dim] = std::min(min_xy[dim], host_mesh.coord(p, dim));
+                max_xy[dim] = std::max(max_xy[dim], host_mesh.coord(p, dim));
+            }
+        }
+
+        std::vector<uint64_t> keys(n_points);
+        for (pointID p = 0; p < n_points; p++)
+        {
+            uint32_t grid_xy[2];
+            for (int dim = 0; dim < 2; dim++)
+            {
+                double extent = max_xy[dim] - min_xy[dim];
+                double unit = extent > 0 ? (host_mesh.coord(p, dim) - min_xy[dim]) / extent : 0.0;
+                grid_xy[dim] = static_cast<uint32_t>(unit * (grid_size - 1));
+            }
+            keys[p] = hilbert_index(grid_size, grid_xy[0], grid_xy[1]);
+        }
+
+        std::vector<pointID> order(n_points);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](pointID a, pointID b)
+                         { return keys[a] < keys[b]; });
+        return order;
+    }
+}
+
+template <class MeshT>
+MeshPermutation TFEM::reorder_mesh(MeshT &device_mesh, typename MeshT::HostMirrorMesh &host_mesh, MeshOrdering ordering)
+{
+    int n_points = host_mesh.point_count();
+    int n_regions = host_mesh.region_count();
+
+    // New point order
+    std::vector<pointID> point_new_to_old;
+    switch (ordering)
+    {
+    case MeshOrdering::ReverseCuthillMcKee:
+        point_new_to_old = reverse_cuthill_mckee_order(host_mesh);
+        break;
+    case MeshOrdering::Hilbert:
+        point_new_to_old = hilbert_order(host_mesh);
+        break;
+    }
+    std::vector<pointID> point_old_to_new(n_points);
+    for (pointID p = 0; p < n_points; p++)
+    {
+        point_old_to_new[point_new_to_old[p]] = p;
+    }
+
+    // The host mirror may be the device mesh itself, so permute out of separate copies.
+    auto old_points = Kokkos::create_mirror(host_mesh.points);
+    auto old_regions = Kokkos::create_mirror(host_mesh.regions);
+    auto old_boundary_points = Kokkos::create_mirror(host_mesh.boundary_points);
+    Kokkos::deep_copy(old_points, host_mesh.points);
+    Kokkos::deep_copy(old_regions, host_mesh.regions);
+    Kokkos::deep_copy(old_boundary_points, host_mesh.boundary_points);
+
+    // Regions follow their lowest-numbered (new) vertex, so elements sharing points end up close together.
+    std::vector<int> region_keys(n_regions);
+    for (int r = 0; r < n_regions; r++)
+    {
+        Region element = load_region(old_regions, r);
+        region_keys[r] = std::min({point_old_to_new[element[0]], point_old_to_new[element[1]], point_old_to_new[element[2]]});
+    }
+    std::vector<int> region_new_to_old(n_regions);
+    std::iota(region_new_to_old.begin(), region_new_to_old.end(), 0);
+    std::stable_sort(region_new_to_old.begin(), region_new_to_old.end(), [&](int a, int b)
+                     { return region_keys[a] < region_keys[b]; });
+
+    // Rewrite the mesh. Edge and boundary segment numbering stays the same, only their point IDs change.
+    for (pointID p = 0; p < n_points; p++)
+    {
+        Point old_point = load_point(old_points, point_new_to_old[p]);
+        host_mesh.coord(p, 0) = old_point[0];
+        host_mesh.coord(p, 1) = old_point[1];
+        host_mesh.boundary_points(p) = old_boundary_points(point_new_to_old[p]);
+    }
+    for (int r = 0; r < n_regions; r++)
+    {
+        Region element = load_region(old_regions, region_new_to_old[r]);
+        for (int j = 0; j < 3; j++)
+        {
+            host_mesh.vertex(r, j) = point_old_to_new[element[j]];
+        }
+    }
+    for (int e = 0; e < host_mesh.edge_count(); e++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            host_mesh.edges(e)[j] = point_old_to_new[host_mesh.edges(e)[j]];
+        }
+    }
+
+    host_mesh.deep_copy_all_to(device_mesh);
+    Kokkos::deep_copy(device_mesh.boundary_points, host_mesh.boundary_points);
+    MeshImpl::set_boundary_point_ids(device_mesh, host_mesh);
+
+    // Keep the permutation so results can be mapped back to the original numbering
+    MeshPermutation permutation;
+    permutation.point_new_to_old = MeshPermutation::IndexView("Point new to old", n_points);
+    permutation.point_old_to_new = MeshPermutation::IndexView("Point old to new", n_points);
+    permutation.region_new_to_old = MeshPermutation::IndexView("Region new to old", n_regions);
+    for (pointID p = 0; p < n_points; p++)
+    {
+        permutation.point_new_to_old(p) = point_new_to_old[p];
+        permutation.point_old_to_new(p) = point_old_to_new[p];
+    }
+    for (int r = 0; r < n_regions; r++)
+    {
+        permutation.region_new_to_old(r) = region_new_to_old[r];
+    }
+    return permutation;
+}
+
+// Instantiate for both mesh layouts
+template MeshPermutation TFEM::reorder_mesh<DeviceMesh>(DeviceMesh &, DeviceMesh::HostMirrorMesh &, MeshOrdering);
+template MeshPermutation TFEM::reorder_mesh<DeviceSoAMesh>(DeviceSoAMesh &, DeviceSoAMesh::HostMirrorMesh &, MeshOrdering);
@@ -1,11 +1,24 @@
 #!/bin/bash
-mkdir benchmark
-./build_gpu.sh
+# Runs the benchmark sweep in-process with the bench executable (see highOrderTFEM/bench.cpp), no
+# cluster allocation needed. Pass "gpu" as the first argument to also build and run the GPU
+# version; any further arguments are passed on to bench (e.g. --repeats 10 --steps 100,1000).
+# benchmark/benchmark_data.csv has the schema read by visualization/visualize_benchmarks.py.
+mkdir -p benchmark
+run_gpu=0
+if [ "$1" == "gpu" ]; then
+    run_gpu=1
+    shift
+fi
+
+export OMP_PROC_BIND=spread
+export OMP_PLACES=threads
+
 ./build_cpu.sh
+./bin/cpu/bench --meshes demoMeshes/Results2 --fuzz 0,1 --out benchmark/cpu.csv --details benchmark/cpu_details.csv "$@"
+cp benchmark/cpu.csv benchmark/benchmark_data.csv
 
-for i in $(seq 2 11);
-do
-    sbatch --wait --mem=4GB --output=benchmark/cpu_${i}.out run_cpu.slurm.sh demoMeshes/Results2/square${i}_b0.grd
-    sbatch --wait --output=benchmark/gpu_${i}.out run_gpu.slurm.sh demoMeshes/Results2/square${i}_b0.grd
-    sbatch --wait --mem=4GB --cpus-per-task=1 --output=benchmark/serial_${i}.out run_cpu.slurm.sh demoMeshes/Results2/square${i}_b0.grd
-done
+if [ $run_gpu == 1 ]; then
+    ./build_gpu.sh
+    ./bin/gpu/bench --meshes demoMeshes/Results2 --fuzz 0,1 --patterns Atomic,Coloring,Gather --out benchmark/gpu.csv --details benchmark/gpu_details.csv "$@"
+    tail -n +2 benchmark/gpu.csv >> benchmark/benchmark_data.csv
+fi